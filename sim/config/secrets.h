@@ -0,0 +1,22 @@
+#pragma once
+
+// シミュレーター用の設定。env:simでは -include で全ファイルの先頭に読み込み、src/secrets.hより優先する
+// (src/secrets.hはSIM_SECRETSが定義されていると中身を読み飛ばす)。
+// ホスト名はシナリオの "http" 行で応答を登録する際に使用する
+
+#define SIM_SECRETS
+
+inline const char* MAC_ADDRESS = "AA:BB:CC:DD:EE:FF";
+
+#define COMMAND_KEY "sim-command-key"
+
+inline const char* ssid = "sim-ssid";
+inline const char* password = "sim-password";
+
+inline const char* YAHOO_APP_ID = "sim-app-id";
+inline const char* LATITUDE = "35.681236";
+inline const char* LONGITUDE = "139.767125";
+
+inline const char* POST_URL = "http://sim.local/api/record";
+
+#define OTA_MANIFEST_URL "http://updates.local/deskesp/manifest.json"
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <Arduino.h>
+#include <string>
+#include <vector>
+
+// Adafruit GFXの代替。文字は実際のフォントの代わりに、文字コードから決まる5x7の模様で描画する
+// (画面の内容が文字ごとに異なり、差分転送の量が本物に近くなる)。
+// 描画した文字列は位置とともに記録し、フレームの比較・レポートに使用する
+class Adafruit_GFX : public Print
+{
+public:
+  // 描画された文字列 (同じ行に続けて描画された文字は1つにまとめる)
+  struct TextSpan
+  {
+    int16_t x;
+    int16_t y;
+    uint8_t size;
+    bool inverted;
+    std::string text;
+  };
+
+  Adafruit_GFX(int16_t w, int16_t h) : _width(w), _height(h) {}
+
+  virtual void drawPixel(int16_t x, int16_t y, uint16_t color) = 0;
+  void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color);
+  void drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color) { fillRect(x, y, w, 1, color); }
+  void drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color) { fillRect(x, y, 1, h, color); }
+  void drawRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color);
+  void drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t color);
+  void fillScreen(uint16_t color) { fillRect(0, 0, _width, _height, color); }
+
+  void setCursor(int16_t x, int16_t y)
+  {
+    _cursorX = x;
+    _cursorY = y;
+  }
+  int16_t getCursorX() const { return _cursorX; }
+  int16_t getCursorY() const { return _cursorY; }
+  void setTextSize(uint8_t size) { _textSize = size > 0 ? size : 1; }
+  void setTextColor(uint16_t color) { _textColor = _textBgColor = color; }
+  void setTextColor(uint16_t color, uint16_t background)
+  {
+    _textColor = color;
+    _textBgColor = background;
+  }
+  void setTextWrap(bool wrap) { _wrap = wrap; }
+  void cp437(bool enable = true) { (void)enable; }
+
+  int16_t width() const { return _width; }
+  int16_t height() const { return _height; }
+
+  size_t write(uint8_t c) override;
+  using Print::write;
+
+  const std::vector<TextSpan> &textSpans() const { return _spans; }
+
+protected:
+  void drawChar(int16_t x, int16_t y, unsigned char c, uint16_t color, uint16_t bg, uint8_t size);
+  void clearTextSpans() { _spans.clear(); }
+
+  int16_t _width;
+  int16_t _height;
+  int16_t _cursorX = 0;
+  int16_t _cursorY = 0;
+  uint8_t _textSize = 1;
+  uint16_t _textColor = 0xFFFF;
+  uint16_t _textBgColor = 0xFFFF;
+  bool _wrap = true;
+  std::vector<TextSpan> _spans;
+};
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <Adafruit_GFX.h>
+#include <Wire.h>
+
+#define SSD1306_BLACK 0
+#define SSD1306_WHITE 1
+#define SSD1306_INVERSE 2
+#define BLACK SSD1306_BLACK
+#define WHITE SSD1306_WHITE
+#define INVERSE SSD1306_INVERSE
+
+#define SSD1306_MEMORYMODE 0x20
+#define SSD1306_COLUMNADDR 0x21
+#define SSD1306_PAGEADDR 0x22
+#define SSD1306_SETCONTRAST 0x81
+#define SSD1306_CHARGEPUMP 0x8D
+#define SSD1306_SEGREMAP 0xA0
+#define SSD1306_DISPLAYALLON_RESUME 0xA4
+#define SSD1306_NORMALDISPLAY 0xA6
+#define SSD1306_INVERTDISPLAY 0xA7
+#define SSD1306_SETMULTIPLEX 0xA8
+#define SSD1306_DISPLAYOFF 0xAE
+#define SSD1306_DISPLAYON 0xAF
+#define SSD1306_COMSCANDEC 0xC8
+#define SSD1306_SETDISPLAYOFFSET 0xD3
+#define SSD1306_SETDISPLAYCLOCKDIV 0xD5
+#define SSD1306_SETPRECHARGE 0xD9
+#define SSD1306_SETCOMPINS 0xDA
+#define SSD1306_SETVCOMDETECT 0xDB
+#define SSD1306_SETSTARTLINE 0x40
+#define SSD1306_DEACTIVATE_SCROLL 0x2E
+
+#define SSD1306_EXTERNALVCC 0x01
+#define SSD1306_SWITCHCAPVCC 0x02
+
+// Adafruit SSD1306の代替。I2Cへの送信手順 (コマンド・転送範囲・Wireバッファ単位のデータ) は本物と同じ
+class Adafruit_SSD1306 : public Adafruit_GFX
+{
+public:
+  Adafruit_SSD1306(uint8_t w, uint8_t h, TwoWire *twi = &Wire, int8_t rstPin = -1,
+                   uint32_t clkDuring = 400000UL, uint32_t clkAfter = 100000UL)
+      : Adafruit_GFX(w, h), _wire(twi), _clockDuring(clkDuring), _clockAfter(clkAfter)
+  {
+    (void)rstPin;
+  }
+  ~Adafruit_SSD1306() { delete[] _buffer; }
+
+  bool begin(uint8_t vccState = SSD1306_SWITCHCAPVCC, uint8_t i2cAddress = 0, bool reset = true,
+             bool periphBegin = true);
+  void display();
+  void clearDisplay();
+  void invertDisplay(bool invert) { ssd1306_command(invert ? SSD1306_INVERTDISPLAY : SSD1306_NORMALDISPLAY); }
+  void dim(bool dim)
+  {
+    ssd1306_command(SSD1306_SETCONTRAST);
+    ssd1306_command(dim ? 0 : 0xCF);
+  }
+  void drawPixel(int16_t x, int16_t y, uint16_t color) override;
+  void ssd1306_command(uint8_t c);
+
+  // 描画済みの内容を、画面の内容との照合用に登録してから返す
+  uint8_t *getBuffer();
+
+private:
+  void commandList(const uint8_t *c, uint8_t n);
+  void registerFrame();
+
+  TwoWire *_wire;
+  uint32_t _clockDuring;
+  uint32_t _clockAfter;
+  uint8_t _address = 0x3C;
+  uint8_t *_buffer = nullptr;
+  bool _dirty = true;
+};
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <Arduino.h>
+
+#define DHT11 11
+#define DHT22 22
+
+// 値はシナリオの "dht" で設定する。本物と同じく、2秒以内の再読み取りは前回の値を返す
+class DHT
+{
+public:
+  DHT(uint8_t pin, uint8_t type, uint8_t count = 6)
+  {
+    (void)pin;
+    (void)type;
+    (void)count;
+  }
+  void begin(uint8_t usec = 55) { (void)usec; }
+  float readTemperature(bool fahrenheit = false, bool force = false);
+  float readHumidity(bool force = false);
+
+private:
+  bool read(bool force);
+
+  bool _started = false;
+  bool _lastResult = false;
+  unsigned long _lastReadTime = 0;
+  float _temp = NAN;
+  float _hum = NAN;
+};
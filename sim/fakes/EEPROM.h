@@ -0,0 +1,39 @@
+#pragma once
+
+#include <Arduino.h>
+#include "../src/sim_world.h"
+
+// フラッシュ上のEEPROM領域 (4KB)。再起動後も内容が残る
+class EEPROMClass
+{
+public:
+  void begin(size_t size) { _size = size; }
+  bool end()
+  {
+    _size = 0;
+    return true;
+  }
+  bool commit() { return true; }
+  size_t length() const { return _size; }
+
+  uint8_t read(int address) const { return simEepromMemory()[address]; }
+  void write(int address, uint8_t value) { simEepromMemory()[address] = value; }
+
+  template <typename T>
+  T &get(int address, T &value)
+  {
+    memcpy(&value, simEepromMemory() + address, sizeof(T));
+    return value;
+  }
+  template <typename T>
+  const T &put(int address, const T &value)
+  {
+    memcpy(simEepromMemory() + address, &value, sizeof(T));
+    return value;
+  }
+
+private:
+  size_t _size = 0;
+};
+
+extern EEPROMClass EEPROM;
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <ESP8266WiFi.h>
+#include <vector>
+
+#define HTTPC_ERROR_CONNECTION_FAILED (-1)
+#define HTTPC_ERROR_SEND_HEADER_FAILED (-2)
+#define HTTPC_ERROR_SEND_PAYLOAD_FAILED (-3)
+#define HTTPC_ERROR_NOT_CONNECTED (-4)
+#define HTTPC_ERROR_CONNECTION_LOST (-5)
+#define HTTPC_ERROR_NO_STREAM (-6)
+#define HTTPC_ERROR_NO_HTTP_SERVER (-7)
+#define HTTPC_ERROR_TOO_LESS_RAM (-8)
+#define HTTPC_ERROR_ENCODING (-9)
+#define HTTPC_ERROR_STREAM_WRITE (-10)
+#define HTTPC_ERROR_READ_TIMEOUT (-11)
+
+typedef enum
+{
+  HTTP_CODE_OK = 200,
+  HTTP_CODE_MOVED_PERMANENTLY = 301,
+  HTTP_CODE_NOT_FOUND = 404,
+  HTTP_CODE_INTERNAL_SERVER_ERROR = 500
+} t_http_codes;
+
+// リクエストは仮想世界のHTTPサーバー (シナリオで応答と遅延を指定) が処理する
+class HTTPClient
+{
+public:
+  ~HTTPClient()
+  {
+    // 本物と同じく、デストラクタで接続を閉じる
+    if (_client)
+      _client->stop();
+  }
+
+  bool begin(WiFiClient &client, const String &url)
+  {
+    _client = &client;
+    _url = url.c_str();
+    _requestHeaders.clear();
+    return strncmp(_url.c_str(), "http://", 7) == 0 || strncmp(_url.c_str(), "https://", 8) == 0;
+  }
+  void end()
+  {
+    if (_client && !_reuse)
+      _client->stop();
+    _responseHeaders.clear();
+  }
+  bool connected() { return _client && _client->connected(); }
+
+  void setReuse(bool reuse) { _reuse = reuse; }
+  void useHTTP10(bool usehttp10) { (void)usehttp10; }
+  void setUserAgent(const String &userAgent) { (void)userAgent; }
+  void setTimeout(uint16_t timeout) { (void)timeout; }
+  void addHeader(const String &name, const String &value, bool first = false, bool replace = true)
+  {
+    (void)first;
+    (void)replace;
+    _requestHeaders.push_back({name.c_str(), value.c_str()});
+  }
+  void collectHeaders(const char *headerKeys[], const size_t headerKeysCount)
+  {
+    _collect.assign(headerKeys, headerKeys + headerKeysCount);
+  }
+  String header(const char *name)
+  {
+    for (auto &h : _responseHeaders)
+    {
+      if (strcasecmp(h.first.c_str(), name) == 0)
+        return String(h.second);
+    }
+    return String();
+  }
+
+  int GET() { return sendRequest("GET", ""); }
+  int POST(const String &payload) { return sendRequest("POST", payload.c_str()); }
+  int POST(const uint8_t *payload, size_t size) { return sendRequest("POST", std::string((const char *)payload, size)); }
+
+  int getSize() { return _size; }
+  WiFiClient &getStream() { return *_client; }
+  String getString()
+  {
+    std::string body;
+    int c;
+    while (_client && (c = _client->read()) >= 0)
+      body += (char)c;
+    return String(body);
+  }
+
+  static String errorToString(int error);
+
+private:
+  int sendRequest(const char *method, const std::string &payload)
+  {
+    (void)payload;
+    if (!_client)
+      return HTTPC_ERROR_NOT_CONNECTED;
+    bool acceptGzip = false;
+    for (auto &h : _requestHeaders)
+    {
+      if (strcasecmp(h.first.c_str(), "Accept-Encoding") == 0 && h.second.find("gzip") != std::string::npos)
+        acceptGzip = true;
+    }
+    SimHttpResponse response = simHttpRequest(method, _url, acceptGzip, _client->simConnection());
+    _responseHeaders.clear();
+    if (!response.contentEncoding.empty())
+      _responseHeaders.push_back({"Content-Encoding", response.contentEncoding});
+    _client->simSetBody(response.status > 0 ? response.body : std::string());
+    _size = response.status > 0 ? (int)response.body.size() : -1;
+    return response.status;
+  }
+
+  WiFiClient *_client = nullptr;
+  std::string _url;
+  bool _reuse = true;
+  int _size = -1; // Content-Length
+  std::vector<std::pair<std::string, std::string>> _requestHeaders;
+  std::vector<std::pair<std::string, std::string>> _responseHeaders;
+  std::vector<std::string> _collect;
+};
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <ESP8266WiFi.h>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+typedef enum
+{
+  HTTP_ANY,
+  HTTP_GET,
+  HTTP_HEAD,
+  HTTP_POST,
+  HTTP_PUT,
+  HTTP_PATCH,
+  HTTP_DELETE,
+  HTTP_OPTIONS
+} HTTPMethod;
+
+#define CONTENT_LENGTH_UNKNOWN ((size_t)-1)
+
+// シナリオの "api" で送られたリクエストを、登録されたハンドラーで処理する
+class ESP8266WebServer
+{
+public:
+  typedef std::function<void(void)> THandlerFunction;
+
+  explicit ESP8266WebServer(int port = 80) : _port(port) {}
+
+  void begin() { _started = true; }
+  void close() { _started = false; }
+  void on(const String &uri, THandlerFunction handler) { on(uri, HTTP_ANY, handler); }
+  void on(const String &uri, HTTPMethod method, THandlerFunction handler)
+  {
+    _routes.push_back({uri.str(), method, handler});
+  }
+  void onNotFound(THandlerFunction handler) { _notFound = handler; }
+  void handleClient();
+
+  HTTPMethod method() const { return _method; }
+  const String &uri() const { return _uri; }
+  bool hasArg(const String &name) const;
+  String arg(const String &name) const;
+  int args() const { return (int)_args.size(); }
+
+  void send(int code, const char *contentType = nullptr, const String &content = String());
+  bool chunkedResponseModeStart(int code, const char *contentType);
+  void sendContent(const char *content, size_t size);
+  void sendContent(const String &content) { sendContent(content.c_str(), content.length()); }
+  void chunkedResponseFinalize() {}
+
+private:
+  struct Route
+  {
+    std::string uri;
+    HTTPMethod method;
+    THandlerFunction handler;
+  };
+
+  int _port;
+  bool _started = false;
+  std::vector<Route> _routes;
+  THandlerFunction _notFound;
+
+  // 処理中のリクエストと応答
+  HTTPMethod _method = HTTP_GET;
+  String _uri;
+  std::vector<std::pair<std::string, std::string>> _args;
+  int _status = 0;
+  std::string _body;
+};
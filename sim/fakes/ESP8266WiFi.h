@@ -0,0 +1,144 @@
+#pragma once
+
+#include <Arduino.h>
+#include "Client.h"
+#include "../src/sim_world.h"
+
+typedef enum
+{
+  WL_IDLE_STATUS = 0,
+  WL_NO_SSID_AVAIL = 1,
+  WL_SCAN_COMPLETED = 2,
+  WL_CONNECTED = 3,
+  WL_CONNECT_FAILED = 4,
+  WL_CONNECTION_LOST = 5,
+  WL_WRONG_PASSWORD = 6,
+  WL_DISCONNECTED = 7
+} wl_status_t;
+
+typedef enum
+{
+  WIFI_OFF = 0,
+  WIFI_STA = 1,
+  WIFI_AP = 2,
+  WIFI_AP_STA = 3
+} WiFiMode_t;
+
+class ESP8266WiFiClass
+{
+public:
+  bool mode(WiFiMode_t mode)
+  {
+    (void)mode;
+    return true;
+  }
+  bool config(IPAddress localIP, IPAddress gateway, IPAddress subnet,
+              IPAddress dns1 = IPAddress(), IPAddress dns2 = IPAddress())
+  {
+    (void)gateway;
+    (void)subnet;
+    (void)dns1;
+    (void)dns2;
+    _localIP = localIP;
+    return true;
+  }
+  wl_status_t begin(const char *ssid, const char *passphrase = nullptr, int32_t channel = 0,
+                    const uint8_t *bssid = nullptr, bool connect = true);
+  bool disconnect(bool wifiOff = false);
+  bool setAutoReconnect(bool autoReconnect)
+  {
+    (void)autoReconnect;
+    return true;
+  }
+  bool persistent(bool persistent)
+  {
+    (void)persistent;
+    return true;
+  }
+
+  wl_status_t status() { return simWifiConnected() ? WL_CONNECTED : WL_DISCONNECTED; }
+  bool isConnected() { return simWifiConnected(); }
+  IPAddress localIP() { return simWifiConnected() ? _localIP : IPAddress(); }
+  int32_t RSSI() { return simWifiConnected() ? -58 : 31; }
+  uint8_t *BSSID() { return (uint8_t *)simWifiBssid(); }
+  int32_t channel() { return simWifiChannel(); }
+
+  int hostByName(const char *host, IPAddress &result);
+  int hostByName(const char *host, IPAddress &result, uint32_t timeoutMs)
+  {
+    (void)timeoutMs;
+    return hostByName(host, result);
+  }
+
+private:
+  IPAddress _localIP = IPAddress(192, 168, 0, 50);
+};
+
+extern ESP8266WiFiClass WiFi;
+
+// 応答ボディを読み出すTCPクライアント。接続の有効性は仮想世界のWiFiの状態とkeep-aliveのタイムアウトで決まる
+class WiFiClient : public Client
+{
+public:
+  virtual ~WiFiClient() {}
+
+  int connect(IPAddress ip, uint16_t port) override
+  {
+    (void)ip;
+    (void)port;
+    return simWifiConnected() ? 1 : 0;
+  }
+  int connect(const char *host, uint16_t port) override
+  {
+    (void)host;
+    (void)port;
+    return simWifiConnected() ? 1 : 0;
+  }
+  void stop() override
+  {
+    _connection.open = false;
+    _body.clear();
+    _position = 0;
+  }
+  uint8_t connected() override { return _position < _body.size() || simConnectionAlive(_connection); }
+
+  // 応答ボディは回線の速度 (シナリオの "net kilobyte") に応じて少しずつ届く
+  int available() override { return (int)(simBodyArrived(_bodyStart, _body.size()) - _position); }
+  int read() override { return available() > 0 ? (uint8_t)_body[_position++] : -1; }
+  int read(uint8_t *buffer, size_t size)
+  {
+    size_t n = std::min(size, (size_t)available());
+    memcpy(buffer, _body.data() + _position, n);
+    _position += n;
+    return (int)n;
+  }
+  int peek() override { return available() > 0 ? (uint8_t)_body[_position] : -1; }
+  size_t write(uint8_t c) override
+  {
+    (void)c;
+    return 1;
+  }
+  size_t write(const uint8_t *buffer, size_t size) override
+  {
+    (void)buffer;
+    return size;
+  }
+  using Print::write;
+
+  void setNoDelay(bool noDelay) { (void)noDelay; }
+
+  // シミュレーター用: HTTPClientの偽物が接続状態と応答ボディを設定する
+  SimConnection &simConnection() { return _connection; }
+  void simSetBody(const std::string &body)
+  {
+    _body = body;
+    _position = 0;
+    _bodyStart = simNowMicros();
+  }
+
+protected:
+  SimConnection _connection = {false, false, 0, 0};
+  std::string _body;
+  size_t _position = 0;
+  uint64_t _bodyStart = 0;
+};
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+struct rst_info;
+
+class EspClass
+{
+public:
+  uint32_t getFreeHeap();
+  uint8_t getHeapFragmentation();
+  uint32_t getMaxFreeBlockSize();
+  uint32_t getChipId() { return 0x00C0FFEE; }
+  const rst_info *getResetInfoPtr();
+  bool rtcUserMemoryRead(uint32_t offset, uint32_t *data, size_t size);
+  bool rtcUserMemoryWrite(uint32_t offset, uint32_t *data, size_t size);
+  void restart() __attribute__((noreturn));
+  void reset() __attribute__((noreturn)) { restart(); }
+};
+
+extern EspClass ESP;
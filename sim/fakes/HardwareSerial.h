@@ -0,0 +1,32 @@
+#pragma once
+
+#include "Stream.h"
+
+// 115200bpsのUARTと128バイトの送信FIFOを、仮想時間でモデル化する
+class HardwareSerial : public Stream
+{
+public:
+  void begin(unsigned long baud) { _baud = baud; }
+  void end() {}
+  explicit operator bool() const { return true; }
+
+  int available() override;
+  int read() override;
+  int peek() override;
+
+  size_t write(uint8_t c) override { return write(&c, 1); }
+  size_t write(const uint8_t *buffer, size_t size) override;
+  using Print::write;
+  int availableForWrite() override;
+  void flush() override;
+
+private:
+  void drain();
+
+  unsigned long _baud = 115200;
+  size_t _txPending = 0;
+  uint64_t _txUpdated = 0;
+  int _peeked = -1;
+};
+
+extern HardwareSerial Serial;
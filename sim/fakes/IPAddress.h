@@ -0,0 +1,29 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "WString.h"
+
+class IPAddress
+{
+public:
+  IPAddress() : _bytes{0, 0, 0, 0} {}
+  IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : _bytes{a, b, c, d} {}
+
+  uint8_t operator[](int index) const { return _bytes[index]; }
+  uint8_t &operator[](int index) { return _bytes[index]; }
+  bool operator==(const IPAddress &rhs) const { return memcmp(_bytes, rhs._bytes, 4) == 0; }
+  bool isSet() const { return _bytes[0] || _bytes[1] || _bytes[2] || _bytes[3]; }
+  const uint8_t *raw() const { return _bytes; }
+
+  String toString() const
+  {
+    char buf[16];
+    snprintf(buf, sizeof(buf), "%u.%u.%u.%u", _bytes[0], _bytes[1], _bytes[2], _bytes[3]);
+    return String(buf);
+  }
+
+private:
+  uint8_t _bytes[4];
+};
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <Arduino.h>
+#include "Client.h"
+#include "../src/sim_world.h"
+
+typedef enum
+{
+  LWMQTT_SUCCESS = 0,
+  LWMQTT_NETWORK_FAILED_CONNECT = -3,
+  LWMQTT_MISSING_OR_WRONG_PACKET = -8
+} lwmqtt_err_t;
+
+typedef enum
+{
+  LWMQTT_CONNECTION_ACCEPTED = 0,
+  LWMQTT_UNKNOWN_RETURN_CODE = 6
+} lwmqtt_return_code_t;
+
+// ブローカーへの接続とPublishの成否はWiFiの状態で決まる
+class MQTTClient
+{
+public:
+  explicit MQTTClient(int bufSize = 128) { (void)bufSize; }
+
+  void begin(IPAddress address, int port, Client &client)
+  {
+    (void)address;
+    (void)port;
+    (void)client;
+  }
+  void setKeepAlive(int keepAlive) { (void)keepAlive; }
+  void setTimeout(int timeout) { (void)timeout; }
+
+  bool connect(const char *clientId, bool skip = false)
+  {
+    (void)clientId;
+    (void)skip;
+    _connected = simMqttConnect();
+    _lastError = _connected ? LWMQTT_SUCCESS : LWMQTT_NETWORK_FAILED_CONNECT;
+    _generation = simWifiGeneration();
+    return _connected;
+  }
+  bool connected() { return _connected && simWifiConnected() && _generation == simWifiGeneration(); }
+  bool disconnect()
+  {
+    _connected = false;
+    return true;
+  }
+  bool loop() { return connected(); }
+
+  bool publish(const char *topic, const char *payload, int length, bool retained, int qos)
+  {
+    (void)payload;
+    (void)retained;
+    (void)qos;
+    if (!connected() || !simMqttPublish(topic, length))
+    {
+      _lastError = LWMQTT_MISSING_OR_WRONG_PACKET;
+      return false;
+    }
+    return true;
+  }
+
+  lwmqtt_err_t lastError() { return _lastError; }
+  lwmqtt_return_code_t returnCode() { return LWMQTT_CONNECTION_ACCEPTED; }
+
+private:
+  bool _connected = false;
+  uint32_t _generation = 0;
+  lwmqtt_err_t _lastError = LWMQTT_SUCCESS;
+};
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "Print.h"
+
+class Stream : public Print
+{
+public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+
+  void setTimeout(unsigned long timeout) { _timeout = timeout; }
+  unsigned long getTimeout() const { return _timeout; }
+
+  bool find(const char *target) { return findUntil(target, nullptr); }
+  bool find(char target)
+  {
+    char str[2] = {target, '\0'};
+    return find(str);
+  }
+  bool findUntil(const char *target, const char *terminator);
+
+  virtual size_t readBytes(char *buffer, size_t length);
+  size_t readBytes(uint8_t *buffer, size_t length) { return readBytes((char *)buffer, length); }
+  String readString();
+  String readStringUntil(char terminator);
+
+protected:
+  // タイムアウトまで (仮想時間で) 受信を待つ
+  int timedRead();
+  int timedPeek();
+
+  unsigned long _timeout = 1000;
+};
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <Arduino.h>
+
+// SDKのタイマー (os_timer) で定期的に呼ばれるコールバック。
+// 本物と同じく、スケッチがSDKに制御を返している間 (yield・delay・loop()の終了・通信の待ち) にだけ呼ばれる
+class Ticker
+{
+public:
+  typedef void (*callback_t)();
+
+  ~Ticker() { detach(); }
+
+  void attach_ms(uint32_t milliseconds, callback_t callback);
+  void detach();
+  bool active() const { return _callback != nullptr; }
+
+  // シミュレーター用: 期限が来ていればコールバックを呼ぶ
+  void simService(uint64_t now);
+
+private:
+  callback_t _callback = nullptr;
+  uint64_t _period = 0;
+  uint64_t _next = 0;
+};
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <Arduino.h>
+
+#define U_FLASH 0
+
+#define UPDATE_ERROR_OK (0)
+#define UPDATE_ERROR_WRITE (1)
+#define UPDATE_ERROR_SPACE (4)
+#define UPDATE_ERROR_SIZE (5)
+#define UPDATE_ERROR_MAGIC_BYTE (10)
+
+// フラッシュの更新領域への書き込み。4KBのセクターごとに消去と書き込みの時間がかかる。
+// 全バイトを書き込んでend()すると、次の再起動でイメージが書き換えられる (シミュレーターでは記録のみ)
+class UpdaterClass
+{
+public:
+  bool begin(size_t size, int command = U_FLASH, int ledPin = -1, uint8_t ledOn = LOW);
+  size_t write(uint8_t *data, size_t len);
+  bool end(bool evenIfRemaining = false);
+
+  uint8_t getError() { return _error; }
+  bool hasError() { return _error != UPDATE_ERROR_OK; }
+  String getErrorString() const;
+  bool isRunning() { return _size > 0; }
+  bool isFinished() { return _size > 0 && _written == _size; }
+  size_t size() { return _size; }
+  size_t progress() { return _written; }
+  size_t remaining() { return _size - _written; }
+
+private:
+  void reset();
+
+  size_t _size = 0;
+  size_t _written = 0;
+  size_t _buffered = 0; // セクターに書き込む前のバイト数
+  uint8_t _error = UPDATE_ERROR_OK;
+};
+
+extern UpdaterClass Update;
@@ -0,0 +1,150 @@
+#pragma once
+
+#include <string>
+#include <string.h>
+#include <stdlib.h>
+
+class __FlashStringHelper;
+
+// ArduinoのStringをstd::stringで置き換えたもの (ファームウェアとArduinoJsonが使う範囲)
+class String
+{
+public:
+  String(const char *cstr = "") : _s(cstr ? cstr : "") {}
+  String(const std::string &str) : _s(str) {}
+  String(const __FlashStringHelper *str) : _s(str ? reinterpret_cast<const char *>(str) : "") {}
+  explicit String(char c) : _s(1, c) {}
+  explicit String(unsigned char value, unsigned char base = 10) : String((unsigned long)value, base) {}
+  explicit String(int value, unsigned char base = 10) : String((long)value, base) {}
+  explicit String(unsigned int value, unsigned char base = 10) : String((unsigned long)value, base) {}
+  explicit String(long value, unsigned char base = 10);
+  explicit String(unsigned long value, unsigned char base = 10);
+  explicit String(float value, unsigned char decimalPlaces = 2) : String((double)value, decimalPlaces) {}
+  explicit String(double value, unsigned char decimalPlaces = 2);
+
+  String &operator=(const char *cstr)
+  {
+    _s = cstr ? cstr : "";
+    return *this;
+  }
+
+  const char *c_str() const { return _s.c_str(); }
+  unsigned int length() const { return _s.length(); }
+  bool isEmpty() const { return _s.empty(); }
+  bool reserve(unsigned int size)
+  {
+    _s.reserve(size);
+    return true;
+  }
+  const std::string &str() const { return _s; }
+
+  bool concat(const String &str)
+  {
+    _s += str._s;
+    return true;
+  }
+  bool concat(const char *cstr)
+  {
+    if (cstr)
+      _s += cstr;
+    return true;
+  }
+  bool concat(const char *cstr, unsigned int length)
+  {
+    _s.append(cstr, length);
+    return true;
+  }
+  bool concat(char c)
+  {
+    _s += c;
+    return true;
+  }
+  String &operator+=(const String &rhs)
+  {
+    concat(rhs);
+    return *this;
+  }
+  String &operator+=(const char *rhs)
+  {
+    concat(rhs);
+    return *this;
+  }
+  String &operator+=(char rhs)
+  {
+    concat(rhs);
+    return *this;
+  }
+  String &operator+=(int rhs) { return *this += String(rhs); }
+
+  char charAt(unsigned int index) const { return index < _s.size() ? _s[index] : 0; }
+  char operator[](unsigned int index) const { return charAt(index); }
+
+  bool equals(const String &rhs) const { return _s == rhs._s; }
+  bool equals(const char *rhs) const { return _s == (rhs ? rhs : ""); }
+  bool equalsIgnoreCase(const String &rhs) const { return strcasecmp(c_str(), rhs.c_str()) == 0; }
+  bool operator==(const String &rhs) const { return equals(rhs); }
+  bool operator==(const char *rhs) const { return equals(rhs); }
+  bool operator!=(const String &rhs) const { return !equals(rhs); }
+  bool operator!=(const char *rhs) const { return !equals(rhs); }
+  bool startsWith(const String &prefix) const { return _s.compare(0, prefix._s.size(), prefix._s) == 0; }
+  bool endsWith(const String &suffix) const
+  {
+    return _s.size() >= suffix._s.size() && _s.compare(_s.size() - suffix._s.size(), suffix._s.size(), suffix._s) == 0;
+  }
+
+  int indexOf(char c, unsigned int from = 0) const { return find(_s.find(c, from)); }
+  int indexOf(const char *str, unsigned int from = 0) const { return find(_s.find(str, from)); }
+  int indexOf(const String &str, unsigned int from = 0) const { return find(_s.find(str._s, from)); }
+  int lastIndexOf(char c) const { return find(_s.rfind(c)); }
+
+  String substring(unsigned int from) const { return from < _s.size() ? String(_s.substr(from)) : String(); }
+  String substring(unsigned int from, unsigned int to) const
+  {
+    if (from > to)
+      std::swap(from, to);
+    return from < _s.size() ? String(_s.substr(from, to - from)) : String();
+  }
+
+  long toInt() const { return atol(c_str()); }
+  float toFloat() const { return (float)atof(c_str()); }
+  void trim();
+  void toLowerCase();
+  void toUpperCase();
+
+private:
+  static int find(size_t pos) { return pos == std::string::npos ? -1 : (int)pos; }
+  std::string _s;
+};
+
+// ArduinoJsonが型を判別するために参照する
+class StringSumHelper : public String
+{
+public:
+  using String::String;
+  StringSumHelper(const String &s) : String(s) {}
+};
+
+inline StringSumHelper operator+(const String &lhs, const String &rhs)
+{
+  StringSumHelper result(lhs);
+  result.concat(rhs);
+  return result;
+}
+inline StringSumHelper operator+(const String &lhs, const char *rhs)
+{
+  StringSumHelper result(lhs);
+  result.concat(rhs);
+  return result;
+}
+inline StringSumHelper operator+(const char *lhs, const String &rhs)
+{
+  StringSumHelper result(lhs);
+  result.concat(rhs);
+  return result;
+}
+inline StringSumHelper operator+(const String &lhs, char rhs)
+{
+  StringSumHelper result(lhs);
+  result.concat(rhs);
+  return result;
+}
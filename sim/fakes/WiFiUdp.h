@@ -0,0 +1,75 @@
+#pragma once
+
+#include <ESP8266WiFi.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+class WiFiUDP
+{
+public:
+  uint8_t begin(uint16_t port)
+  {
+    _localPort = port;
+    return 1;
+  }
+  void stop() { _localPort = 0; }
+
+  // 受信 (シナリオの "command" で届いたパケット)
+  int parsePacket()
+  {
+    _received.clear();
+    _readPos = 0;
+    if (_localPort == 0 || !simUdpReceive(_localPort, _received, _remoteIp, _remotePort))
+      return 0;
+    return (int)_received.size();
+  }
+  int available() { return (int)(_received.size() - _readPos); }
+  int read()
+  {
+    return _readPos < _received.size() ? (uint8_t)_received[_readPos++] : -1;
+  }
+  int read(uint8_t *buffer, size_t len)
+  {
+    size_t n = std::min(len, _received.size() - _readPos);
+    memcpy(buffer, _received.data() + _readPos, n);
+    _readPos += n;
+    return (int)n;
+  }
+  int read(char *buffer, size_t len) { return read((uint8_t *)buffer, len); }
+  void flush() { _readPos = _received.size(); }
+  IPAddress remoteIP() const { return IPAddress(_remoteIp[0], _remoteIp[1], _remoteIp[2], _remoteIp[3]); }
+  uint16_t remotePort() const { return _remotePort; }
+
+  int beginPacket(IPAddress ip, uint16_t port)
+  {
+    if (!simWifiConnected())
+      return 0;
+    _ip = ip;
+    _port = port;
+    _packet.clear();
+    return 1;
+  }
+  size_t write(uint8_t c)
+  {
+    _packet.push_back(c);
+    return 1;
+  }
+  size_t write(const uint8_t *buffer, size_t size)
+  {
+    _packet.insert(_packet.end(), buffer, buffer + size);
+    return size;
+  }
+  int endPacket() { return simUdpSend(_ip.raw(), _port, _packet.data(), _packet.size()) ? 1 : 0; }
+
+private:
+  uint16_t _localPort = 0;
+  std::string _received;
+  size_t _readPos = 0;
+  uint8_t _remoteIp[4] = {0, 0, 0, 0};
+  uint16_t _remotePort = 0;
+
+  IPAddress _ip;
+  uint16_t _port = 0;
+  std::vector<uint8_t> _packet;
+};
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <Arduino.h>
+
+// 1回のトランザクションで送れる最大バイト数 (ESP8266のWireと同じ)
+#define BUFFER_LENGTH 128
+
+// I2Cの送信側のみ。送信したバイト数とクロックから転送時間を求め、仮想時間を進める
+class TwoWire
+{
+public:
+  void begin(int sda, int scl)
+  {
+    (void)sda;
+    (void)scl;
+  }
+  void begin() {}
+  void setClock(uint32_t clockHz) { _clockHz = clockHz; }
+
+  void beginTransmission(uint8_t address)
+  {
+    _address = address;
+    _length = 0;
+  }
+  size_t write(uint8_t data)
+  {
+    if (_length >= BUFFER_LENGTH)
+      return 0;
+    _buffer[_length++] = data;
+    return 1;
+  }
+  size_t write(const uint8_t *data, size_t quantity)
+  {
+    size_t n = 0;
+    while (n < quantity && write(data[n]))
+      n++;
+    return n;
+  }
+  uint8_t endTransmission(bool sendStop = true);
+
+private:
+  uint32_t _clockHz = 100000;
+  uint8_t _address = 0;
+  uint8_t _buffer[BUFFER_LENGTH];
+  size_t _length = 0;
+};
+
+extern TwoWire Wire;
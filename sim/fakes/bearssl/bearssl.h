@@ -0,0 +1,4 @@
+#pragma once
+
+#include "bearssl_hash.h"
+#include "bearssl_hmac.h"
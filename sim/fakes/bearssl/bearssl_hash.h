@@ -0,0 +1,55 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// BearSSLのハッシュ関数 (SHA-1 / SHA-256) の代替。ブロックごとに本物の処理時間だけ仮想時計を進める
+
+typedef struct br_hash_class_ br_hash_class;
+struct br_hash_class_
+{
+  size_t context_size;
+  uint32_t desc;
+  void (*init)(const br_hash_class **ctx);
+  void (*update)(const br_hash_class **ctx, const void *data, size_t len);
+  void (*out)(const br_hash_class *const *ctx, void *dst);
+};
+
+#define br_sha1_ID 2
+#define br_sha1_SIZE 20
+#define br_sha256_ID 4
+#define br_sha256_SIZE 32
+
+typedef struct
+{
+  const br_hash_class *vtable;
+  unsigned char buf[64];
+  uint64_t count;
+  uint32_t val[5];
+} br_sha1_context;
+
+typedef struct
+{
+  const br_hash_class *vtable;
+  unsigned char buf[64];
+  uint64_t count;
+  uint32_t val[8];
+} br_sha256_context;
+
+typedef union
+{
+  const br_hash_class *vtable;
+  br_sha1_context sha1;
+  br_sha256_context sha256;
+} br_hash_compat_context;
+
+extern const br_hash_class br_sha1_vtable;
+extern const br_hash_class br_sha256_vtable;
+
+void br_sha1_init(br_sha1_context *ctx);
+void br_sha1_update(br_sha1_context *ctx, const void *data, size_t len);
+void br_sha1_out(const br_sha1_context *ctx, void *out);
+
+void br_sha256_init(br_sha256_context *ctx);
+void br_sha256_update(br_sha256_context *ctx, const void *data, size_t len);
+void br_sha256_out(const br_sha256_context *ctx, void *out);
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "bearssl_hash.h"
+
+// 鍵から作ったipad/opadのハッシュの途中状態を保持する (本物と同じく、HMAC1回あたりの圧縮は2ブロック + データ分)
+typedef struct
+{
+  const br_hash_class *dig_vtable;
+  br_hash_compat_context ksi;
+  br_hash_compat_context kso;
+} br_hmac_key_context;
+
+typedef struct
+{
+  br_hash_compat_context dig;
+  br_hash_compat_context kso;
+  size_t out_len;
+} br_hmac_context;
+
+void br_hmac_key_init(br_hmac_key_context *kc, const br_hash_class *digest_vtable, const void *key, size_t key_len);
+void br_hmac_init(br_hmac_context *ctx, const br_hmac_key_context *kc, size_t out_len);
+size_t br_hmac_size(br_hmac_context *ctx);
+void br_hmac_update(br_hmac_context *ctx, const void *data, size_t len);
+size_t br_hmac_out(const br_hmac_context *ctx, void *out);
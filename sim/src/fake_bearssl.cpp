@@ -0,0 +1,286 @@
+// BearSSLのSHA-1 / SHA-256 / HMACの代替
+#include <bearssl/bearssl_hmac.h>
+#include <string.h>
+#include "sim_world.h"
+
+// ESP8266 (80MHz) で64バイトのブロック1つを圧縮する時間 (µs)
+#define SHA1_BLOCK_MICROS 20
+#define SHA256_BLOCK_MICROS 40
+
+// falseの間は処理時間を仮想時計に加算しない (仮想世界側の計算)
+static bool chargeTime = true;
+
+static uint32_t rotl(uint32_t x, int n)
+{
+  return (x << n) | (x >> (32 - n));
+}
+
+static uint32_t rotr(uint32_t x, int n)
+{
+  return (x >> n) | (x << (32 - n));
+}
+
+static uint32_t loadBe32(const unsigned char *p)
+{
+  return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+}
+
+static void storeBe32(unsigned char *p, uint32_t v)
+{
+  p[0] = v >> 24;
+  p[1] = v >> 16;
+  p[2] = v >> 8;
+  p[3] = v;
+}
+
+// --- SHA-1 ---
+
+static void sha1Compress(uint32_t *val, const unsigned char *block)
+{
+  uint32_t w[80];
+  for (int i = 0; i < 16; i++)
+    w[i] = loadBe32(block + i * 4);
+  for (int i = 16; i < 80; i++)
+    w[i] = rotl(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+
+  uint32_t a = val[0], b = val[1], c = val[2], d = val[3], e = val[4];
+  for (int i = 0; i < 80; i++)
+  {
+    uint32_t f, k;
+    if (i < 20)
+      f = (b & c) | (~b & d), k = 0x5A827999;
+    else if (i < 40)
+      f = b ^ c ^ d, k = 0x6ED9EBA1;
+    else if (i < 60)
+      f = (b & c) | (b & d) | (c & d), k = 0x8F1BBCDC;
+    else
+      f = b ^ c ^ d, k = 0xCA62C1D6;
+    uint32_t t = rotl(a, 5) + f + e + k + w[i];
+    e = d;
+    d = c;
+    c = rotl(b, 30);
+    b = a;
+    a = t;
+  }
+  val[0] += a;
+  val[1] += b;
+  val[2] += c;
+  val[3] += d;
+  val[4] += e;
+  if (chargeTime)
+    simAdvance(SHA1_BLOCK_MICROS);
+}
+
+// --- SHA-256 ---
+
+static const uint32_t SHA256_K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+static void sha256Compress(uint32_t *val, const unsigned char *block)
+{
+  uint32_t w[64];
+  for (int i = 0; i < 16; i++)
+    w[i] = loadBe32(block + i * 4);
+  for (int i = 16; i < 64; i++)
+  {
+    uint32_t s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+    uint32_t s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+    w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+  }
+
+  uint32_t a = val[0], b = val[1], c = val[2], d = val[3], e = val[4], f = val[5], g = val[6], h = val[7];
+  for (int i = 0; i < 64; i++)
+  {
+    uint32_t t1 = h + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) + ((e & f) ^ (~e & g)) + SHA256_K[i] + w[i];
+    uint32_t t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+    h = g;
+    g = f;
+    f = e;
+    e = d + t1;
+    d = c;
+    c = b;
+    b = a;
+    a = t1 + t2;
+  }
+  val[0] += a;
+  val[1] += b;
+  val[2] += c;
+  val[3] += d;
+  val[4] += e;
+  val[5] += f;
+  val[6] += g;
+  val[7] += h;
+  if (chargeTime)
+    simAdvance(SHA256_BLOCK_MICROS);
+}
+
+// --- 共通 (Merkle-Damgård) ---
+
+template <typename Context>
+static void hashUpdate(Context *ctx, const void *data, size_t len, void (*compress)(uint32_t *, const unsigned char *))
+{
+  const unsigned char *p = (const unsigned char *)data;
+  while (len > 0)
+  {
+    size_t used = ctx->count & 63;
+    size_t n = 64 - used < len ? 64 - used : len;
+    memcpy(ctx->buf + used, p, n);
+    ctx->count += n;
+    p += n;
+    len -= n;
+    if ((ctx->count & 63) == 0)
+      compress(ctx->val, ctx->buf);
+  }
+}
+
+template <typename Context>
+static void hashOut(const Context *ctx, unsigned char *out, size_t words, void (*compress)(uint32_t *, const unsigned char *))
+{
+  Context copy = *ctx;
+  uint64_t bits = copy.count * 8;
+  unsigned char pad = 0x80;
+  hashUpdate(&copy, &pad, 1, compress);
+  pad = 0;
+  while ((copy.count & 63) != 56)
+    hashUpdate(&copy, &pad, 1, compress);
+  unsigned char length[8];
+  for (int i = 0; i < 8; i++)
+    length[i] = bits >> (56 - i * 8);
+  hashUpdate(&copy, length, 8, compress);
+  for (size_t i = 0; i < words; i++)
+    storeBe32(out + i * 4, copy.val[i]);
+}
+
+void br_sha1_init(br_sha1_context *ctx)
+{
+  static const uint32_t IV[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+  ctx->vtable = &br_sha1_vtable;
+  ctx->count = 0;
+  memcpy(ctx->val, IV, sizeof(IV));
+}
+
+void br_sha1_update(br_sha1_context *ctx, const void *data, size_t len)
+{
+  hashUpdate(ctx, data, len, sha1Compress);
+}
+
+void br_sha1_out(const br_sha1_context *ctx, void *out)
+{
+  hashOut(ctx, (unsigned char *)out, 5, sha1Compress);
+}
+
+void br_sha256_init(br_sha256_context *ctx)
+{
+  static const uint32_t IV[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+                                 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+  ctx->vtable = &br_sha256_vtable;
+  ctx->count = 0;
+  memcpy(ctx->val, IV, sizeof(IV));
+}
+
+void br_sha256_update(br_sha256_context *ctx, const void *data, size_t len)
+{
+  hashUpdate(ctx, data, len, sha256Compress);
+}
+
+void br_sha256_out(const br_sha256_context *ctx, void *out)
+{
+  hashOut(ctx, (unsigned char *)out, 8, sha256Compress);
+}
+
+const br_hash_class br_sha1_vtable = {
+    sizeof(br_sha1_context), br_sha1_ID | (br_sha1_SIZE << 8),
+    [](const br_hash_class **ctx) { br_sha1_init((br_sha1_context *)ctx); },
+    [](const br_hash_class **ctx, const void *data, size_t len) { br_sha1_update((br_sha1_context *)ctx, data, len); },
+    [](const br_hash_class *const *ctx, void *dst) { br_sha1_out((const br_sha1_context *)ctx, dst); }};
+
+const br_hash_class br_sha256_vtable = {
+    sizeof(br_sha256_context), br_sha256_ID | (br_sha256_SIZE << 8),
+    [](const br_hash_class **ctx) { br_sha256_init((br_sha256_context *)ctx); },
+    [](const br_hash_class **ctx, const void *data, size_t len) { br_sha256_update((br_sha256_context *)ctx, data, len); },
+    [](const br_hash_class *const *ctx, void *dst) { br_sha256_out((const br_sha256_context *)ctx, dst); }};
+
+// --- HMAC ---
+
+static size_t digestSize(const br_hash_class *vtable)
+{
+  return (vtable->desc >> 8) & 0x7F;
+}
+
+void br_hmac_key_init(br_hmac_key_context *kc, const br_hash_class *digest_vtable, const void *key, size_t key_len)
+{
+  unsigned char block[64] = {0};
+  kc->dig_vtable = digest_vtable;
+  if (key_len > sizeof(block))
+  {
+    br_hash_compat_context h;
+    digest_vtable->init(&h.vtable);
+    digest_vtable->update(&h.vtable, key, key_len);
+    digest_vtable->out(&h.vtable, block);
+  }
+  else
+  {
+    memcpy(block, key, key_len);
+  }
+
+  unsigned char pad[64];
+  for (size_t i = 0; i < sizeof(pad); i++)
+    pad[i] = block[i] ^ 0x36;
+  digest_vtable->init(&kc->ksi.vtable);
+  digest_vtable->update(&kc->ksi.vtable, pad, sizeof(pad));
+  for (size_t i = 0; i < sizeof(pad); i++)
+    pad[i] = block[i] ^ 0x5C;
+  digest_vtable->init(&kc->kso.vtable);
+  digest_vtable->update(&kc->kso.vtable, pad, sizeof(pad));
+}
+
+void br_hmac_init(br_hmac_context *ctx, const br_hmac_key_context *kc, size_t out_len)
+{
+  ctx->dig = kc->ksi;
+  ctx->kso = kc->kso;
+  size_t size = digestSize(kc->dig_vtable);
+  ctx->out_len = out_len == 0 || out_len > size ? size : out_len;
+}
+
+size_t br_hmac_size(br_hmac_context *ctx)
+{
+  return ctx->out_len;
+}
+
+void br_hmac_update(br_hmac_context *ctx, const void *data, size_t len)
+{
+  ctx->dig.vtable->update(&ctx->dig.vtable, data, len);
+}
+
+size_t br_hmac_out(const br_hmac_context *ctx, void *out)
+{
+  unsigned char inner[64];
+  const br_hash_class *vtable = ctx->dig.vtable;
+  vtable->out(&ctx->dig.vtable, inner);
+
+  br_hash_compat_context outer = ctx->kso;
+  vtable->update(&outer.vtable, inner, digestSize(vtable));
+  unsigned char digest[64];
+  vtable->out(&outer.vtable, digest);
+  memcpy(out, digest, ctx->out_len);
+  return ctx->out_len;
+}
+
+void simHmacSha256(const void *key, size_t keyLen, const void *data, size_t len, uint8_t out[32])
+{
+  chargeTime = false;
+  br_hmac_key_context kc;
+  br_hmac_context ctx;
+  br_hmac_key_init(&kc, &br_sha256_vtable, key, keyLen);
+  br_hmac_init(&ctx, &kc, 0);
+  br_hmac_update(&ctx, data, len);
+  br_hmac_out(&ctx, out);
+  chargeTime = true;
+}
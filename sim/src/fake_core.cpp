@@ -0,0 +1,574 @@
+// Arduinoコア (String / Print / Stream / Serial / ESP / Updater / Ticker / 時刻 / GPIO) と DHT・EEPROM の偽物
+#include <Arduino.h>
+#include <DHT.h>
+#include <EEPROM.h>
+#include <Ticker.h>
+#include <Updater.h>
+#include <vector>
+#include <user_interface.h>
+#include "sim_world.h"
+
+// 1回のyield()でWiFiスタックなどのバックグラウンド処理に使われる時間 (µs)
+#define YIELD_COST_MICROS 20
+// DHT11の読み取りにかかる時間 (スタート信号18ms + 応答)
+#define DHT_READ_MICROS 23000
+// DHTライブラリが前回の値を返す最短の読み取り間隔 (ms)
+#define DHT_MIN_INTERVAL_MS 2000
+// フラッシュのセクターの大きさと、1セクターの消去 (約45ms) と書き込み (256バイトのページごとに約0.7ms) にかかる時間
+#define FLASH_SECTOR_SIZE 4096
+#define FLASH_SECTOR_MICROS 56000
+// 更新イメージを書き込める領域の大きさ (1MBのフラッシュから現在のスケッチとファイルシステムなどを除いた残り)
+#define FREE_SKETCH_SPACE (600 * 1024)
+
+HardwareSerial Serial;
+EspClass ESP;
+EEPROMClass EEPROM;
+UpdaterClass Update;
+
+// --- 時間 ---
+
+unsigned long millis()
+{
+  return (unsigned long)(simUptimeMicros() / 1000);
+}
+
+unsigned long micros()
+{
+  // ESP8266と同じく32ビットで折り返す
+  return (uint32_t)simUptimeMicros();
+}
+
+void delay(unsigned long ms)
+{
+  simAdvance((uint64_t)ms * 1000);
+  simSdkService();
+}
+
+void delayMicroseconds(unsigned int us)
+{
+  simAdvance(us);
+}
+
+void yield()
+{
+  simAdvance(YIELD_COST_MICROS);
+  simSdkService();
+}
+
+void configTime(int timezone, int daylightOffset_sec, const char *server1, const char *server2, const char *server3)
+{
+  (void)server1;
+  (void)server2;
+  (void)server3;
+  simConfigTime(timezone, daylightOffset_sec);
+}
+
+// ESP8266コアのtime()はNTPで同期した時刻 (同期前は起動からの秒数) を返す。libcのtime()を置き換える
+extern "C" time_t time(time_t *t) noexcept
+{
+  time_t now = (time_t)simEpochSeconds();
+  if (t)
+    *t = now;
+  return now;
+}
+
+bool getLocalTime(struct tm *info, uint32_t ms)
+{
+  // ESP8266コアと同じく、時刻が同期されるまで10msごとに最大ms待つ
+  uint32_t start = millis();
+  while (millis() - start <= ms)
+  {
+    time_t now = (time_t)(simEpochSeconds() + simGmtOffset());
+    gmtime_r(&now, info);
+    if (info->tm_year > (2016 - 1900))
+      return true;
+    delay(10);
+  }
+  return false;
+}
+
+// --- GPIO ---
+
+void pinMode(uint8_t pin, uint8_t mode)
+{
+  (void)pin;
+  (void)mode;
+}
+
+int digitalRead(uint8_t pin)
+{
+  return simDigitalRead(pin);
+}
+
+void digitalWrite(uint8_t pin, uint8_t value)
+{
+  (void)pin;
+  (void)value;
+}
+
+// --- String ---
+
+String::String(long value, unsigned char base)
+{
+  char buf[34];
+  if (base == 10)
+    snprintf(buf, sizeof(buf), "%ld", value);
+  else
+    snprintf(buf, sizeof(buf), base == 16 ? "%lx" : "%lo", value);
+  _s = buf;
+}
+
+String::String(unsigned long value, unsigned char base)
+{
+  char buf[34];
+  snprintf(buf, sizeof(buf), base == 16 ? "%lx" : (base == 8 ? "%lo" : "%lu"), value);
+  _s = buf;
+}
+
+String::String(double value, unsigned char decimalPlaces)
+{
+  char buf[48];
+  snprintf(buf, sizeof(buf), "%.*f", decimalPlaces, value);
+  _s = buf;
+}
+
+void String::trim()
+{
+  size_t first = _s.find_first_not_of(" \t\r\n");
+  size_t last = _s.find_last_not_of(" \t\r\n");
+  _s = first == std::string::npos ? std::string() : _s.substr(first, last - first + 1);
+}
+
+void String::toLowerCase()
+{
+  for (char &c : _s)
+    c = tolower((unsigned char)c);
+}
+
+void String::toUpperCase()
+{
+  for (char &c : _s)
+    c = toupper((unsigned char)c);
+}
+
+// --- Print ---
+
+size_t Print::write(const uint8_t *buffer, size_t size)
+{
+  size_t n = 0;
+  while (size--)
+    n += write(*buffer++);
+  return n;
+}
+
+size_t Print::print(long value, int base)
+{
+  return print(String(value, (unsigned char)base));
+}
+
+size_t Print::print(unsigned long value, int base)
+{
+  return print(String(value, (unsigned char)base));
+}
+
+size_t Print::print(double value, int digits)
+{
+  if (isnan(value))
+    return print("nan");
+  return print(String(value, (unsigned char)digits));
+}
+
+size_t Print::vprintf(const char *format, va_list args)
+{
+  char buf[256];
+  int len = vsnprintf(buf, sizeof(buf), format, args);
+  if (len < 0)
+    return 0;
+  return write((const uint8_t *)buf, std::min((size_t)len, sizeof(buf) - 1));
+}
+
+size_t Print::printf(const char *format, ...)
+{
+  va_list args;
+  va_start(args, format);
+  size_t n = vprintf(format, args);
+  va_end(args);
+  return n;
+}
+
+size_t Print::printf_P(const char *format, ...)
+{
+  va_list args;
+  va_start(args, format);
+  size_t n = vprintf(format, args);
+  va_end(args);
+  return n;
+}
+
+// --- Stream ---
+
+int Stream::timedRead()
+{
+  unsigned long start = millis();
+  do
+  {
+    int c = read();
+    if (c >= 0)
+      return c;
+    yield();
+  } while (millis() - start < _timeout);
+  return -1;
+}
+
+int Stream::timedPeek()
+{
+  unsigned long start = millis();
+  do
+  {
+    int c = peek();
+    if (c >= 0)
+      return c;
+    yield();
+  } while (millis() - start < _timeout);
+  return -1;
+}
+
+bool Stream::findUntil(const char *target, const char *terminator)
+{
+  size_t targetLen = strlen(target);
+  size_t termLen = terminator ? strlen(terminator) : 0;
+  size_t index = 0;
+  size_t termIndex = 0;
+  if (targetLen == 0)
+    return true;
+
+  int c;
+  while ((c = timedRead()) > 0)
+  {
+    if (c == target[index])
+    {
+      if (++index >= targetLen)
+        return true;
+    }
+    else
+    {
+      index = c == target[0] ? 1 : 0;
+    }
+
+    if (termLen > 0 && c == terminator[termIndex])
+    {
+      if (++termIndex >= termLen)
+        return false;
+    }
+    else
+    {
+      termIndex = termLen > 0 && c == terminator[0] ? 1 : 0;
+    }
+  }
+  return false;
+}
+
+size_t Stream::readBytes(char *buffer, size_t length)
+{
+  size_t count = 0;
+  while (count < length)
+  {
+    int c = timedRead();
+    if (c < 0)
+      break;
+    *buffer++ = (char)c;
+    count++;
+  }
+  return count;
+}
+
+String Stream::readString()
+{
+  std::string result;
+  int c;
+  while ((c = timedRead()) >= 0)
+    result += (char)c;
+  return String(result);
+}
+
+String Stream::readStringUntil(char terminator)
+{
+  std::string result;
+  int c;
+  while ((c = timedRead()) >= 0 && c != terminator)
+    result += (char)c;
+  return String(result);
+}
+
+// --- Serial (送信FIFOをボーレートで排出する) ---
+
+#define UART_TX_FIFO_SIZE 128
+
+void HardwareSerial::drain()
+{
+  uint64_t now = simNowMicros();
+  uint64_t microsPerByte = 10000000ULL / _baud; // スタート・ストップビットを含めて10ビット
+  uint64_t sent = (now - _txUpdated) / microsPerByte;
+  if (sent >= _txPending)
+  {
+    _txPending = 0;
+    _txUpdated = now;
+  }
+  else
+  {
+    _txPending -= sent;
+    _txUpdated += sent * microsPerByte;
+  }
+}
+
+int HardwareSerial::availableForWrite()
+{
+  drain();
+  return UART_TX_FIFO_SIZE - (int)_txPending;
+}
+
+size_t HardwareSerial::write(const uint8_t *buffer, size_t size)
+{
+  simSerialOutput(buffer, size);
+  for (size_t i = 0; i < size; i++)
+  {
+    // FIFOが一杯の間は、本物と同じく空きができるまでブロックする
+    while (availableForWrite() <= 0)
+      simAdvance(10000000ULL / _baud);
+    _txPending++;
+  }
+  return size;
+}
+
+void HardwareSerial::flush()
+{
+  drain();
+  simAdvance(_txPending * (10000000ULL / _baud));
+  drain();
+}
+
+int HardwareSerial::available()
+{
+  return (_peeked >= 0 ? 1 : 0) + simSerialAvailable();
+}
+
+int HardwareSerial::read()
+{
+  if (_peeked >= 0)
+  {
+    int c = _peeked;
+    _peeked = -1;
+    return c;
+  }
+  return simSerialRead();
+}
+
+int HardwareSerial::peek()
+{
+  if (_peeked < 0)
+    _peeked = simSerialRead();
+  return _peeked;
+}
+
+// --- ESP ---
+
+uint32_t EspClass::getFreeHeap()
+{
+  return 31000;
+}
+
+uint8_t EspClass::getHeapFragmentation()
+{
+  return 12;
+}
+
+uint32_t EspClass::getMaxFreeBlockSize()
+{
+  return 27000;
+}
+
+const rst_info *EspClass::getResetInfoPtr()
+{
+  static rst_info info;
+  memset(&info, 0, sizeof(info));
+  info.reason = simResetReason();
+  return &info;
+}
+
+bool EspClass::rtcUserMemoryRead(uint32_t offset, uint32_t *data, size_t size)
+{
+  if (offset * 4 + size > 512)
+    return false;
+  memcpy(data, simRtcMemory() + offset * 4, size);
+  return true;
+}
+
+bool EspClass::rtcUserMemoryWrite(uint32_t offset, uint32_t *data, size_t size)
+{
+  if (offset * 4 + size > 512)
+    return false;
+  memcpy(simRtcMemory() + offset * 4, data, size);
+  return true;
+}
+
+void EspClass::restart()
+{
+  simRestart();
+}
+
+// --- Updater ---
+
+bool UpdaterClass::begin(size_t size, int command, int ledPin, uint8_t ledOn)
+{
+  (void)command;
+  (void)ledPin;
+  (void)ledOn;
+  reset();
+  if (size == 0)
+  {
+    _error = UPDATE_ERROR_SIZE;
+    return false;
+  }
+  if (size > FREE_SKETCH_SPACE)
+  {
+    _error = UPDATE_ERROR_SPACE;
+    return false;
+  }
+  _size = size;
+  simTrace("ota begin %u", (unsigned)size);
+  return true;
+}
+
+size_t UpdaterClass::write(uint8_t *data, size_t len)
+{
+  if (_size == 0 || hasError())
+    return 0;
+  if (len > remaining())
+  {
+    _error = UPDATE_ERROR_SPACE;
+    return 0;
+  }
+  // 本物と同じく、先頭のバイトでイメージ (0xE9) かgzip (0x1F 0x8B) かを確認する
+  if (_written == 0 && len > 0 && data[0] != 0xE9 && data[0] != 0x1F)
+  {
+    _error = UPDATE_ERROR_MAGIC_BYTE;
+    return 0;
+  }
+  _written += len;
+  _buffered += len;
+  // セクターが埋まるたび (最後は端数でも) 消去して書き込む
+  while (_buffered >= FLASH_SECTOR_SIZE || (_buffered > 0 && _written == _size))
+  {
+    simAdvance(FLASH_SECTOR_MICROS);
+    _buffered -= std::min(_buffered, (size_t)FLASH_SECTOR_SIZE);
+  }
+  simActivity();
+  return len;
+}
+
+bool UpdaterClass::end(bool evenIfRemaining)
+{
+  if (_size == 0)
+    return false;
+  if (hasError() || (!isFinished() && !evenIfRemaining))
+  {
+    simTrace("ota discard %u", (unsigned)_written);
+    reset();
+    return false;
+  }
+  simTrace("ota staged %u", (unsigned)_written);
+  reset();
+  return true;
+}
+
+String UpdaterClass::getErrorString() const
+{
+  switch (_error)
+  {
+  case UPDATE_ERROR_OK:
+    return String("No Error");
+  case UPDATE_ERROR_WRITE:
+    return String("Flash Write Failed");
+  case UPDATE_ERROR_SPACE:
+    return String("Not Enough Space");
+  case UPDATE_ERROR_SIZE:
+    return String("Bad Size Given");
+  case UPDATE_ERROR_MAGIC_BYTE:
+    return String("Magic byte is not 0xE9");
+  default:
+    return String("UNKNOWN");
+  }
+}
+
+void UpdaterClass::reset()
+{
+  _size = 0;
+  _written = 0;
+  _buffered = 0;
+  _error = UPDATE_ERROR_OK;
+}
+
+// --- Ticker (SDKのタイマー) ---
+
+static std::vector<Ticker *> tickers;
+
+void Ticker::attach_ms(uint32_t milliseconds, callback_t callback)
+{
+  detach();
+  _callback = callback;
+  _period = (uint64_t)milliseconds * 1000;
+  _next = simNowMicros() + _period;
+  tickers.push_back(this);
+}
+
+void Ticker::detach()
+{
+  _callback = nullptr;
+  tickers.erase(std::remove(tickers.begin(), tickers.end(), this), tickers.end());
+}
+
+void Ticker::simService(uint64_t now)
+{
+  if (!_callback || now < _next)
+    return;
+  // 制御が戻らなかった間の呼び出しは、本物と同じく1回にまとまる
+  _next = now + _period;
+  _callback();
+}
+
+void simSdkService()
+{
+  uint64_t now = simNowMicros();
+  for (size_t i = 0; i < tickers.size(); i++)
+    tickers[i]->simService(now);
+}
+
+// --- DHT ---
+
+bool DHT::read(bool force)
+{
+  unsigned long now = millis();
+  if (!force && _started && now - _lastReadTime < DHT_MIN_INTERVAL_MS)
+    return _lastResult;
+  _started = true;
+  _lastReadTime = now;
+
+  simAdvance(DHT_READ_MICROS);
+  simActivity();
+  _lastResult = simDhtRead(_temp, _hum);
+  return _lastResult;
+}
+
+float DHT::readTemperature(bool fahrenheit, bool force)
+{
+  if (!read(force))
+    return NAN;
+  return fahrenheit ? _temp * 1.8f + 32 : _temp;
+}
+
+float DHT::readHumidity(bool force)
+{
+  if (!read(force))
+    return NAN;
+  return _hum;
+}
@@ -0,0 +1,250 @@
+// I2C (Wire)・Adafruit GFX・SSD1306の偽物
+#include <Adafruit_SSD1306.h>
+#include "sim_world.h"
+
+TwoWire Wire;
+
+// --- Wire ---
+
+uint8_t TwoWire::endTransmission(bool sendStop)
+{
+  (void)sendStop;
+  uint8_t status = simI2cWrite(_address, _buffer, _length, _clockHz);
+  _length = 0;
+  return status;
+}
+
+// --- Adafruit GFX ---
+
+void Adafruit_GFX::fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color)
+{
+  for (int16_t j = y; j < y + h; j++)
+  {
+    for (int16_t i = x; i < x + w; i++)
+      drawPixel(i, j, color);
+  }
+}
+
+void Adafruit_GFX::drawRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color)
+{
+  drawFastHLine(x, y, w, color);
+  drawFastHLine(x, y + h - 1, w, color);
+  drawFastVLine(x, y, h, color);
+  drawFastVLine(x + w - 1, y, h, color);
+}
+
+// ブレゼンハムのアルゴリズム
+void Adafruit_GFX::drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t color)
+{
+  int16_t dx = abs(x1 - x0), dy = -abs(y1 - y0);
+  int16_t sx = x0 < x1 ? 1 : -1, sy = y0 < y1 ? 1 : -1;
+  int16_t err = dx + dy;
+  while (true)
+  {
+    drawPixel(x0, y0, color);
+    if (x0 == x1 && y0 == y1)
+      break;
+    int16_t e2 = 2 * err;
+    if (e2 >= dy)
+    {
+      err += dy;
+      x0 += sx;
+    }
+    if (e2 <= dx)
+    {
+      err += dx;
+      y0 += sy;
+    }
+  }
+}
+
+void Adafruit_GFX::drawChar(int16_t x, int16_t y, unsigned char c, uint16_t color, uint16_t bg, uint8_t size)
+{
+  // 5x7の模様 (空白は何も描かない) + 1列・1行の余白
+  for (int8_t col = 0; col < 6; col++)
+  {
+    for (int8_t row = 0; row < 8; row++)
+    {
+      bool on = false;
+      if (c != ' ' && col < 5 && row < 7)
+        on = ((c * 37u + col * 11u + row * 7u) * 2654435761u >> 29) & 1;
+      if (!on && bg == color)
+        continue;
+      fillRect(x + col * size, y + row * size, size, size, on ? color : bg);
+    }
+  }
+}
+
+size_t Adafruit_GFX::write(uint8_t c)
+{
+  if (c == '\n')
+  {
+    _cursorX = 0;
+    _cursorY += _textSize * 8;
+    return 1;
+  }
+  if (c == '\r')
+    return 1;
+
+  if (_wrap && _cursorX + _textSize * 6 > _width)
+  {
+    _cursorX = 0;
+    _cursorY += _textSize * 8;
+  }
+  drawChar(_cursorX, _cursorY, c, _textColor, _textBgColor, _textSize);
+
+  bool inverted = _textBgColor != _textColor && _textColor == SSD1306_BLACK;
+  if (!_spans.empty())
+  {
+    TextSpan &last = _spans.back();
+    if (last.y == _cursorY && last.size == _textSize && last.inverted == inverted &&
+        last.x + (int16_t)(last.text.size() * 6 * _textSize) == _cursorX)
+    {
+      last.text += (char)c;
+      _cursorX += _textSize * 6;
+      return 1;
+    }
+  }
+  _spans.push_back({_cursorX, _cursorY, _textSize, inverted, std::string(1, (char)c)});
+  _cursorX += _textSize * 6;
+  return 1;
+}
+
+// --- Adafruit SSD1306 ---
+
+bool Adafruit_SSD1306::begin(uint8_t vccState, uint8_t i2cAddress, bool reset, bool periphBegin)
+{
+  (void)vccState;
+  (void)reset;
+  if (!_buffer)
+    _buffer = new uint8_t[_width * ((_height + 7) / 8)];
+  clearDisplay();
+  if (i2cAddress)
+    _address = i2cAddress;
+  if (periphBegin)
+    _wire->begin();
+
+  // 本物のライブラリと同じ初期化コマンド (水平アドレッシングモード)
+  const uint8_t init[] = {
+      SSD1306_DISPLAYOFF, SSD1306_SETDISPLAYCLOCKDIV, 0x80, SSD1306_SETMULTIPLEX, (uint8_t)(_height - 1),
+      SSD1306_SETDISPLAYOFFSET, 0x00, SSD1306_SETSTARTLINE | 0x0, SSD1306_CHARGEPUMP, 0x14,
+      SSD1306_MEMORYMODE, 0x00, SSD1306_SEGREMAP | 0x1, SSD1306_COMSCANDEC,
+      SSD1306_SETCOMPINS, 0x12, SSD1306_SETCONTRAST, 0xCF, SSD1306_SETPRECHARGE, 0xF1,
+      SSD1306_SETVCOMDETECT, 0x40, SSD1306_DISPLAYALLON_RESUME, SSD1306_NORMALDISPLAY,
+      SSD1306_DEACTIVATE_SCROLL, SSD1306_DISPLAYON};
+  _wire->setClock(_clockDuring);
+  commandList(init, sizeof(init));
+  _wire->setClock(_clockAfter);
+  return true;
+}
+
+void Adafruit_SSD1306::clearDisplay()
+{
+  memset(_buffer, 0, _width * ((_height + 7) / 8));
+  clearTextSpans();
+  _dirty = true;
+}
+
+void Adafruit_SSD1306::drawPixel(int16_t x, int16_t y, uint16_t color)
+{
+  if (x < 0 || x >= _width || y < 0 || y >= _height)
+    return;
+  uint8_t *byte = &_buffer[x + (y / 8) * _width];
+  uint8_t bit = 1 << (y & 7);
+  switch (color)
+  {
+  case SSD1306_WHITE:
+    *byte |= bit;
+    break;
+  case SSD1306_BLACK:
+    *byte &= ~bit;
+    break;
+  case SSD1306_INVERSE:
+    *byte ^= bit;
+    break;
+  }
+  _dirty = true;
+}
+
+void Adafruit_SSD1306::ssd1306_command(uint8_t c)
+{
+  _wire->beginTransmission(_address);
+  _wire->write((uint8_t)0x00);
+  _wire->write(c);
+  _wire->endTransmission();
+}
+
+void Adafruit_SSD1306::commandList(const uint8_t *c, uint8_t n)
+{
+  _wire->beginTransmission(_address);
+  _wire->write((uint8_t)0x00);
+  size_t bytesOut = 1;
+  while (n--)
+  {
+    if (bytesOut >= BUFFER_LENGTH)
+    {
+      _wire->endTransmission();
+      _wire->beginTransmission(_address);
+      _wire->write((uint8_t)0x00);
+      bytesOut = 1;
+    }
+    _wire->write(*c++);
+    bytesOut++;
+  }
+  _wire->endTransmission();
+}
+
+void Adafruit_SSD1306::registerFrame()
+{
+  if (!_dirty)
+    return;
+  _dirty = false;
+
+  std::string text;
+  for (const TextSpan &span : _spans)
+  {
+    if (!text.empty())
+      text += " | ";
+    if (span.inverted)
+      text += "*";
+    // フォント固有の文字 (°など) はトレースでは'?'にする
+    for (char c : span.text)
+      text += (uint8_t)c >= 0x20 && (uint8_t)c < 0x7F ? c : '?';
+  }
+  simRegisterFrame(simFrameHash(_buffer, _width * ((_height + 7) / 8)), text);
+}
+
+uint8_t *Adafruit_SSD1306::getBuffer()
+{
+  registerFrame();
+  return _buffer;
+}
+
+void Adafruit_SSD1306::display()
+{
+  registerFrame();
+
+  const uint8_t window[] = {SSD1306_PAGEADDR, 0, 0xFF, SSD1306_COLUMNADDR, 0, (uint8_t)(_width - 1)};
+  _wire->setClock(_clockDuring);
+  commandList(window, sizeof(window));
+
+  size_t count = _width * ((_height + 7) / 8);
+  const uint8_t *ptr = _buffer;
+  _wire->beginTransmission(_address);
+  _wire->write((uint8_t)0x40);
+  size_t bytesOut = 1;
+  while (count--)
+  {
+    if (bytesOut >= BUFFER_LENGTH)
+    {
+      _wire->endTransmission();
+      _wire->beginTransmission(_address);
+      _wire->write((uint8_t)0x40);
+      bytesOut = 1;
+    }
+    _wire->write(*ptr++);
+    bytesOut++;
+  }
+  _wire->endTransmission();
+  _wire->setClock(_clockAfter);
+}
@@ -0,0 +1,65 @@
+// WiFi・DNS・HTTPClientの偽物 (通信の結果は仮想世界のネットワークのモデルが決める)
+#include <ESP8266HTTPClient.h>
+#include "sim_world.h"
+
+ESP8266WiFiClass WiFi;
+
+wl_status_t ESP8266WiFiClass::begin(const char *ssid, const char *passphrase, int32_t channel,
+                                    const uint8_t *bssid, bool connect)
+{
+  (void)ssid;
+  // ESP8266コアと同じく、16進数64文字はパスフレーズではなくPSKとして扱う
+  bool psk = passphrase && strlen(passphrase) == 64;
+  if (connect)
+    simWifiBegin(bssid, channel, psk);
+  return status();
+}
+
+bool ESP8266WiFiClass::disconnect(bool wifiOff)
+{
+  (void)wifiOff;
+  simWifiDisconnect();
+  return true;
+}
+
+int ESP8266WiFiClass::hostByName(const char *host, IPAddress &result)
+{
+  if (!simDnsLookup(host))
+  {
+    result = IPAddress();
+    return 0;
+  }
+  result = IPAddress(203, 0, 113, 10);
+  return 1;
+}
+
+String HTTPClient::errorToString(int error)
+{
+  switch (error)
+  {
+  case HTTPC_ERROR_CONNECTION_FAILED:
+    return F("connection failed");
+  case HTTPC_ERROR_SEND_HEADER_FAILED:
+    return F("send header failed");
+  case HTTPC_ERROR_SEND_PAYLOAD_FAILED:
+    return F("send payload failed");
+  case HTTPC_ERROR_NOT_CONNECTED:
+    return F("not connected");
+  case HTTPC_ERROR_CONNECTION_LOST:
+    return F("connection lost");
+  case HTTPC_ERROR_NO_STREAM:
+    return F("no stream");
+  case HTTPC_ERROR_NO_HTTP_SERVER:
+    return F("no HTTP server");
+  case HTTPC_ERROR_TOO_LESS_RAM:
+    return F("too less ram");
+  case HTTPC_ERROR_ENCODING:
+    return F("Transfer-Encoding not supported");
+  case HTTPC_ERROR_STREAM_WRITE:
+    return F("Stream write error");
+  case HTTPC_ERROR_READ_TIMEOUT:
+    return F("read Timeout");
+  default:
+    return String();
+  }
+}
@@ -0,0 +1,94 @@
+// ESP8266WebServerの偽物 (リクエストはシナリオから届き、応答はapi.logに記録する)
+#include <ESP8266WebServer.h>
+#include "sim_world.h"
+
+// 応答を書き込むたびにかかる時間 (TCPの送信バッファへのコピーとlwIPの処理, µs)
+#define SEND_MICROS 300
+
+void ESP8266WebServer::handleClient()
+{
+  std::string method, target;
+  if (!_started || !simApiNextRequest(method, target))
+    return;
+
+  size_t query = target.find('?');
+  _uri = String(target.substr(0, query));
+  _method = method == "POST" ? HTTP_POST : HTTP_GET;
+  _args.clear();
+  if (query != std::string::npos)
+  {
+    std::string rest = target.substr(query + 1);
+    size_t start = 0;
+    while (start <= rest.size())
+    {
+      size_t end = rest.find('&', start);
+      std::string pair = rest.substr(start, end == std::string::npos ? std::string::npos : end - start);
+      size_t eq = pair.find('=');
+      if (!pair.empty())
+        _args.push_back({pair.substr(0, eq), eq == std::string::npos ? "" : pair.substr(eq + 1)});
+      if (end == std::string::npos)
+        break;
+      start = end + 1;
+    }
+  }
+
+  _status = 0;
+  _body.clear();
+  THandlerFunction handler = _notFound;
+  for (const Route &route : _routes)
+  {
+    if (route.uri == _uri.str() && (route.method == HTTP_ANY || route.method == _method))
+    {
+      handler = route.handler;
+      break;
+    }
+  }
+  if (handler)
+    handler();
+  else
+    send(404, "text/plain", "Not found");
+  simApiResponse(_status, _body);
+}
+
+bool ESP8266WebServer::hasArg(const String &name) const
+{
+  for (const auto &a : _args)
+  {
+    if (a.first == name.str())
+      return true;
+  }
+  return false;
+}
+
+String ESP8266WebServer::arg(const String &name) const
+{
+  for (const auto &a : _args)
+  {
+    if (a.first == name.str())
+      return String(a.second);
+  }
+  return String();
+}
+
+void ESP8266WebServer::send(int code, const char *contentType, const String &content)
+{
+  (void)contentType;
+  _status = code;
+  _body = content.str();
+  simAdvance(SEND_MICROS);
+}
+
+bool ESP8266WebServer::chunkedResponseModeStart(int code, const char *contentType)
+{
+  (void)contentType;
+  _status = code;
+  _body.clear();
+  simAdvance(SEND_MICROS);
+  return true;
+}
+
+void ESP8266WebServer::sendContent(const char *content, size_t size)
+{
+  _body.append(content, size);
+  simAdvance(SEND_MICROS);
+}
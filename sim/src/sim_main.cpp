@@ -0,0 +1,90 @@
+// シミュレーターのエントリーポイント。ファームウェアのsetup()/loop()を仮想時計の上で実行する
+//
+// 使い方: sim <シナリオ> [--out <出力先>] [--idle-step-ms <ms>]
+#include "sim_world.h"
+#include "sim_report.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+// loop()の1回ごとにコア (WiFiスタックなど) が使う時間 (µs)
+#define LOOP_OVERHEAD_MICROS 50
+// 何もしなかった反復の後に進める時間の既定値 (ms)
+#define DEFAULT_IDLE_STEP_MS 5
+
+void setup();
+void loop();
+
+static std::string outDir = "sim_out";
+
+void simFinish()
+{
+  double wallSeconds = simWallSeconds();
+  simWorldEnd();
+
+  FILE *report = fopen(simOutputPath("report.txt").c_str(), "w");
+  if (report)
+  {
+    simWriteReport(simOutputPath("trace.txt"), report, wallSeconds);
+    fclose(report);
+  }
+  simWriteReport(simOutputPath("trace.txt"), stdout, wallSeconds);
+  exit(0);
+}
+
+static void usage()
+{
+  fprintf(stderr, "usage: sim <scenario> [--out <dir>] [--idle-step-ms <ms>]\n");
+  exit(2);
+}
+
+int main(int argc, char **argv)
+{
+  const char *scenario = nullptr;
+  const char *resume = nullptr;
+  uint64_t idleStepMicros = DEFAULT_IDLE_STEP_MS * 1000;
+
+  for (int i = 1; i < argc; i++)
+  {
+    if (strcmp(argv[i], "--out") == 0 && i + 1 < argc)
+      outDir = argv[++i];
+    else if (strcmp(argv[i], "--idle-step-ms") == 0 && i + 1 < argc)
+      idleStepMicros = (uint64_t)(atof(argv[++i]) * 1000);
+    else if (strcmp(argv[i], "--resume") == 0 && i + 1 < argc)
+      resume = argv[++i]; // ESP.restart()による再起動 (内部で使用)
+    else if (argv[i][0] != '-' && !scenario)
+      scenario = argv[i];
+    else
+      usage();
+  }
+  if (!scenario || idleStepMicros == 0)
+    usage();
+
+  mkdir(outDir.c_str(), 0755);
+  if (!simWorldBegin(scenario, outDir.c_str(), resume, argv))
+    return 1;
+
+  setup();
+  for (;;)
+  {
+    uint32_t activity = simActivityCount();
+    loop();
+    simAdvance(LOOP_OVERHEAD_MICROS);
+    simSdkService();
+
+    // 外部との入出力がなかった反復の後は、次のイベントまで (最大idleStepMicros) 時間を進める
+    if (simActivityCount() == activity)
+    {
+      uint64_t target = simNowMicros() + idleStepMicros;
+      uint64_t next = simNextEventMicros();
+      if (next < target)
+        target = next;
+      if (target > simNowMicros())
+      {
+        simAdvanceTo(target);
+        simSdkService();
+      }
+    }
+  }
+}
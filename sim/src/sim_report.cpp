@@ -0,0 +1,413 @@
+// trace.txtの集計
+#include "sim_report.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+// ファームウェアの定期POSTの間隔 (main.cppのpostInterval)
+#define POST_INTERVAL_MS 600000.0
+// ボタン操作からこの時間内に動作がなければ、取りこぼしとして数える
+#define ACTION_TIMEOUT_MS 20000.0
+// main.cppのLONG_PRESS_TIME
+#define LONG_PRESS_MS 1000.0
+// 時計の表示が実際の時刻からこれ以上遅れていれば「古い」とみなす
+#define STALE_CLOCK_MS 2000.0
+
+struct TraceEvent
+{
+  double t; // シナリオ開始からの経過時間 (ms)
+  std::string kind;
+  std::vector<std::string> args;
+  std::string rest; // 種類より後ろの文字列 (フレームの内容など)
+};
+
+struct Post
+{
+  double start;
+  int status;
+  int boot; // 何回目の起動中か
+  bool manual;
+};
+
+// 件数・平均・最大を集計する
+struct Summary
+{
+  unsigned count = 0;
+  double total = 0;
+  double min = 0;
+  double max = 0;
+
+  void add(double value)
+  {
+    min = count == 0 ? value : std::min(min, value);
+    max = count == 0 ? value : std::max(max, value);
+    total += value;
+    count++;
+  }
+  void print(FILE *out, const char *label, const char *unit) const
+  {
+    if (count == 0)
+      fprintf(out, "  %-28s -\n", label);
+    else
+      fprintf(out, "  %-28s n=%u  mean %.1f %s  min %.1f %s  max %.1f %s\n", label, count, total / count, unit,
+              min, unit, max, unit);
+  }
+};
+
+static bool loadTrace(const std::string &path, std::vector<TraceEvent> &events)
+{
+  std::ifstream in(path);
+  if (!in)
+    return false;
+  std::string line;
+  while (std::getline(in, line))
+  {
+    std::istringstream fields(line);
+    TraceEvent event;
+    if (!(fields >> event.t >> event.kind))
+      continue;
+    std::getline(fields, event.rest);
+    if (!event.rest.empty() && event.rest[0] == ' ')
+      event.rest.erase(0, 1);
+    std::istringstream args(event.rest);
+    std::string arg;
+    while (args >> arg)
+      event.args.push_back(arg);
+    events.push_back(event);
+  }
+  return true;
+}
+
+/**
+ * @brief フレームの内容の先頭が "HH:MM:SS" なら、その時刻 (0時からの秒数) を返す
+ */
+static bool parseClock(const std::string &text, int &seconds)
+{
+  int h, m, s;
+  if (text.size() < 8 || sscanf(text.c_str(), "%2d:%2d:%2d", &h, &m, &s) != 3 || text[2] != ':' || text[5] != ':')
+    return false;
+  seconds = h * 3600 + m * 60 + s;
+  return true;
+}
+
+/**
+ * @brief ボタン操作の後、最初に起きた指定の種類のイベントまでの時間 (ms) を求める
+ * @return 見つからなければ負の値
+ */
+static double firstAfter(const std::vector<TraceEvent> &events, double from, const char *kind, const char *arg)
+{
+  for (const TraceEvent &event : events)
+  {
+    if (event.t < from || event.kind != kind)
+      continue;
+    if (event.t > from + ACTION_TIMEOUT_MS)
+      break;
+    if (!arg || (!event.args.empty() && event.args[0] == arg))
+      return event.t - from;
+  }
+  return -1;
+}
+
+bool simWriteReport(const std::string &tracePath, FILE *out, double wallSeconds)
+{
+  std::vector<TraceEvent> events;
+  if (!loadTrace(tracePath, events) || events.empty())
+    return false;
+
+  double startEpoch = 0;
+  long gmtOffset = 0;
+  double endTime = events.back().t;
+  unsigned restarts = 0;
+  int boot = 0;
+  std::vector<Post> posts;
+
+  for (const TraceEvent &event : events)
+  {
+    if (event.kind == "start" && !event.args.empty())
+      startEpoch = atof(event.args[0].c_str());
+    else if (event.kind == "restart")
+      restarts++;
+    else if (event.kind == "boot")
+      boot++;
+    else if (event.kind == "post" && event.args.size() >= 3)
+      posts.push_back({event.t - atof(event.args[2].c_str()), atoi(event.args[1].c_str()), boot, false});
+  }
+  std::stable_sort(posts.begin(), posts.end(), [](const Post &a, const Post &b)
+                   { return a.start < b.start; });
+
+  // --- ボタン操作から動作までの遅延 ---
+  Summary flashLatency, shortLatency, longLatency;
+  std::vector<std::string> missed;
+  for (const TraceEvent &event : events)
+  {
+    if (event.kind != "press" || event.args.size() < 2)
+      continue;
+    double held = atof(event.args[1].c_str());
+    double latency = -1;
+    const char *expected;
+    if (event.args[0] == "flash")
+    {
+      expected = "POST";
+      for (Post &post : posts)
+      {
+        if (post.start >= event.t && post.start <= event.t + ACTION_TIMEOUT_MS && !post.manual)
+        {
+          post.manual = true;
+          latency = post.start - event.t;
+          break;
+        }
+      }
+      if (latency >= 0)
+        flashLatency.add(latency);
+    }
+    else if (held <= LONG_PRESS_MS)
+    {
+      // 短押しは離した時点で処理される (画面がONならWoL, OFFなら画面をON)
+      expected = "WoL / display on";
+      double release = event.t + held;
+      double wol = firstAfter(events, release, "wol", nullptr);
+      double on = firstAfter(events, release, "oled", "on");
+      latency = wol < 0 ? on : (on < 0 ? wol : std::min(wol, on));
+      if (latency >= 0)
+        shortLatency.add(latency);
+    }
+    else
+    {
+      expected = "display off";
+      latency = firstAfter(events, event.t + LONG_PRESS_MS, "oled", "off");
+      if (latency >= 0)
+        longLatency.add(latency);
+    }
+
+    if (latency < 0)
+    {
+      char line[96];
+      snprintf(line, sizeof(line), "%.3f s: %s %s ms -> no %s", event.t / 1000, event.args[0].c_str(),
+               event.args[1].c_str(), expected);
+      missed.push_back(line);
+    }
+  }
+
+  // --- リモートコマンドから動作までの遅延 ---
+  Summary wakeLatency, displayLatency, commandPostLatency, weatherLatency;
+  unsigned commandsSent = 0, repliesOk = 0, repliesError = 0;
+  for (const TraceEvent &event : events)
+  {
+    if (event.kind == "reply" && !event.args.empty())
+      (event.args[0] == "ok" ? repliesOk : repliesError)++;
+    if (event.kind != "command" || event.args.empty())
+      continue;
+    commandsSent++;
+    // 拒否されるはずのコマンド (異なる鍵・再送・未対応) は、応答の件数だけを数える
+    const std::string &name = event.args[0];
+    if (name != "wake" && name != "display" && name != "post" && name != "weather")
+      continue;
+
+    double latency = -1;
+    const char *expected = name.c_str();
+    if (name == "wake")
+    {
+      expected = "WoL";
+      latency = firstAfter(events, event.t, "wol", nullptr);
+      if (latency >= 0)
+        wakeLatency.add(latency);
+    }
+    else if (name == "display" && event.args.size() >= 2)
+    {
+      expected = event.args[1] == "on" ? "display on" : "display off";
+      latency = firstAfter(events, event.t, "oled", event.args[1].c_str());
+      if (latency >= 0)
+        displayLatency.add(latency);
+    }
+    else if (name == "post")
+    {
+      expected = "POST";
+      for (Post &post : posts)
+      {
+        if (post.start >= event.t && post.start <= event.t + ACTION_TIMEOUT_MS && !post.manual)
+        {
+          post.manual = true;
+          latency = post.start - event.t;
+          break;
+        }
+      }
+      if (latency >= 0)
+        commandPostLatency.add(latency);
+    }
+    else if (name == "weather")
+    {
+      // getは完了時に記録されるため、開始時刻 (完了時刻 - 所要時間) で比べる
+      expected = "weather request";
+      for (const TraceEvent &get : events)
+      {
+        if (get.kind != "get" || get.args.size() < 3)
+          continue;
+        double start = get.t - atof(get.args[2].c_str());
+        if (start >= event.t && start <= event.t + ACTION_TIMEOUT_MS)
+        {
+          latency = start - event.t;
+          break;
+        }
+      }
+      if (latency >= 0)
+        weatherLatency.add(latency);
+    }
+
+    if (latency < 0)
+    {
+      char line[96];
+      snprintf(line, sizeof(line), "%.3f s: command %s -> no %s", event.t / 1000, event.rest.c_str(), expected);
+      missed.push_back(line);
+    }
+  }
+
+  // --- OTA更新 (書き込み開始から予約・破棄まで) と、その間の画面の更新間隔 ---
+  Summary otaDuration, otaFrameGap;
+  unsigned otaStaged = 0, otaDiscarded = 0;
+  double otaBegin = -1, lastFrame = -1;
+  for (const TraceEvent &event : events)
+  {
+    if (event.kind == "ota" && !event.args.empty())
+    {
+      if (event.args[0] == "begin")
+        otaBegin = event.t;
+      else if (otaBegin >= 0)
+      {
+        (event.args[0] == "staged" ? otaStaged : otaDiscarded)++;
+        otaDuration.add(event.t - otaBegin);
+        otaBegin = -1;
+      }
+    }
+    else if (event.kind == "frame")
+    {
+      if (otaBegin >= 0 && lastFrame >= 0)
+        otaFrameGap.add(event.t - lastFrame);
+      lastFrame = event.t;
+    }
+    else if (event.kind == "boot")
+      otaBegin = lastFrame = -1;
+  }
+
+  // --- WiFiの接続時間 (最初のWiFi.begin()から接続完了まで) ---
+  // 直接接続に失敗してスキャンに切り替えた場合は、スキャンとして最初のbeginから数える
+  Summary fastConnect, scanConnect;
+  double beginAt = -1;
+  bool beginFast = false;
+  for (const TraceEvent &event : events)
+  {
+    if (event.kind == "wifi" && event.args.size() >= 2 && event.args[0] == "begin")
+    {
+      bool fast = event.args[1] == "fast";
+      // 直前のbeginが直接接続なら、スキャンへの切り替え (同じ接続処理の続き)
+      if (beginAt < 0 || fast || !beginFast)
+        beginAt = event.t;
+      beginFast = fast;
+    }
+    else if (event.kind == "wifi" && !event.args.empty() && event.args[0] == "up" && beginAt >= 0)
+    {
+      (beginFast ? fastConnect : scanConnect).add(event.t - beginAt);
+      beginAt = -1;
+    }
+    else if (event.kind == "boot")
+      beginAt = -1;
+  }
+
+  // --- 定期POSTの間隔のずれ ---
+  Summary drift;
+  unsigned failures = 0;
+  for (size_t i = 0; i < posts.size(); i++)
+  {
+    if (posts[i].status < 0 || posts[i].status >= 400)
+      failures++;
+    // 再起動をまたぐ間隔は、起動直後のPOSTタイマーのリセットを含むため除外する
+    if (i == 0 || posts[i].manual || posts[i].boot != posts[i - 1].boot)
+      continue;
+    drift.add((posts[i].start - posts[i - 1].start - POST_INTERVAL_MS) / 1000);
+  }
+
+  // --- 表示の鮮度 (画面がONの間) ---
+  double onTime = 0, staleTime = 0, nonClockTime = 0, tornTime = 0, maxLag = 0;
+  bool panelOn = false;
+  bool torn = false;
+  std::string shown;
+  double previous = 0;
+  for (const TraceEvent &event : events)
+  {
+    double a = previous, b = event.t;
+    previous = event.t;
+    if (panelOn && b > a)
+    {
+      onTime += b - a;
+      int clock;
+      if (torn)
+        tornTime += b - a;
+      else if (!parseClock(shown, clock))
+        nonClockTime += b - a;
+      else
+      {
+        // 表示中の時刻と実際の時刻 (現地時刻) の差。日付をまたぐ場合を考慮する
+        double now = fmod(startEpoch + gmtOffset + a / 1000, 86400);
+        double lag = fmod(now - clock + 86400 + 43200, 86400) - 43200;
+        double lagStart = lag * 1000;
+        double lagEnd = lagStart + (b - a);
+        maxLag = std::max(maxLag, lagEnd);
+        if (lagEnd > STALE_CLOCK_MS)
+          staleTime += std::min(b - a, lagEnd - STALE_CLOCK_MS);
+      }
+    }
+
+    if (event.kind == "oled" && !event.args.empty())
+      panelOn = event.args[0] == "on";
+    else if (event.kind == "frame")
+    {
+      torn = false;
+      size_t space = event.rest.find(' ');
+      shown = space == std::string::npos ? std::string() : event.rest.substr(space + 1);
+    }
+    else if (event.kind == "torn")
+      torn = true;
+    else if (event.kind == "ntp" && event.args.size() >= 2 && event.args[0] == "config")
+      gmtOffset = atol(event.args[1].c_str());
+  }
+
+  // --- 出力 ---
+  fprintf(out, "=== Simulation report ===\n");
+  fprintf(out, "  simulated %.1f h in %.1f s (x%.0f), restarts: %u\n", endTime / 3600000, wallSeconds,
+          wallSeconds > 0 ? endTime / 1000 / wallSeconds : 0, restarts);
+
+  fprintf(out, "POST (%zu total, %u failed)\n", posts.size(), failures);
+  drift.print(out, "interval - 600 s", "s");
+
+  fprintf(out, "WiFi connect (begin -> up)\n");
+  fastConnect.print(out, "cached BSSID/channel", "ms");
+  scanConnect.print(out, "scan", "ms");
+
+  fprintf(out, "Button -> action latency\n");
+  flashLatency.print(out, "flash -> POST", "ms");
+  shortLatency.print(out, "switch short -> WoL/on", "ms");
+  longLatency.print(out, "switch long -> off", "ms");
+  fprintf(out, "Remote command -> action latency (%u sent, replies: %u ok, %u error)\n", commandsSent, repliesOk,
+          repliesError);
+  wakeLatency.print(out, "wake -> WoL", "ms");
+  displayLatency.print(out, "display on/off -> on/off", "ms");
+  commandPostLatency.print(out, "post -> POST", "ms");
+  weatherLatency.print(out, "weather -> request", "ms");
+  fprintf(out, "  missed (buttons and commands): %zu\n", missed.size());
+  for (const std::string &line : missed)
+    fprintf(out, "    %s\n", line.c_str());
+
+  fprintf(out, "OTA update (%u staged, %u discarded)\n", otaStaged, otaDiscarded);
+  otaDuration.print(out, "begin -> staged/discarded", "ms");
+  otaFrameGap.print(out, "frame interval meanwhile", "ms");
+
+  fprintf(out, "Display (on for %.1f s)\n", onTime / 1000);
+  fprintf(out, "  clock > %.0f s behind:        %.1f s (max lag %.1f s)\n", STALE_CLOCK_MS / 1000, staleTime / 1000,
+          maxLag / 1000);
+  fprintf(out, "  no clock shown:              %.1f s\n", nonClockTime / 1000);
+  fprintf(out, "  torn (mid-transfer):         %.3f s\n", tornTime / 1000);
+  return true;
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <stdio.h>
+#include <string>
+
+/**
+ * @brief トレースからPOSTの間隔のずれ・ボタン操作から動作までの遅延・表示が古い時間などを集計して出力する
+ * @param tracePath trace.txtのパス
+ * @param out 出力先
+ * @param wallSeconds シミュレーションにかかった実時間 (秒)
+ * @return bool トレースを読み込めた場合はtrue
+ */
+bool simWriteReport(const std::string &tracePath, FILE *out, double wallSeconds);
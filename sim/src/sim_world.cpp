@@ -0,0 +1,1276 @@
+// シミュレーターの仮想世界: 仮想時計・シナリオ・WiFi/DNS/HTTPのモデル・SSD1306パネルのモデル・トレース
+#include "sim_world.h"
+#include <user_interface.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <fstream>
+#include <sstream>
+#include <vector>
+// リモートコマンドの署名に使う鍵 (COMMAND_KEY)。ファームウェアと同じ設定を読み込む
+#if __has_include("../../src/secrets.h")
+#include "../../src/secrets.h"
+#else
+#include "secrets.h"
+#endif
+
+#define RTC_MEMORY_SIZE 512
+#define EEPROM_MEMORY_SIZE 4096
+
+#define SWITCH_PIN 5
+#define FLASH_BUTTON_PIN 0
+
+#define OLED_ADDRESS 0x3C
+#define OLED_WIDTH 128
+#define OLED_PAGES 8
+// 画面の内容と照合するために保持する、描画済みフレームの数
+#define FRAME_HISTORY 64
+// I2Cの1トランザクションあたりの固定コスト (スタート・ストップ条件とドライバの処理, µs)
+#define I2C_TRANSACTION_MICROS 20
+
+#define RESUME_MAGIC 0x53494D31 // "SIM1"
+
+// リモートコマンドを送るLAN内のスマートフォン (remote_command.cppのCOMMAND_PORT宛てに送る)
+#define COMMAND_PORT 4210
+static const uint8_t PHONE_IP[4] = {192, 168, 223, 77};
+#define PHONE_PORT 50000
+
+// --- ネットワークのモデルのパラメータ (シナリオの "net <名前> <時間>" で変更できる) ---
+struct NetParams
+{
+  uint64_t wifiScan = 1900000;      // 全チャンネルのスキャン (BSSID/チャンネルを指定しない場合)
+  uint64_t wifiAssoc = 400000;      // 認証・アソシエーション・4-wayハンドシェイク
+  uint64_t wifiPassphrase = 700000; // パスフレーズからのPSKの導出 (16進数64文字のPSKを渡した場合は不要)
+  uint64_t ntp = 500000;          // 接続からNTPの同期完了まで
+  uint64_t dns = 20000;           // DNSの応答時間
+  uint64_t dnsTimeout = 10000000; // DNSが応答しない場合のタイムアウト (ESP8266コアの既定値)
+  uint64_t connect = 40000;       // TCP接続
+  uint64_t tls = 1200000;         // TLSのハンドシェイク
+  uint64_t keepAlive = 15000000;  // サーバーがアイドルな接続を閉じるまでの時間
+  uint64_t kilobyte = 0;          // 応答ボディ1KBの受信にかかる時間 (0: 応答時間の経過後に一度に届く)
+};
+
+// シナリオの "http" で登録するHTTPサーバーの応答
+struct HttpRule
+{
+  std::string method;
+  std::string host; // "*" はすべてのホスト
+  int status;
+  uint64_t latency;
+  std::string body;
+  std::string contentEncoding;
+  std::string identityBody; // gzipを受け入れない要求への応答 (.gzなしの同名のファイル, なければbodyを送る)
+};
+
+struct Event
+{
+  uint64_t at;
+  std::string command;
+  int line;
+};
+
+struct FrameSnapshot
+{
+  uint64_t hash;
+  std::string text;
+};
+
+// 再起動後も保持する状態 (再起動時にファイルへ書き出し、新しいプロセスで読み込む)
+struct PersistentState
+{
+  uint32_t magic;
+  uint64_t nowMicros;
+  uint32_t restartCount;
+  double wallSeconds;
+  uint8_t rtc[RTC_MEMORY_SIZE];
+  uint8_t eeprom[EEPROM_MEMORY_SIZE];
+  uint8_t gddram[OLED_WIDTH * OLED_PAGES];
+  bool panelOn;
+  uint64_t shownHash;
+};
+
+static PersistentState state;
+static uint64_t bootMicros = 0;
+static uint64_t startEpoch = 1767225600; // 2026-01-01T00:00:00Z
+static uint64_t endMicros = 24ULL * 3600 * 1000000;
+static uint8_t resetReason = REASON_DEFAULT_RST;
+static std::chrono::steady_clock::time_point wallStart;
+
+static std::vector<Event> events;
+static size_t nextEvent = 0;
+static uint32_t activityCount = 0;
+static bool advancing = false;
+
+static std::string outDir;
+static std::string resumePath;
+static char **commandLine = nullptr;
+static FILE *traceFile = nullptr;
+static FILE *serialFile = nullptr;
+static FILE *framesFile = nullptr;
+static FILE *apiFile = nullptr;
+
+// 環境 (シナリオで変化する)
+static NetParams net;
+static std::vector<HttpRule> httpRules;
+static bool accessPointUp = true;
+static uint8_t accessPointBssid[6] = {0x02, 0x00, 0x5E, 0x10, 0x00, 0x01};
+static int32_t accessPointChannel = 6;
+static bool dnsUp = true;
+static bool dhtOk = true;
+static float dhtTemp = 24.0f;
+static float dhtHum = 45.0f;
+static uint64_t pinLowFrom[2] = {UINT64_MAX, UINT64_MAX}; // [0]: スイッチ, [1]: Flashボタン
+static uint64_t pinLowUntil[2] = {0, 0};
+static std::deque<char> serialInput;
+static std::deque<std::pair<std::string, std::string>> apiRequests; // 端末のHTTPサーバー宛て (メソッド, パス)
+static std::deque<std::string> commandPackets; // 端末のCOMMAND_PORT宛てのUDPパケット
+static std::string lastCommandPacket;          // "command replay" で再送するパケット
+
+// WiFi・NTP
+static bool wifiStarted = false; // WiFi.begin()が呼ばれた (以降は自動再接続する)
+static bool wifiConnected = false;
+static uint32_t wifiGeneration = 0;
+static uint64_t wifiConnectAt = UINT64_MAX;
+static uint8_t wifiBssid[6];    // WiFi.begin()で指定されたBSSID
+static int32_t wifiChannel = 0; // WiFi.begin()で指定されたチャンネル (0: 指定なし = スキャンする)
+static bool ntpRequested = false;
+static bool ntpSynced = false;
+static uint64_t ntpSyncAt = UINT64_MAX;
+static long gmtOffset = 0;
+
+// SSD1306パネル
+static uint8_t panelCommand = 0; // 引数を待っているコマンド (0: なし)
+static uint8_t panelArgs[2];
+static uint8_t panelArgCount = 0;
+static uint8_t panelArgsNeeded = 0;
+static uint8_t columnStart = 0, columnEnd = OLED_WIDTH - 1, column = 0;
+static uint8_t pageStart = 0, pageEnd = OLED_PAGES - 1, page = 0;
+static FrameSnapshot frameHistory[FRAME_HISTORY];
+static size_t frameHistoryHead = 0;
+static bool panelTorn = false;
+
+// --- トレース ---
+
+void simTrace(const char *format, ...)
+{
+  if (!traceFile)
+    return;
+  fprintf(traceFile, "%llu.%03llu ", (unsigned long long)(state.nowMicros / 1000),
+          (unsigned long long)(state.nowMicros % 1000));
+  va_list args;
+  va_start(args, format);
+  vfprintf(traceFile, format, args);
+  va_end(args);
+  fputc('\n', traceFile);
+}
+
+std::string simOutputPath(const char *name)
+{
+  return outDir + "/" + name;
+}
+
+double simWallSeconds()
+{
+  return state.wallSeconds +
+         std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+}
+
+// --- シナリオ ---
+
+/**
+ * @brief "2h30m", "1500ms", "90s", "1d" などの時間をµsに変換する
+ */
+static bool parseDuration(const std::string &text, uint64_t &micros)
+{
+  micros = 0;
+  size_t i = 0;
+  bool any = false;
+  while (i < text.size())
+  {
+    char *end;
+    double value = strtod(text.c_str() + i, &end);
+    size_t numberEnd = end - text.c_str();
+    if (numberEnd == i)
+      return false;
+    std::string unit;
+    i = numberEnd;
+    while (i < text.size() && isalpha((unsigned char)text[i]))
+      unit += text[i++];
+
+    double scale;
+    if (unit == "us")
+      scale = 1;
+    else if (unit == "ms")
+      scale = 1e3;
+    else if (unit == "s" || unit.empty())
+      scale = 1e6;
+    else if (unit == "m")
+      scale = 60e6;
+    else if (unit == "h")
+      scale = 3600e6;
+    else if (unit == "d")
+      scale = 86400e6;
+    else
+      return false;
+    micros += (uint64_t)(value * scale);
+    any = true;
+  }
+  return any;
+}
+
+/**
+ * @brief "2026-06-01T08:00:00+09:00" (Zまたはオフセットは省略可, 省略時はUTC) をUNIX時刻に変換する
+ */
+static bool parseTimestamp(const std::string &text, uint64_t &epoch)
+{
+  struct tm tm = {};
+  int consumed = 0;
+  if (sscanf(text.c_str(), "%d-%d-%dT%d:%d:%d%n", &tm.tm_year, &tm.tm_mon, &tm.tm_mday,
+             &tm.tm_hour, &tm.tm_min, &tm.tm_sec, &consumed) != 6)
+    return false;
+  tm.tm_year -= 1900;
+  tm.tm_mon -= 1;
+  int64_t seconds = timegm(&tm);
+
+  const char *zone = text.c_str() + consumed;
+  int zh, zm;
+  if ((zone[0] == '+' || zone[0] == '-') && sscanf(zone + 1, "%d:%d", &zh, &zm) == 2)
+    seconds -= (zone[0] == '+' ? 1 : -1) * (zh * 3600 + zm * 60);
+  epoch = seconds;
+  return true;
+}
+
+static std::string directoryOf(const std::string &path)
+{
+  size_t slash = path.rfind('/');
+  return slash == std::string::npos ? "." : path.substr(0, slash);
+}
+
+static bool readFile(const std::string &path, std::string &content)
+{
+  std::ifstream in(path, std::ios::binary);
+  if (!in)
+    return false;
+  std::stringstream buffer;
+  buffer << in.rdbuf();
+  content = buffer.str();
+  return true;
+}
+
+static std::string scenarioDir;
+
+static bool scenarioError(int line, const std::string &message)
+{
+  fprintf(stderr, "scenario:%d: %s\n", line, message.c_str());
+  return false;
+}
+
+/**
+ * @brief イベント1件を検証する (適用はapplyEvent)。http行はここで応答の本文を読み込む
+ */
+static bool checkEvent(const std::string &command, int line)
+{
+  std::istringstream in(command);
+  std::string kind, a, b;
+  in >> kind;
+  if (kind == "dht")
+  {
+    in >> a;
+    if (a != "fail" && !(in >> b))
+      return scenarioError(line, "usage: dht <temp> <hum> | dht fail");
+  }
+  else if (kind == "press")
+  {
+    uint64_t duration;
+    if (!(in >> a >> b) || (a != "switch" && a != "flash") || !parseDuration(b, duration))
+      return scenarioError(line, "usage: press switch|flash <duration>");
+  }
+  else if (kind == "release")
+  {
+  }
+  else if (kind == "wifi" || kind == "dns")
+  {
+    in >> a;
+    if (a != "up" && a != "down" && a != "ok" && a != "fail" && !(kind == "wifi" && a == "roam"))
+      return scenarioError(line, "usage: wifi up|down|roam, dns ok|fail");
+  }
+  else if (kind == "serial")
+  {
+    if (command.size() <= 7)
+      return scenarioError(line, "usage: serial <characters>");
+  }
+  else if (kind == "api")
+  {
+    if (!(in >> a >> b) || (a != "GET" && a != "POST") || b.empty() || b[0] != '/')
+      return scenarioError(line, "usage: api GET|POST <path>");
+  }
+  else if (kind == "command")
+  {
+    if (!(in >> a) || (a == "forged" && !(in >> b)))
+      return scenarioError(line, "usage: command <command> [arg] | command forged <command> [arg] | command replay");
+#ifndef COMMAND_KEY
+    return scenarioError(line, "COMMAND_KEY is not defined in secrets.h");
+#endif
+  }
+  else if (kind == "net")
+  {
+    uint64_t value;
+    if (!(in >> a >> b) || !parseDuration(b, value))
+      return scenarioError(line, "usage: net <parameter> <duration>");
+    if (a != "wifi_scan" && a != "wifi_assoc" && a != "wifi_passphrase" && a != "ntp" && a != "dns" &&
+        a != "dns_timeout" && a != "connect" && a != "tls" && a != "keepalive" &&
+        a != "kilobyte")
+      return scenarioError(line, "unknown net parameter: " + a);
+  }
+  else if (kind == "http")
+  {
+    std::string method, host, status, latency;
+    uint64_t value;
+    if (!(in >> method >> host >> status >> latency) || (method != "GET" && method != "POST") ||
+        !parseDuration(latency, value))
+      return scenarioError(line, "usage: http GET|POST <host|*> <status> <latency> [body file]");
+  }
+  else
+  {
+    return scenarioError(line, "unknown command: " + kind);
+  }
+  return true;
+}
+
+static bool loadScenario(const char *path)
+{
+  std::ifstream in(path);
+  if (!in)
+  {
+    fprintf(stderr, "cannot open scenario: %s\n", path);
+    return false;
+  }
+  scenarioDir = directoryOf(path);
+
+  std::string text;
+  int lineNumber = 0;
+  while (std::getline(in, text))
+  {
+    lineNumber++;
+    size_t hash = text.find('#');
+    if (hash != std::string::npos)
+      text.erase(hash);
+    std::istringstream line(text);
+    std::string keyword, value;
+    if (!(line >> keyword))
+      continue;
+
+    if (keyword == "start")
+    {
+      if (!(line >> value) || !parseTimestamp(value, startEpoch))
+        return scenarioError(lineNumber, "usage: start YYYY-MM-DDTHH:MM:SS[+HH:MM]");
+    }
+    else if (keyword == "end")
+    {
+      if (!(line >> value) || !parseDuration(value, endMicros))
+        return scenarioError(lineNumber, "usage: end <duration>");
+    }
+    else if (keyword == "at")
+    {
+      uint64_t at;
+      if (!(line >> value) || !parseDuration(value, at))
+        return scenarioError(lineNumber, "usage: at <duration> <command>");
+      std::string command;
+      std::getline(line, command);
+      command.erase(0, command.find_first_not_of(" \t"));
+      command.erase(command.find_last_not_of(" \t\r") + 1);
+      if (!checkEvent(command, lineNumber))
+        return false;
+      events.push_back({at, command, lineNumber});
+
+      // 押したボタンを離すイベントを追加する
+      if (command.compare(0, 6, "press ") == 0)
+      {
+        std::istringstream press(command.substr(6));
+        std::string button, duration;
+        uint64_t held;
+        press >> button >> duration;
+        parseDuration(duration, held);
+        events.push_back({at + held, "release " + button, lineNumber});
+      }
+    }
+    else
+    {
+      return scenarioError(lineNumber, "unknown keyword: " + keyword);
+    }
+  }
+
+  std::stable_sort(events.begin(), events.end(), [](const Event &a, const Event &b)
+                   { return a.at < b.at; });
+  return true;
+}
+
+static void wifiDrop();
+static void scheduleWifiConnect(bool passphrase);
+
+/**
+ * @brief スマートフォンからのリモートコマンドを、現在の時刻と通し番号を付けて署名し、送信する
+ * @param text "<コマンド> [引数]"、"forged <コマンド> [引数]" (異なる鍵で署名) または "replay" (前回のパケットを再送)
+ */
+static void sendCommand(const std::string &text)
+{
+#ifdef COMMAND_KEY
+  if (text == "replay")
+  {
+    if (lastCommandPacket.empty())
+      return;
+    commandPackets.push_back(lastCommandPacket);
+    simTrace("command replay");
+    return;
+  }
+
+  bool forged = text.compare(0, 7, "forged ") == 0;
+  std::string command = forged ? text.substr(7) : text;
+  // 通し番号はシナリオ開始からの経過ms (再起動をまたいでも増え続ける)。時刻はスマートフォンの時計 (常に正確)
+  char head[96];
+  snprintf(head, sizeof(head), "%llu %llu %s", (unsigned long long)(state.nowMicros / 1000 + 1),
+           (unsigned long long)(startEpoch + state.nowMicros / 1000000), command.c_str());
+  const char *key = forged ? "forged-key" : COMMAND_KEY;
+  uint8_t mac[32];
+  simHmacSha256(key, strlen(key), head, strlen(head), mac);
+  std::string packet = head;
+  packet += ' ';
+  for (uint8_t b : mac)
+  {
+    char hex[3];
+    snprintf(hex, sizeof(hex), "%02x", b);
+    packet += hex;
+  }
+  commandPackets.push_back(packet);
+  lastCommandPacket = packet;
+  simTrace("command %s%s", forged ? "forged " : "", command.c_str());
+#else
+  (void)text;
+#endif
+}
+
+/**
+ * @brief イベントを適用する。replayがtrueの場合は再起動後に環境の状態だけを復元する (入力・トレースなし)
+ */
+static void applyEvent(const Event &event, bool replay)
+{
+  std::istringstream in(event.command);
+  std::string kind, a, b;
+  in >> kind;
+
+  if (kind == "dht")
+  {
+    in >> a;
+    dhtOk = a != "fail";
+    if (dhtOk)
+    {
+      in >> b;
+      dhtTemp = strtof(a.c_str(), nullptr);
+      dhtHum = strtof(b.c_str(), nullptr);
+    }
+  }
+  else if (kind == "press" || kind == "release")
+  {
+    in >> a >> b;
+    int index = a == "switch" ? 0 : 1;
+    if (kind == "press")
+    {
+      uint64_t held;
+      parseDuration(b, held);
+      pinLowFrom[index] = event.at;
+      pinLowUntil[index] = event.at + held;
+      if (!replay)
+        simTrace("press %s %llu", a.c_str(), (unsigned long long)(held / 1000));
+    }
+  }
+  else if (kind == "wifi")
+  {
+    in >> a;
+    if (a == "roam")
+    {
+      // アクセスポイントの交換 (BSSIDとチャンネルが変わる)。接続中の端末は切断される
+      accessPointBssid[5]++;
+      accessPointChannel = accessPointChannel == 6 ? 11 : 6;
+      if (replay)
+        return;
+      simTrace("ap roam %d", (int)accessPointChannel);
+      wifiDrop();
+      scheduleWifiConnect(false);
+      return;
+    }
+    accessPointUp = a == "up";
+    if (replay)
+      return;
+    simTrace("ap %s", a.c_str());
+    if (!accessPointUp)
+      wifiDrop();
+    else
+      scheduleWifiConnect(false); // 自動再接続
+  }
+  else if (kind == "dns")
+  {
+    in >> a;
+    dnsUp = a == "ok";
+  }
+  else if (kind == "serial")
+  {
+    if (!replay)
+    {
+      std::string chars = event.command.substr(7);
+      serialInput.insert(serialInput.end(), chars.begin(), chars.end());
+      simTrace("serial %s", chars.c_str());
+    }
+  }
+  else if (kind == "api")
+  {
+    in >> a >> b;
+    if (!replay)
+      apiRequests.push_back({a, b});
+  }
+  else if (kind == "command")
+  {
+    if (!replay)
+      sendCommand(event.command.substr(8));
+  }
+  else if (kind == "net")
+  {
+    uint64_t value;
+    in >> a >> b;
+    parseDuration(b, value);
+    if (a == "wifi_scan")
+      net.wifiScan = value;
+    else if (a == "wifi_assoc")
+      net.wifiAssoc = value;
+    else if (a == "wifi_passphrase")
+      net.wifiPassphrase = value;
+    else if (a == "ntp")
+      net.ntp = value;
+    else if (a == "dns")
+      net.dns = value;
+    else if (a == "dns_timeout")
+      net.dnsTimeout = value;
+    else if (a == "connect")
+      net.connect = value;
+    else if (a == "tls")
+      net.tls = value;
+    else if (a == "keepalive")
+      net.keepAlive = value;
+    else if (a == "kilobyte")
+      net.kilobyte = value;
+  }
+  else if (kind == "http")
+  {
+    HttpRule rule;
+    std::string status, latency, file;
+    in >> rule.method >> rule.host >> status >> latency >> file;
+    rule.status = atoi(status.c_str());
+    parseDuration(latency, rule.latency);
+    if (!file.empty())
+    {
+      if (!readFile(scenarioDir + "/" + file, rule.body))
+        fprintf(stderr, "scenario:%d: cannot read %s\n", event.line, file.c_str());
+      if (file.size() > 3 && file.compare(file.size() - 3, 3, ".gz") == 0)
+      {
+        rule.contentEncoding = "gzip";
+        readFile(scenarioDir + "/" + file.substr(0, file.size() - 3), rule.identityBody);
+      }
+    }
+    httpRules.push_back(rule);
+  }
+}
+
+// --- 仮想時計 ---
+
+uint64_t simNowMicros()
+{
+  return state.nowMicros;
+}
+
+uint64_t simUptimeMicros()
+{
+  return state.nowMicros - bootMicros;
+}
+
+void simActivity()
+{
+  activityCount++;
+}
+
+uint32_t simActivityCount()
+{
+  return activityCount;
+}
+
+// WiFiの接続完了とNTPの同期も、シナリオのイベントと同じく予定された時刻に処理する
+static uint64_t nextTimer()
+{
+  uint64_t next = std::min(wifiConnectAt, ntpSyncAt);
+  if (nextEvent < events.size())
+    next = std::min(next, events[nextEvent].at);
+  return next;
+}
+
+uint64_t simNextEventMicros()
+{
+  return nextTimer();
+}
+
+static void fireTimers(uint64_t t)
+{
+  if (wifiConnectAt <= t)
+  {
+    wifiConnectAt = UINT64_MAX;
+    if (accessPointUp)
+    {
+      wifiConnected = true;
+      simTrace("wifi up");
+      if (ntpRequested && !ntpSynced && ntpSyncAt == UINT64_MAX)
+        ntpSyncAt = state.nowMicros + net.ntp;
+    }
+  }
+  if (ntpSyncAt <= t)
+  {
+    ntpSyncAt = UINT64_MAX;
+    ntpSynced = true;
+    simTrace("ntp synced");
+  }
+  while (nextEvent < events.size() && events[nextEvent].at <= t)
+  {
+    applyEvent(events[nextEvent++], false);
+    activityCount++;
+  }
+}
+
+void simAdvanceTo(uint64_t t)
+{
+  if (advancing)
+  {
+    // イベントの適用中に時間が進むことはない
+    state.nowMicros = std::max(state.nowMicros, t);
+    return;
+  }
+  advancing = true;
+  uint64_t next;
+  while ((next = nextTimer()) <= t && next < endMicros)
+  {
+    state.nowMicros = std::max(state.nowMicros, next);
+    fireTimers(state.nowMicros);
+  }
+  advancing = false;
+
+  if (t >= endMicros)
+  {
+    state.nowMicros = endMicros;
+    simFinish();
+  }
+  state.nowMicros = std::max(state.nowMicros, t);
+}
+
+void simAdvance(uint64_t micros)
+{
+  simAdvanceTo(state.nowMicros + micros);
+}
+
+// --- 時刻 ---
+
+void simConfigTime(long gmtOffsetSec, int daylightOffsetSec)
+{
+  gmtOffset = gmtOffsetSec + daylightOffsetSec;
+  ntpRequested = true;
+  simTrace("ntp config %ld", gmtOffset);
+  if (wifiConnected && !ntpSynced && ntpSyncAt == UINT64_MAX)
+    ntpSyncAt = state.nowMicros + net.ntp;
+}
+
+int64_t simEpochSeconds()
+{
+  if (!ntpSynced)
+    return simUptimeMicros() / 1000000;
+  return startEpoch + state.nowMicros / 1000000;
+}
+
+long simGmtOffset()
+{
+  return gmtOffset;
+}
+
+// --- GPIO・シリアル・センサー ---
+
+int simDigitalRead(uint8_t pin)
+{
+  int index;
+  if (pin == SWITCH_PIN)
+    index = 0;
+  else if (pin == FLASH_BUTTON_PIN)
+    index = 1;
+  else
+    return 1;
+  return state.nowMicros >= pinLowFrom[index] && state.nowMicros < pinLowUntil[index] ? 0 : 1;
+}
+
+int simSerialRead()
+{
+  if (serialInput.empty())
+    return -1;
+  activityCount++;
+  char c = serialInput.front();
+  serialInput.pop_front();
+  return (uint8_t)c;
+}
+
+int simSerialAvailable()
+{
+  return (int)serialInput.size();
+}
+
+void simSerialOutput(const uint8_t *data, size_t len)
+{
+  if (serialFile)
+    fwrite(data, 1, len, serialFile);
+}
+
+bool simDhtRead(float &temp, float &hum)
+{
+  if (!dhtOk)
+    return false;
+  temp = dhtTemp;
+  hum = dhtHum;
+  return true;
+}
+
+// --- 不揮発メモリ・再起動 ---
+
+uint8_t *simRtcMemory()
+{
+  return state.rtc;
+}
+
+uint8_t *simEepromMemory()
+{
+  return state.eeprom;
+}
+
+uint8_t simResetReason()
+{
+  return resetReason;
+}
+
+void simRestart()
+{
+  simTrace("restart");
+  state.restartCount++;
+  state.wallSeconds = simWallSeconds();
+  fflush(nullptr);
+
+  FILE *resume = fopen(resumePath.c_str(), "wb");
+  if (!resume || fwrite(&state, sizeof(state), 1, resume) != 1)
+  {
+    fprintf(stderr, "cannot write %s\n", resumePath.c_str());
+    exit(1);
+  }
+  fclose(resume);
+
+  // ファームウェアの静的変数も含めて初期状態に戻すため、プロセスを起動し直す
+  std::vector<char *> args;
+  for (char **arg = commandLine; *arg; arg++)
+  {
+    if (strcmp(*arg, "--resume") == 0)
+    {
+      arg++;
+      continue;
+    }
+    args.push_back(*arg);
+  }
+  args.push_back((char *)"--resume");
+  args.push_back((char *)resumePath.c_str());
+  args.push_back(nullptr);
+  execv("/proc/self/exe", args.data());
+  perror("execv");
+  exit(1);
+}
+
+// --- WiFi・ネットワーク ---
+
+static void wifiDrop()
+{
+  if (wifiConnected)
+    simTrace("wifi down");
+  wifiConnected = false;
+  wifiGeneration++;
+  wifiConnectAt = UINT64_MAX;
+}
+
+bool simWifiConnected()
+{
+  return wifiConnected;
+}
+
+uint32_t simWifiGeneration()
+{
+  return wifiGeneration;
+}
+
+/**
+ * @brief WiFi.begin()で指定された接続先で、接続完了の時刻を予定する
+ *
+ * BSSID/チャンネルを指定した場合はスキャンを省略するが、アクセスポイントと一致しなければ接続できない。
+ * 自動再接続ではSDKが導出済みのPSKを使うため、パスフレーズの処理時間はかからない。
+ */
+static void scheduleWifiConnect(bool passphrase)
+{
+  if (!wifiStarted || wifiConnected || wifiConnectAt != UINT64_MAX || !accessPointUp)
+    return;
+  uint64_t duration = net.wifiAssoc + (passphrase ? net.wifiPassphrase : 0);
+  if (wifiChannel == 0)
+    duration += net.wifiScan;
+  else if (wifiChannel != accessPointChannel || memcmp(wifiBssid, accessPointBssid, sizeof(wifiBssid)) != 0)
+    return;
+  wifiConnectAt = state.nowMicros + duration;
+}
+
+void simWifiBegin(const uint8_t *bssid, int32_t channel, bool psk)
+{
+  activityCount++;
+  wifiStarted = true;
+  wifiChannel = bssid ? channel : 0;
+  if (bssid)
+    memcpy(wifiBssid, bssid, sizeof(wifiBssid));
+  simTrace("wifi begin %s", wifiChannel != 0 ? "fast" : "scan");
+  scheduleWifiConnect(!psk);
+}
+
+const uint8_t *simWifiBssid()
+{
+  return accessPointBssid;
+}
+
+int32_t simWifiChannel()
+{
+  return wifiConnected ? accessPointChannel : 0;
+}
+
+void simWifiDisconnect()
+{
+  activityCount++;
+  wifiStarted = false;
+  wifiDrop();
+}
+
+bool simDnsLookup(const char *host)
+{
+  activityCount++;
+  if (!wifiConnected)
+  {
+    simTrace("dns %s fail", host);
+    return false;
+  }
+  if (!dnsUp)
+  {
+    simAdvance(net.dnsTimeout);
+    simSdkService();
+    simTrace("dns %s fail", host);
+    return false;
+  }
+  simAdvance(net.dns);
+  simSdkService();
+  return true;
+}
+
+bool simConnectionAlive(const SimConnection &connection)
+{
+  return connection.open && wifiConnected && connection.generation == wifiGeneration &&
+         state.nowMicros - connection.lastUsed < net.keepAlive;
+}
+
+size_t simBodyArrived(uint64_t start, size_t size)
+{
+  if (net.kilobyte == 0)
+    return size;
+  uint64_t arrived = (state.nowMicros - start) * 1024 / net.kilobyte;
+  return arrived < size ? (size_t)arrived : size;
+}
+
+static std::string hostOf(const std::string &url)
+{
+  size_t begin = url.find("://");
+  begin = begin == std::string::npos ? 0 : begin + 3;
+  size_t end = url.find_first_of(":/?", begin);
+  return url.substr(begin, end == std::string::npos ? std::string::npos : end - begin);
+}
+
+static const HttpRule *findRule(const char *method, const std::string &host)
+{
+  for (auto rule = httpRules.rbegin(); rule != httpRules.rend(); ++rule)
+  {
+    if (rule->method == method && (rule->host == "*" || rule->host == host))
+      return &*rule;
+  }
+  return nullptr;
+}
+
+SimHttpResponse simHttpRequest(const char *method, const std::string &url, bool acceptGzip, SimConnection &connection)
+{
+  activityCount++;
+  std::string host = hostOf(url);
+  uint64_t start = state.nowMicros;
+  bool reused = simConnectionAlive(connection);
+  SimHttpResponse response = {0, std::string(), std::string()};
+
+  if (!reused)
+  {
+    connection.open = false;
+    if (!wifiConnected || !simDnsLookup(host.c_str()))
+      response.status = -1; // HTTPC_ERROR_CONNECTION_FAILED
+    else
+    {
+      simAdvance(connection.secure ? net.tls : net.connect);
+      simSdkService(); // 接続・ハンドシェイクの待ちの間もSDKは動いている
+      connection.open = true;
+      connection.generation = wifiGeneration;
+    }
+  }
+
+  if (response.status == 0)
+  {
+    static const HttpRule defaultPost = {"POST", "*", 200, 150000, "{\"result\":\"ok\"}", "", ""};
+    static const HttpRule defaultGet = {"GET", "*", 404, 150000, "", "", ""};
+    const HttpRule *rule = findRule(method, host);
+    if (!rule)
+      rule = strcmp(method, "POST") == 0 ? &defaultPost : &defaultGet;
+
+    simAdvance(rule->latency);
+    simSdkService();
+    if (!wifiConnected || connection.generation != wifiGeneration)
+      response.status = -5; // HTTPC_ERROR_CONNECTION_LOST
+    else
+    {
+      response.status = rule->status;
+      response.body = rule->body;
+      response.contentEncoding = rule->contentEncoding;
+      if (!acceptGzip && !rule->identityBody.empty())
+      {
+        response.body = rule->identityBody;
+        response.contentEncoding.clear();
+      }
+    }
+    if (response.status < 0)
+      connection.open = false;
+    connection.lastUsed = state.nowMicros;
+  }
+
+  uint64_t elapsed = state.nowMicros - start;
+  simTrace("%s %s %d %llu.%03llu %s", strcmp(method, "POST") == 0 ? "post" : "get", host.c_str(), response.status,
+           (unsigned long long)(elapsed / 1000), (unsigned long long)(elapsed % 1000), reused ? "reused" : "new");
+  return response;
+}
+
+bool simApiNextRequest(std::string &method, std::string &target)
+{
+  if (!wifiConnected || apiRequests.empty())
+    return false;
+  activityCount++;
+  method = apiRequests.front().first;
+  target = apiRequests.front().second;
+  apiRequests.pop_front();
+  simTrace("api %s %s", method.c_str(), target.c_str());
+  fprintf(apiFile, "%.3f %s %s\n", state.nowMicros / 1000.0, method.c_str(), target.c_str());
+  return true;
+}
+
+void simApiResponse(int status, const std::string &body)
+{
+  simTrace("api %d %zu", status, body.size());
+  fprintf(apiFile, "%.3f %d\n%s\n\n", state.nowMicros / 1000.0, status, body.c_str());
+}
+
+bool simUdpReceive(uint16_t port, std::string &data, uint8_t ip[4], uint16_t &remotePort)
+{
+  if (!wifiConnected || port != COMMAND_PORT || commandPackets.empty())
+    return false;
+  activityCount++;
+  data = commandPackets.front();
+  commandPackets.pop_front();
+  memcpy(ip, PHONE_IP, sizeof(PHONE_IP));
+  remotePort = PHONE_PORT;
+  return true;
+}
+
+bool simUdpSend(const uint8_t ip[4], uint16_t port, const uint8_t *data, size_t len)
+{
+  activityCount++;
+  if (!wifiConnected)
+    return false;
+
+  // リモートコマンドへの応答
+  if (memcmp(ip, PHONE_IP, sizeof(PHONE_IP)) == 0 && port == PHONE_PORT)
+  {
+    simTrace("reply %.*s", (int)len, (const char *)data);
+    return true;
+  }
+
+  // Wake-on-LANのマジックパケット (0xFF x 6 + MACアドレス x 16)
+  static const uint8_t header[6] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+  if (len == 102 && memcmp(data, header, sizeof(header)) == 0)
+    simTrace("wol %u.%u.%u.%u:%u", ip[0], ip[1], ip[2], ip[3], port);
+  else
+    simTrace("post udp:%u.%u.%u.%u:%u 0 0 -", ip[0], ip[1], ip[2], ip[3], port);
+  return true;
+}
+
+bool simMqttConnect()
+{
+  activityCount++;
+  if (!wifiConnected)
+    return false;
+  simAdvance(net.connect);
+  simSdkService();
+  return true;
+}
+
+bool simMqttPublish(const char *topic, size_t len)
+{
+  (void)len;
+  activityCount++;
+  simTrace("post mqtt:%s %d 0 -", topic, wifiConnected ? 0 : -1);
+  return wifiConnected;
+}
+
+// --- SSD1306パネル ---
+
+uint64_t simFrameHash(const uint8_t *buffer, size_t len)
+{
+  // FNV-1a
+  uint64_t hash = 1469598103934665603ULL;
+  for (size_t i = 0; i < len; i++)
+  {
+    hash ^= buffer[i];
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+void simRegisterFrame(uint64_t hash, const std::string &text)
+{
+  frameHistory[frameHistoryHead] = {hash, text};
+  frameHistoryHead = (frameHistoryHead + 1) % FRAME_HISTORY;
+}
+
+static const FrameSnapshot *findFrame(uint64_t hash)
+{
+  for (size_t i = 0; i < FRAME_HISTORY; i++)
+  {
+    const FrameSnapshot &frame = frameHistory[(frameHistoryHead + FRAME_HISTORY - 1 - i) % FRAME_HISTORY];
+    if (frame.hash == hash)
+      return &frame;
+  }
+  return nullptr;
+}
+
+static uint8_t commandArgCount(uint8_t command)
+{
+  switch (command)
+  {
+  case 0x21: // COLUMNADDR
+  case 0x22: // PAGEADDR
+    return 2;
+  case 0x20: // MEMORYMODE
+  case 0x81: // SETCONTRAST
+  case 0x8D: // CHARGEPUMP
+  case 0xA8: // SETMULTIPLEX
+  case 0xD3: // SETDISPLAYOFFSET
+  case 0xD5: // SETDISPLAYCLOCKDIV
+  case 0xD9: // SETPRECHARGE
+  case 0xDA: // SETCOMPINS
+  case 0xDB: // SETVCOMDETECT
+    return 1;
+  default:
+    return 0;
+  }
+}
+
+static void setPanelOn(bool on)
+{
+  if (on == state.panelOn)
+    return;
+  state.panelOn = on;
+  simTrace("oled %s", on ? "on" : "off");
+}
+
+static void panelCommandByte(uint8_t c)
+{
+  if (panelArgsNeeded > 0)
+  {
+    panelArgs[panelArgCount++] = c;
+    if (panelArgCount < panelArgsNeeded)
+      return;
+    panelArgsNeeded = 0;
+    if (panelCommand == 0x21)
+    {
+      columnStart = column = panelArgs[0] & 0x7F;
+      columnEnd = panelArgs[1] & 0x7F;
+    }
+    else if (panelCommand == 0x22)
+    {
+      pageStart = page = panelArgs[0] & 0x07;
+      pageEnd = panelArgs[1] & 0x07;
+    }
+    return;
+  }
+
+  panelCommand = c;
+  panelArgCount = 0;
+  panelArgsNeeded = commandArgCount(c);
+  if (c == 0xAE)
+    setPanelOn(false);
+  else if (c == 0xAF)
+    setPanelOn(true);
+}
+
+static void panelDataByte(uint8_t d)
+{
+  state.gddram[page * OLED_WIDTH + column] = d;
+  if (column < columnEnd)
+  {
+    column++;
+    return;
+  }
+  column = columnStart;
+  page = page < pageEnd ? page + 1 : pageStart;
+}
+
+/**
+ * @brief GDDRAMの内容が変わったら、描画済みのどのフレームと一致するかを記録する
+ */
+static void panelContentChanged()
+{
+  uint64_t hash = simFrameHash(state.gddram, sizeof(state.gddram));
+  if (hash == state.shownHash)
+    return;
+  state.shownHash = hash;
+
+  const FrameSnapshot *frame = findFrame(hash);
+  bool wasTorn = panelTorn;
+  panelTorn = !frame;
+  if (frame)
+  {
+    simTrace("frame %016llx %s", (unsigned long long)hash, frame->text.c_str());
+    if (framesFile)
+      fprintf(framesFile, "%llu %s\n", (unsigned long long)(state.nowMicros / 1000), frame->text.c_str());
+  }
+  else if (!wasTorn)
+  {
+    // 転送の途中で、新旧のフレームが混ざった状態 (フレームと一致するまで続く)
+    simTrace("torn");
+  }
+}
+
+uint8_t simI2cWrite(uint8_t address, const uint8_t *data, size_t len, uint32_t clockHz)
+{
+  activityCount++;
+  // 1バイト = 8ビット + ACK。アドレスのバイトを含む
+  simAdvance(I2C_TRANSACTION_MICROS + (uint64_t)(len + 1) * 9 * 1000000 / clockHz);
+  if (address != OLED_ADDRESS)
+    return 2;
+  if (len == 0)
+    return 0;
+
+  if (data[0] == 0x00)
+  {
+    for (size_t i = 1; i < len; i++)
+      panelCommandByte(data[i]);
+  }
+  else if (data[0] == 0x40)
+  {
+    for (size_t i = 1; i < len; i++)
+      panelDataByte(data[i]);
+    panelContentChanged();
+  }
+  return 0;
+}
+
+/**
+ * @brief パネルの表示内容をPBM画像として保存する
+ */
+static void writePanelImage(const std::string &path)
+{
+  FILE *image = fopen(path.c_str(), "w");
+  if (!image)
+    return;
+  fprintf(image, "P1\n%d %d\n", OLED_WIDTH, OLED_PAGES * 8);
+  for (int y = 0; y < OLED_PAGES * 8; y++)
+  {
+    for (int x = 0; x < OLED_WIDTH; x++)
+      fputc((state.gddram[(y / 8) * OLED_WIDTH + x] >> (y & 7)) & 1 ? '1' : '0', image);
+    fputc('\n', image);
+  }
+  fclose(image);
+}
+
+// --- 開始・終了 ---
+
+bool simWorldBegin(const char *scenarioPath, const char *outDirectory, const char *resumeFile, char **argv)
+{
+  wallStart = std::chrono::steady_clock::now();
+  outDir = outDirectory;
+  commandLine = argv;
+  resumePath = simOutputPath("resume.bin");
+  if (!loadScenario(scenarioPath))
+    return false;
+
+  const char *mode = "w";
+  if (resumeFile)
+  {
+    FILE *resume = fopen(resumeFile, "rb");
+    if (!resume || fread(&state, sizeof(state), 1, resume) != 1 || state.magic != RESUME_MAGIC)
+    {
+      fprintf(stderr, "cannot read %s\n", resumeFile);
+      return false;
+    }
+    fclose(resume);
+    mode = "a";
+    resetReason = REASON_SOFT_RESTART;
+    bootMicros = state.nowMicros;
+
+    // 再起動前までのイベントで変化した環境を復元する
+    while (nextEvent < events.size() && events[nextEvent].at <= state.nowMicros)
+      applyEvent(events[nextEvent++], true);
+  }
+  else
+  {
+    memset(&state, 0, sizeof(state));
+    state.magic = RESUME_MAGIC;
+    memset(state.eeprom, 0xFF, sizeof(state.eeprom)); // 消去済みのフラッシュ
+  }
+
+  traceFile = fopen(simOutputPath("trace.txt").c_str(), mode);
+  serialFile = fopen(simOutputPath("serial.log").c_str(), mode);
+  framesFile = fopen(simOutputPath("frames.txt").c_str(), mode);
+  apiFile = fopen(simOutputPath("api.log").c_str(), mode);
+  if (!traceFile || !serialFile || !framesFile || !apiFile)
+  {
+    fprintf(stderr, "cannot open output files in %s\n", outDirectory);
+    return false;
+  }
+
+  if (!resumeFile)
+    simTrace("start %llu", (unsigned long long)startEpoch);
+  simTrace("boot %u", state.restartCount);
+  return true;
+}
+
+void simWorldEnd()
+{
+  simTrace("end");
+  fclose(traceFile);
+  fclose(serialFile);
+  fclose(framesFile);
+  fclose(apiFile);
+  traceFile = serialFile = framesFile = apiFile = nullptr;
+  writePanelImage(simOutputPath("last_frame.pbm"));
+  remove(resumePath.c_str());
+}
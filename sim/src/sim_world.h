@@ -0,0 +1,113 @@
+#pragma once
+
+// シミュレーターの仮想世界 (時計・シナリオ・周辺機器・ネットワーク) と、
+// 偽のArduinoライブラリ (sim/fakes) の間のインターフェース
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+
+// --- 仮想世界の開始・終了 (sim_main.cppから呼び出す) ---
+// シナリオを読み込み、出力先を開く。resumePathを指定した場合は再起動前の状態を復元する
+bool simWorldBegin(const char *scenarioPath, const char *outDir, const char *resumePath, char **argv);
+// 出力ファイルを閉じ、最後の画面をlast_frame.pbmに保存する
+void simWorldEnd();
+// シナリオの終了時刻に達したら呼ばれる。レポートを出力してプロセスを終了する (sim_main.cpp)
+void simFinish() __attribute__((noreturn));
+// 出力先ディレクトリ内のファイルのパス
+std::string simOutputPath(const char *name);
+// 仮想時間と実時間の累計 (秒)。再起動をまたいで引き継がれる
+double simWallSeconds();
+
+// --- 仮想時計 ---
+// シナリオ開始からの経過時間 (µs)。再起動をまたいで連続する
+uint64_t simNowMicros();
+// 現在の起動からの経過時間 (µs)。millis()/micros()の元になる
+uint64_t simUptimeMicros();
+// 仮想時間を進める。途中に予定されたシナリオのイベントは、その時刻に適用する
+void simAdvance(uint64_t micros);
+void simAdvanceTo(uint64_t t);
+// スケッチがSDKに制御を返す (yield・delay・loop()の終了・通信の待ち)。期限が来たTickerを呼ぶ (fake_core.cpp)
+void simSdkService();
+// ファームウェアが外部と入出力したことを記録する (アイドル判定に使用)
+void simActivity();
+uint32_t simActivityCount();
+// 次に予定されたシナリオのイベントの時刻 (なければUINT64_MAX)
+uint64_t simNextEventMicros();
+
+// --- トレース (レポートの元データ) ---
+// 1行 = "<経過ms> <種類> <引数...>"
+void simTrace(const char *format, ...) __attribute__((format(printf, 1, 2)));
+
+// --- 時刻 (NTP) ---
+void simConfigTime(long gmtOffsetSec, int daylightOffsetSec);
+// 同期済みならUNIX時刻 (秒)、未同期なら起動からの秒数を返す
+int64_t simEpochSeconds();
+long simGmtOffset();
+
+// --- GPIO・シリアル・センサー ---
+int simDigitalRead(uint8_t pin);
+// シナリオから入力されたシリアル受信データを1文字取り出す (なければ-1)
+int simSerialRead();
+int simSerialAvailable();
+void simSerialOutput(const uint8_t *data, size_t len);
+bool simDhtRead(float &temp, float &hum);
+
+// --- 不揮発メモリ (再起動後も保持される) ---
+uint8_t *simRtcMemory();    // 512バイト
+uint8_t *simEepromMemory(); // 4096バイト
+uint8_t simResetReason();
+void simRestart() __attribute__((noreturn));
+
+// --- WiFi・ネットワーク ---
+bool simWifiConnected();
+// 接続が切れるたびに増える (TCP接続の有効性の判定に使用)
+uint32_t simWifiGeneration();
+// bssidがnullptrでなければ、スキャンせずに指定したBSSID/チャンネルのアクセスポイントに接続する。
+// pskがtrueならパスフレーズではなく導出済みのPSKが渡された
+void simWifiBegin(const uint8_t *bssid, int32_t channel, bool psk);
+// 接続中のアクセスポイントのBSSIDとチャンネル
+const uint8_t *simWifiBssid();
+int32_t simWifiChannel();
+void simWifiDisconnect();
+bool simDnsLookup(const char *host);
+
+struct SimConnection
+{
+  bool open;
+  bool secure;
+  uint32_t generation;
+  uint64_t lastUsed;
+};
+bool simConnectionAlive(const SimConnection &connection);
+
+struct SimHttpResponse
+{
+  int status; // HTTPステータス (負の値はHTTPClientのエラーコード)
+  std::string body;
+  std::string contentEncoding;
+};
+// acceptGzip: 要求に "Accept-Encoding: gzip" が付いている
+SimHttpResponse simHttpRequest(const char *method, const std::string &url, bool acceptGzip, SimConnection &connection);
+// 時刻startに受信を始めたsizeバイトの応答ボディのうち、現在までに届いたバイト数
+size_t simBodyArrived(uint64_t start, size_t size);
+
+// 端末のHTTPサーバー宛てのリクエスト (シナリオの "api")。WiFiの接続中のみ届く
+bool simApiNextRequest(std::string &method, std::string &target);
+// 応答をapi.logに記録する
+void simApiResponse(int status, const std::string &body);
+
+bool simUdpSend(const uint8_t ip[4], uint16_t port, const uint8_t *data, size_t len);
+// 端末のportに届いたUDPパケット (シナリオの "command") を1つ取り出す。WiFiの接続中のみ届く
+bool simUdpReceive(uint16_t port, std::string &data, uint8_t ip[4], uint16_t &remotePort);
+// 仮想世界側でのHMAC-SHA256 (仮想時計を進めない, fake_bearssl.cpp)
+void simHmacSha256(const void *key, size_t keyLen, const void *data, size_t len, uint8_t out[32]);
+bool simMqttConnect();
+bool simMqttPublish(const char *topic, size_t len);
+
+// --- OLED (I2Cに接続されたSSD1306のモデル) ---
+// @return Wire.endTransmission()の戻り値 (0: 成功, 2: アドレスNACK)
+uint8_t simI2cWrite(uint8_t address, const uint8_t *data, size_t len, uint32_t clockHz);
+// 描画済みのフレームバッファの内容を登録する (画面上の内容と照合するため)
+void simRegisterFrame(uint64_t hash, const std::string &text);
+uint64_t simFrameHash(const uint8_t *buffer, size_t len);
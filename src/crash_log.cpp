@@ -0,0 +1,293 @@
+#include "crash_log.h"
+#include "rtc_layout.h"
+#include "log.h"
+#include <EEPROM.h>
+#include <user_interface.h>
+
+#define CRASH_LOG_ENTRIES 16
+#define CRASH_LOG_MAGIC 0x43524C31 // "CRL1"
+#define RTC_SESSION_MAGIC 0x53455331 // "SES1"
+// 前回と同じ要因のリセットはフラッシュに追記せず、RTCメモリで回数だけ数える。
+// この回数に達したときに1度だけ前回の記録の回数を更新する (電源が切れても繰り返したことが残るように)
+#define CRASH_LOG_REPEAT_COMMIT 8
+
+// 稼働中のセッション情報 (RTCメモリに保持し、リセット後の起動時に読み出す)
+struct RtcSession
+{
+  uint32_t magic;
+  uint32_t uptimeSec;
+  uint16_t minFreeHeap;
+  int16_t lastNetError;
+  uint8_t subsystem;
+  uint8_t maxFragmentation;
+  uint16_t checksum;
+};
+
+// フラッシュに保存する1回分の起動記録
+struct CrashLogEntry
+{
+  uint32_t bootCount;
+  uint32_t uptimeSec; // リセットまでの稼働時間 (前回のセッション)
+  uint32_t exccause;
+  uint32_t epc1;
+  uint32_t excvaddr;
+  uint16_t minFreeHeap;
+  int16_t lastNetError;
+  uint8_t reason; // rst_info.reason
+  uint8_t subsystem;
+  uint8_t maxFragmentation;
+  uint8_t repeats; // 同じ要因で続けて起きたリセットの回数 (この記録を除く, 255で飽和)
+};
+
+// 最新の記録と同じ要因で続けて起きたリセットの回数 (RTCメモリに保持する)
+struct RtcRepeat
+{
+  uint16_t count;
+  uint16_t check; // ~count (電源投入直後の無効なデータと区別する)
+};
+
+struct CrashLogHeader
+{
+  uint32_t magic;
+  uint32_t bootCount;
+  uint16_t head;  // 次に書き込む位置
+  uint16_t count; // 記録済みの件数
+};
+
+#define CRASH_LOG_EEPROM_SIZE (sizeof(CrashLogHeader) + sizeof(CrashLogEntry) * CRASH_LOG_ENTRIES)
+
+static RtcSession session;
+static uint16_t repeatCount = 0;
+
+static uint16_t sessionChecksum(const RtcSession &s)
+{
+  const uint8_t *p = (const uint8_t *)&s;
+  uint16_t sum = 0;
+  for (size_t i = 0; i < offsetof(RtcSession, checksum); i++)
+    sum = (sum << 1 | sum >> 15) ^ p[i];
+  return sum;
+}
+
+static void saveSession()
+{
+  session.checksum = sessionChecksum(session);
+  ESP.rtcUserMemoryWrite(RTC_BLOCK_CRASH_LOG, (uint32_t *)&session, sizeof(session));
+}
+
+static void sampleHeap()
+{
+  uint32_t freeHeap = ESP.getFreeHeap();
+  if (freeHeap < session.minFreeHeap)
+    session.minFreeHeap = freeHeap;
+  uint8_t fragmentation = ESP.getHeapFragmentation();
+  if (fragmentation > session.maxFragmentation)
+    session.maxFragmentation = fragmentation;
+}
+
+static const char *resetReasonName(uint8_t reason)
+{
+  switch (reason)
+  {
+  case REASON_DEFAULT_RST:
+    return "Power on";
+  case REASON_WDT_RST:
+    return "Hardware WDT";
+  case REASON_EXCEPTION_RST:
+    return "Exception";
+  case REASON_SOFT_WDT_RST:
+    return "Software WDT";
+  case REASON_SOFT_RESTART:
+    return "Software restart";
+  case REASON_DEEP_SLEEP_AWAKE:
+    return "Deep sleep wake";
+  case REASON_EXT_SYS_RST:
+    return "External reset";
+  default:
+    return "Unknown";
+  }
+}
+
+static const char *subsystemName(uint8_t subsystem)
+{
+  switch ((Subsystem)subsystem)
+  {
+  case Subsystem::Idle:
+    return "Idle";
+  case Subsystem::Boot:
+    return "Boot";
+  case Subsystem::WeatherFetch:
+    return "Weather fetch";
+  case Subsystem::Post:
+    return "POST";
+  case Subsystem::WiFiReconnect:
+    return "WiFi reconnect";
+  case Subsystem::Render:
+    return "Render";
+  case Subsystem::OtaUpdate:
+    return "OTA update";
+  default:
+    return "Unknown";
+  }
+}
+
+/**
+ * @brief 2つの記録が同じ要因 (リセット要因・例外の場所・実行中の処理・通信エラー) によるものか
+ */
+static bool sameCause(const CrashLogEntry &a, const CrashLogEntry &b)
+{
+  return a.reason == b.reason && a.exccause == b.exccause && a.epc1 == b.epc1 && a.subsystem == b.subsystem &&
+         a.lastNetError == b.lastNetError;
+}
+
+static void saveRepeatCount()
+{
+  RtcRepeat repeat = {repeatCount, (uint16_t)~repeatCount};
+  ESP.rtcUserMemoryWrite(RTC_BLOCK_CRASH_REPEAT, (uint32_t *)&repeat, sizeof(repeat));
+}
+
+void crashLogBegin()
+{
+  // 前回のセッション情報を読み出す (電源投入直後は無効なデータが入っている)
+  RtcSession previous;
+  ESP.rtcUserMemoryRead(RTC_BLOCK_CRASH_LOG, (uint32_t *)&previous, sizeof(previous));
+  bool previousValid = previous.magic == RTC_SESSION_MAGIC && previous.checksum == sessionChecksum(previous);
+  RtcRepeat repeat;
+  ESP.rtcUserMemoryRead(RTC_BLOCK_CRASH_REPEAT, (uint32_t *)&repeat, sizeof(repeat));
+  uint16_t previousRepeats = previousValid && repeat.check == (uint16_t)~repeat.count ? repeat.count : 0;
+
+  const rst_info *info = ESP.getResetInfoPtr();
+
+  // フラッシュへの書き込みは起動ごとに最大1回にまとめる
+  EEPROM.begin(CRASH_LOG_EEPROM_SIZE);
+  CrashLogHeader header;
+  EEPROM.get(0, header);
+  if (header.magic != CRASH_LOG_MAGIC || header.head >= CRASH_LOG_ENTRIES || header.count > CRASH_LOG_ENTRIES)
+  {
+    header = {CRASH_LOG_MAGIC, 0, 0, 0};
+  }
+
+  CrashLogEntry entry = {};
+  entry.reason = info->reason;
+  entry.exccause = info->exccause;
+  entry.epc1 = info->epc1;
+  entry.excvaddr = info->excvaddr;
+  if (previousValid)
+  {
+    entry.uptimeSec = previous.uptimeSec;
+    entry.minFreeHeap = previous.minFreeHeap;
+    entry.maxFragmentation = previous.maxFragmentation;
+    entry.subsystem = previous.subsystem;
+    entry.lastNetError = previous.lastNetError;
+  }
+
+  CrashLogEntry latest = {};
+  uint16_t latestIndex = (header.head + CRASH_LOG_ENTRIES - 1) % CRASH_LOG_ENTRIES;
+  size_t latestAddress = sizeof(CrashLogHeader) + latestIndex * sizeof(CrashLogEntry);
+  if (header.count > 0)
+    EEPROM.get(latestAddress, latest);
+
+  uint32_t bootNumber;
+  if (previousValid && header.count > 0 && sameCause(entry, latest))
+  {
+    // 再起動のループ (DNS障害など) でフラッシュを書き換え続けないよう、回数だけ数える
+    repeatCount = previousRepeats + 1;
+    bootNumber = latest.bootCount + repeatCount;
+    if (repeatCount == CRASH_LOG_REPEAT_COMMIT)
+    {
+      latest.repeats = repeatCount;
+      EEPROM.put(latestAddress, latest);
+    }
+  }
+  else
+  {
+    // 書き込んでいない繰り返しの回数を、新しい記録と一緒に前回の記録へ反映する
+    if (header.count > 0 && previousRepeats > latest.repeats)
+    {
+      latest.repeats = min(previousRepeats, (uint16_t)UINT8_MAX);
+      EEPROM.put(latestAddress, latest);
+    }
+    repeatCount = 0;
+    header.bootCount += previousRepeats + 1;
+    entry.bootCount = bootNumber = header.bootCount;
+    EEPROM.put(sizeof(CrashLogHeader) + header.head * sizeof(CrashLogEntry), entry);
+    header.head = (header.head + 1) % CRASH_LOG_ENTRIES;
+    if (header.count < CRASH_LOG_ENTRIES)
+      header.count++;
+    EEPROM.put(0, header);
+  }
+  EEPROM.end(); // 変更があれば書き込み、RAM上のコピーを解放する
+  saveRepeatCount();
+
+  // 今回のセッションの記録を開始する
+  session = {RTC_SESSION_MAGIC, 0, 0xFFFF, 0, (uint8_t)Subsystem::Boot, 0, 0};
+  sampleHeap();
+  saveSession();
+
+  if (repeatCount > 0)
+    LOG_I(LogTag::System, "Boot #%u, reset reason: %s (same cause %u times in a row)", bootNumber,
+          resetReasonName(entry.reason), repeatCount + 1);
+  else
+    LOG_I(LogTag::System, "Boot #%u, reset reason: %s", bootNumber, resetReasonName(entry.reason));
+}
+
+Subsystem crashLogSetSubsystem(Subsystem subsystem)
+{
+  Subsystem previous = (Subsystem)session.subsystem;
+  if (previous == subsystem)
+    return previous;
+  session.subsystem = (uint8_t)subsystem;
+  session.uptimeSec = millis() / 1000; // setup()中や長い処理の途中でのリセットにも稼働時間を残す
+  sampleHeap();
+  saveSession();
+  return previous;
+}
+
+void crashLogSetNetError(int code)
+{
+  session.lastNetError = (int16_t)constrain(code, INT16_MIN, INT16_MAX);
+  session.uptimeSec = millis() / 1000;
+  saveSession();
+}
+
+void crashLogTick()
+{
+  session.uptimeSec = millis() / 1000;
+  sampleHeap();
+  saveSession();
+}
+
+void crashLogDump(Print &out, size_t count)
+{
+  EEPROM.begin(CRASH_LOG_EEPROM_SIZE);
+  CrashLogHeader header;
+  EEPROM.get(0, header);
+  if (header.magic != CRASH_LOG_MAGIC || header.count > CRASH_LOG_ENTRIES)
+  {
+    out.println(F("[CrashLog] No entries."));
+    EEPROM.end();
+    return;
+  }
+
+  if (count > header.count)
+    count = header.count;
+  out.printf("--- Crash log (latest %u of %u entries) ---\n", (unsigned)count, header.count);
+  for (size_t i = 0; i < count; i++)
+  {
+    uint16_t index = (header.head + CRASH_LOG_ENTRIES - 1 - i) % CRASH_LOG_ENTRIES;
+    CrashLogEntry e;
+    EEPROM.get(sizeof(CrashLogHeader) + index * sizeof(CrashLogEntry), e);
+
+    out.printf("#%u %s", e.bootCount, resetReasonName(e.reason));
+    if (e.reason == REASON_EXCEPTION_RST || e.reason == REASON_SOFT_WDT_RST || e.reason == REASON_WDT_RST)
+      out.printf(" (exccause=%u epc1=0x%08x excvaddr=0x%08x)", e.exccause, e.epc1, e.excvaddr);
+    out.printf(" | prev uptime: %us, min heap: %u, max frag: %u%%, active: %s, net err: %d",
+               e.uptimeSec, e.minFreeHeap, e.maxFragmentation, subsystemName(e.subsystem), e.lastNetError);
+    // 最新の記録は、まだフラッシュに書き込んでいない繰り返しの回数も含める
+    unsigned repeats = i == 0 ? max((unsigned)e.repeats, (unsigned)repeatCount) : e.repeats;
+    if (repeats > 0)
+      out.printf(" (repeated %u more times)", repeats);
+    out.println();
+  }
+  out.println(F("----------------------------------------"));
+  EEPROM.end();
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <Arduino.h>
+
+// リセット直前に実行していた処理
+enum class Subsystem : uint8_t
+{
+  Idle,
+  Boot,
+  WeatherFetch,
+  Post,
+  WiFiReconnect,
+  Render,
+  OtaUpdate
+};
+
+// 通信エラーコード (HTTPClientのエラーコード・HTTPステータス以外のもの)
+#define NET_ERROR_DNS_LOOKUP -200
+
+/**
+ * @brief 起動時に呼び出し、前回のセッション情報とリセット要因をフラッシュのリングログに1件追記する
+ */
+void crashLogBegin();
+
+/**
+ * @brief 現在実行中の処理を記録する (RTCメモリに保存され、リセット後に参照される)
+ * @return Subsystem 直前まで記録されていた処理 (終了時に元へ戻すために使用する)
+ */
+Subsystem crashLogSetSubsystem(Subsystem subsystem);
+
+/**
+ * @brief 直近の通信エラーコードを記録する
+ * @param code HTTPClientのエラーコード、HTTPステータス、またはNET_ERROR_*の値
+ */
+void crashLogSetNetError(int code);
+
+/**
+ * @brief 稼働時間・ヒープの最小空き容量・最大断片化率を更新する。1秒ごとに呼び出す
+ */
+void crashLogTick();
+
+/**
+ * @brief 記録されている直近のエントリを新しい順に出力する
+ * @param out 出力先 (Serialなど)
+ * @param count 出力する最大件数
+ */
+void crashLogDump(Print &out, size_t count);
@@ -0,0 +1,198 @@
+#include "display_flush.h"
+#include "log.h"
+#include <Wire.h>
+
+// 1回のI2Cトランザクションで送る表示データのバイト数
+// ESP8266のWireバッファ (128バイト) に収まり、400kHzで1ms弱に収まる大きさにする
+#define FLUSH_CHUNK_BYTES 32
+
+static Adafruit_SSD1306 *oled = nullptr;
+static uint8_t oledAddress = 0x3C;
+static uint32_t busClockHz = 400000;
+
+// 最後にOLEDへ送信した内容の写し (差分転送に使用する)
+static uint8_t *sentBuffer = nullptr;
+static uint16_t width = 0;
+static uint8_t pageCount = 0;
+static bool sentValid = false;
+
+// 転送中のフレームの状態
+static bool frameActive = false;
+static uint8_t currentPage = 0;
+static int16_t currentColumn = -1; // 次に送る列 (-1: ページ内の転送範囲が未決定)
+static int16_t endColumn = 0;      // 転送範囲の最後の列
+static bool windowSet = false;     // OLED側の書き込み範囲を設定済みか
+static uint32_t frameBusMicros = 0;
+static uint32_t frameBytes = 0;
+
+static DisplayFlushStats stats = {0, 0, 0, 0, 0, 0};
+
+void displayFlushBegin(Adafruit_SSD1306 *display, uint8_t i2cAddress, uint32_t clockHz)
+{
+  oled = display;
+  oledAddress = i2cAddress;
+  busClockHz = clockHz;
+  width = display->width();
+  pageCount = (display->height() + 7) / 8;
+
+  delete[] sentBuffer;
+  sentBuffer = new uint8_t[width * pageCount];
+  sentValid = false;
+  frameActive = false;
+}
+
+void displayFlushRequest()
+{
+  if (!oled || !sentBuffer)
+    return;
+
+  // 前のフレームの転送が終わる前に次のフレームが描画された
+  if (frameActive)
+    stats.tornFrames++;
+
+  frameActive = true;
+  currentPage = 0;
+  currentColumn = -1;
+  frameBusMicros = 0;
+  frameBytes = 0;
+}
+
+void displayFlushInvalidate()
+{
+  sentValid = false;
+  // display.display()でOLED側の書き込み範囲が変わっているため、ページの先頭から送り直す
+  if (frameActive)
+  {
+    currentPage = 0;
+    currentColumn = -1;
+  }
+}
+
+/**
+ * @brief 指定ページで前回送信した内容と異なる列の範囲を求める
+ * @return 差分があればtrue
+ */
+static bool findDirtyRange(const uint8_t *frame, uint8_t page, int16_t &first, int16_t &last)
+{
+  const uint8_t *now = frame + page * width;
+  if (!sentValid)
+  {
+    first = 0;
+    last = width - 1;
+    return true;
+  }
+
+  const uint8_t *prev = sentBuffer + page * width;
+  first = 0;
+  while (first < width && now[first] == prev[first])
+    first++;
+  if (first == width)
+    return false;
+  last = width - 1;
+  while (now[last] == prev[last])
+    last--;
+  return true;
+}
+
+static void sendWindow(uint8_t page, uint8_t firstColumn, uint8_t lastColumn)
+{
+  // SSD1306は水平アドレッシングモードで初期化されているため、範囲を指定すれば列が自動で進む
+  Wire.setClock(busClockHz);
+  Wire.beginTransmission(oledAddress);
+  Wire.write((uint8_t)0x00); // コマンド列
+  Wire.write((uint8_t)SSD1306_COLUMNADDR);
+  Wire.write(firstColumn);
+  Wire.write(lastColumn);
+  Wire.write((uint8_t)SSD1306_PAGEADDR);
+  Wire.write(page);
+  Wire.write(page);
+  Wire.endTransmission();
+}
+
+static void finishFrame()
+{
+  frameActive = false;
+  sentValid = true;
+  stats.frames++;
+  stats.lastFrameBusMicros = frameBusMicros;
+  stats.lastFrameBytes = frameBytes;
+  if (frameBusMicros > stats.maxFrameBusMicros)
+  {
+    stats.maxFrameBusMicros = frameBusMicros;
+    LOG_D(LogTag::Display, "New max bus time per frame: %u us (%u bytes)", frameBusMicros, frameBytes);
+  }
+}
+
+bool displayFlushStep()
+{
+  if (!frameActive)
+    return false;
+
+  unsigned long start = micros();
+  const uint8_t *frame = oled->getBuffer();
+
+  // 次に転送すべき範囲を探す
+  while (currentColumn < 0)
+  {
+    if (currentPage >= pageCount)
+    {
+      finishFrame();
+      return false;
+    }
+    int16_t first, last;
+    if (findDirtyRange(frame, currentPage, first, last))
+    {
+      currentColumn = first;
+      endColumn = last;
+      windowSet = false;
+    }
+    else
+    {
+      currentPage++;
+    }
+  }
+
+  unsigned long busStart = micros();
+  if (!windowSet)
+  {
+    sendWindow(currentPage, currentColumn, endColumn);
+    windowSet = true;
+  }
+
+  size_t offset = currentPage * width + currentColumn;
+  uint8_t count = min(FLUSH_CHUNK_BYTES, endColumn - currentColumn + 1);
+
+  Wire.beginTransmission(oledAddress);
+  Wire.write((uint8_t)0x40); // 表示データ
+  Wire.write(frame + offset, count);
+  Wire.endTransmission();
+  frameBusMicros += micros() - busStart;
+  memcpy(sentBuffer + offset, frame + offset, count);
+
+  currentColumn += count;
+  frameBytes += count;
+  if (currentColumn > endColumn)
+  {
+    currentColumn = -1;
+    currentPage++;
+  }
+
+  uint32_t elapsed = micros() - start;
+  if (elapsed > stats.maxStepMicros)
+    stats.maxStepMicros = elapsed;
+  return true;
+}
+
+const DisplayFlushStats &displayFlushStats()
+{
+  return stats;
+}
+
+void displayFlushDump(Print &out)
+{
+  out.printf("--- Display flush (%u frames, %u torn) ---\n", stats.frames, stats.tornFrames);
+  out.printf("  bus per frame: last %u us (%u bytes), max %u us\n", stats.lastFrameBusMicros, stats.lastFrameBytes,
+             stats.maxFrameBusMicros);
+  out.printf("  max step: %u us\n", stats.maxStepMicros);
+  out.println(F("------------------------------"));
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <Adafruit_SSD1306.h>
+
+// フレームバッファ転送の統計
+struct DisplayFlushStats
+{
+  uint32_t frames;             // 転送を完了したフレーム数
+  uint32_t tornFrames;         // 転送途中で次のフレームが描画された回数 (画面上で新旧が混在した)
+  uint32_t lastFrameBusMicros; // 直近のフレームでI2Cバスを占有した時間
+  uint32_t maxFrameBusMicros;  // 1フレームあたりのI2Cバス占有時間の最大値
+  uint32_t lastFrameBytes;     // 直近のフレームで送信した表示データのバイト数
+  uint32_t maxStepMicros;      // 1回のdisplayFlushStep()にかかった時間の最大値
+};
+
+/**
+ * @brief 分割転送エンジンを初期化する。display.begin()の後に呼び出す
+ *
+ * @param display OLEDディスプレイのオブジェクトへのポインタ
+ * @param i2cAddress OLEDのI2Cアドレス
+ * @param clockHz 転送時のI2Cクロック (Hz)
+ */
+void displayFlushBegin(Adafruit_SSD1306 *display, uint8_t i2cAddress, uint32_t clockHz);
+
+/**
+ * @brief フレームバッファの描画が完了したことを通知する (display.display()の代わりに呼び出す)。
+ *        前回転送した内容と異なる範囲だけが、以降のdisplayFlushStep()で少しずつ送信される
+ */
+void displayFlushRequest();
+
+/**
+ * @brief 転送を1チャンク分だけ進める。loop()から毎回呼び出す
+ * @return bool まだ転送すべきデータが残っていればtrue
+ */
+bool displayFlushStep();
+
+/**
+ * @brief display.display()などで直接描画した後に呼び出し、次のフレームを全面転送させる
+ */
+void displayFlushInvalidate();
+
+/**
+ * @brief 転送の統計を返す
+ */
+const DisplayFlushStats &displayFlushStats();
+
+/**
+ * @brief 転送の統計 (フレーム数・転送途中で描画された回数・I2Cバスの占有時間) を出力する
+ * @param out 出力先 (Serialなど)
+ */
+void displayFlushDump(Print &out);
@@ -0,0 +1,476 @@
+#include "gzip_stream.h"
+
+// --- DEFLATE (RFC 1951) の定数テーブル ---
+static const uint16_t LENGTH_BASE[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+                                         35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+static const uint8_t LENGTH_EXTRA[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+                                         3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+static const uint16_t DIST_BASE[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+                                       257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+static const uint8_t DIST_EXTRA[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+                                       7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+// 動的ハフマンブロックで符号長の符号長が並ぶ順序
+static const uint8_t CODE_LENGTH_ORDER[19] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+
+// gzipヘッダーのフラグ
+#define GZIP_FHCRC 0x02
+#define GZIP_FEXTRA 0x04
+#define GZIP_FNAME 0x08
+#define GZIP_FCOMMENT 0x10
+
+GzipInflateStream::GzipInflateStream(Stream &source, uint8_t *window, size_t windowSize)
+    : _source(source), _window(window), _windowMask(windowSize - 1)
+{
+}
+
+int GzipInflateStream::available()
+{
+  if (_peeked >= 0)
+    return 1;
+  if (_state == State::Done || _state == State::Failed)
+    return 0;
+  // 一致コピーの途中であれば、受信を待たずに返せる
+  if (_matchLength > 0)
+    return 1;
+  return _source.available() > 0 ? 1 : 0;
+}
+
+int GzipInflateStream::read()
+{
+  if (_peeked >= 0)
+  {
+    int c = _peeked;
+    _peeked = -1;
+    return c;
+  }
+
+  unsigned long start = micros();
+  _waitMicros = 0;
+  int c = inflateNext();
+  _stats.inflateMicros += (micros() - start) - _waitMicros;
+  return c;
+}
+
+int GzipInflateStream::peek()
+{
+  if (_peeked < 0)
+    _peeked = read();
+  return _peeked;
+}
+
+/**
+ * @brief 伸長結果を1バイト返す。データが尽きた場合・エラーの場合は-1を返す
+ */
+int GzipInflateStream::inflateNext()
+{
+  for (;;)
+  {
+    // 一致コピー (過去の出力の繰り返し) の途中
+    if (_matchLength > 0)
+    {
+      _matchLength--;
+      return emit(_window[(_outTotal - _matchDistance) & _windowMask]);
+    }
+
+    switch (_state)
+    {
+    case State::Header:
+      if (!readHeader())
+        return -1;
+      _state = State::BlockStart;
+      break;
+
+    case State::BlockStart:
+      if (_finalBlock)
+      {
+        if (!readTrailer())
+          return -1;
+        _state = State::Done;
+        return -1;
+      }
+      if (!startBlock())
+        return -1;
+      break;
+
+    case State::Stored:
+    {
+      if (_storedRemaining == 0)
+      {
+        _state = State::BlockStart;
+        break;
+      }
+      uint8_t b;
+      if (!readSourceByte(b))
+      {
+        fail("Unexpected end of data");
+        return -1;
+      }
+      _storedRemaining--;
+      return emit(b);
+    }
+
+    case State::Huffman:
+    {
+      int sym = decodeSymbol(_litTree);
+      if (sym < 0)
+      {
+        fail("Invalid literal/length code");
+        return -1;
+      }
+      if (sym < 256)
+        return emit((uint8_t)sym);
+      if (sym == 256)
+      {
+        _state = State::BlockStart; // ブロック終端
+        break;
+      }
+
+      sym -= 257;
+      if (sym >= 29)
+      {
+        fail("Invalid length symbol");
+        return -1;
+      }
+      int extra = getBits(LENGTH_EXTRA[sym]);
+      int distSym = decodeSymbol(_distTree);
+      if (extra < 0 || distSym < 0 || distSym >= 30)
+      {
+        fail("Invalid distance code");
+        return -1;
+      }
+      int distExtra = getBits(DIST_EXTRA[distSym]);
+      if (distExtra < 0)
+      {
+        fail("Unexpected end of data");
+        return -1;
+      }
+
+      _matchLength = LENGTH_BASE[sym] + extra;
+      _matchDistance = DIST_BASE[distSym] + distExtra;
+      if (_matchDistance > _outTotal)
+      {
+        fail("Distance before start of data");
+        return -1;
+      }
+      if (_matchDistance > _windowMask + 1)
+      {
+        fail("Distance exceeds window");
+        return -1;
+      }
+      break;
+    }
+
+    default:
+      return -1;
+    }
+  }
+}
+
+bool GzipInflateStream::readHeader()
+{
+  uint8_t h[10];
+  for (uint8_t &b : h)
+  {
+    if (!readSourceByte(b))
+      return fail("Missing gzip header");
+  }
+  if (h[0] != 0x1F || h[1] != 0x8B || h[2] != 8)
+    return fail("Not a gzip stream");
+
+  uint8_t flags = h[3];
+  uint8_t b;
+  if (flags & GZIP_FEXTRA)
+  {
+    uint8_t lo, hi;
+    if (!readSourceByte(lo) || !readSourceByte(hi))
+      return fail("Truncated gzip header");
+    for (uint16_t n = lo | (hi << 8); n > 0; n--)
+    {
+      if (!readSourceByte(b))
+        return fail("Truncated gzip header");
+    }
+  }
+  // ファイル名・コメントはNULL終端の文字列として読み飛ばす
+  for (uint8_t flag : {GZIP_FNAME, GZIP_FCOMMENT})
+  {
+    if (!(flags & flag))
+      continue;
+    do
+    {
+      if (!readSourceByte(b))
+        return fail("Truncated gzip header");
+    } while (b != 0);
+  }
+  if (flags & GZIP_FHCRC)
+  {
+    if (!readSourceByte(b) || !readSourceByte(b))
+      return fail("Truncated gzip header");
+  }
+  return true;
+}
+
+bool GzipInflateStream::readTrailer()
+{
+  // 最終ブロックの残りビットを捨ててバイト境界に揃える
+  _bitBuf = 0;
+  _bitCount = 0;
+
+  uint8_t t[8];
+  for (uint8_t &b : t)
+  {
+    if (!readSourceByte(b))
+      return fail("Missing gzip trailer");
+  }
+  uint32_t crc = t[0] | (t[1] << 8) | (t[2] << 16) | ((uint32_t)t[3] << 24);
+  uint32_t size = t[4] | (t[5] << 8) | (t[6] << 16) | ((uint32_t)t[7] << 24);
+  if (crc != (_crc ^ 0xFFFFFFFF))
+    return fail("CRC mismatch");
+  if (size != _outTotal)
+    return fail("Size mismatch");
+  return true;
+}
+
+bool GzipInflateStream::startBlock()
+{
+  int header = getBits(3);
+  if (header < 0)
+    return fail("Unexpected end of data");
+  _finalBlock = header & 1;
+
+  switch (header >> 1)
+  {
+  case 0: // 無圧縮ブロック
+  {
+    _bitBuf = 0;
+    _bitCount = 0;
+    uint8_t l[4];
+    for (uint8_t &b : l)
+    {
+      if (!readSourceByte(b))
+        return fail("Unexpected end of data");
+    }
+    uint16_t len = l[0] | (l[1] << 8);
+    uint16_t nlen = l[2] | (l[3] << 8);
+    if (len != (uint16_t)~nlen)
+      return fail("Stored block length mismatch");
+    _storedRemaining = len;
+    _state = State::Stored;
+    return true;
+  }
+  case 1: // 固定ハフマンブロック
+  {
+    uint8_t lengths[288];
+    memset(lengths, 8, 144);
+    memset(lengths + 144, 9, 112);
+    memset(lengths + 256, 7, 24);
+    memset(lengths + 280, 8, 8);
+    buildTree(_litTree, lengths, 288);
+    // 距離符号は未使用の30, 31を含めた32個で完全な符号になる
+    memset(lengths, 5, 32);
+    buildTree(_distTree, lengths, 32);
+    _state = State::Huffman;
+    return true;
+  }
+  case 2: // 動的ハフマンブロック
+    if (!decodeTrees())
+      return false;
+    _state = State::Huffman;
+    return true;
+  default:
+    return fail("Invalid block type");
+  }
+}
+
+/**
+ * @brief 符号長の並びから正準ハフマン符号表を作る
+ */
+bool GzipInflateStream::buildTree(Tree &tree, const uint8_t *lengths, uint16_t num)
+{
+  uint16_t offsets[16];
+  memset(tree.counts, 0, sizeof(tree.counts));
+
+  int maxSymbol = -1;
+  for (uint16_t i = 0; i < num; i++)
+  {
+    if (lengths[i])
+    {
+      maxSymbol = i;
+      tree.counts[lengths[i]]++;
+    }
+  }
+
+  uint32_t available = 1;
+  uint16_t numCodes = 0;
+  for (uint8_t i = 0; i < 16; i++)
+  {
+    if (tree.counts[i] > available)
+      return false; // 符号が多すぎる
+    available = 2 * (available - tree.counts[i]);
+    offsets[i] = numCodes;
+    numCodes += tree.counts[i];
+  }
+  if ((numCodes > 1 && available > 0) || (numCodes == 1 && tree.counts[1] != 1))
+    return false; // 不完全な符号
+
+  for (uint16_t i = 0; i < num; i++)
+  {
+    if (lengths[i])
+      tree.symbols[offsets[lengths[i]]++] = i;
+  }
+
+  // 符号が1つだけの場合は、もう一方のビットを無効なシンボルに割り当てる
+  if (numCodes == 1)
+  {
+    tree.counts[1] = 2;
+    tree.symbols[1] = maxSymbol + 1;
+  }
+  return true;
+}
+
+bool GzipInflateStream::decodeTrees()
+{
+  int hlit = getBits(5);
+  int hdist = getBits(5);
+  int hclen = getBits(4);
+  if (hlit < 0 || hdist < 0 || hclen < 0)
+    return fail("Unexpected end of data");
+  hlit += 257;
+  hdist += 1;
+  hclen += 4;
+  if (hlit > 286 || hdist > 30)
+    return fail("Invalid tree size");
+
+  uint8_t lengths[288 + 32];
+  memset(lengths, 0, 19);
+  for (int i = 0; i < hclen; i++)
+  {
+    int len = getBits(3);
+    if (len < 0)
+      return fail("Unexpected end of data");
+    lengths[CODE_LENGTH_ORDER[i]] = len;
+  }
+  // 符号長を復号するための符号表は、一時的にリテラル用の表を使う
+  if (!buildTree(_litTree, lengths, 19))
+    return fail("Invalid code length tree");
+
+  for (int num = 0; num < hlit + hdist;)
+  {
+    int sym = decodeSymbol(_litTree);
+    if (sym < 0 || sym > 18)
+      return fail("Invalid code length");
+    if (sym < 16)
+    {
+      lengths[num++] = sym;
+      continue;
+    }
+
+    // 16: 直前の符号長を3-6回繰り返す / 17: 0を3-10回 / 18: 0を11-138回
+    uint8_t fill = 0;
+    int bits;
+    int repeat;
+    if (sym == 16)
+    {
+      if (num == 0)
+        return fail("Invalid repeat");
+      fill = lengths[num - 1];
+      bits = getBits(2);
+      repeat = bits + 3;
+    }
+    else if (sym == 17)
+    {
+      bits = getBits(3);
+      repeat = bits + 3;
+    }
+    else
+    {
+      bits = getBits(7);
+      repeat = bits + 11;
+    }
+    if (bits < 0)
+      return fail("Unexpected end of data");
+    if (num + repeat > hlit + hdist)
+      return fail("Invalid repeat");
+    memset(lengths + num, fill, repeat);
+    num += repeat;
+  }
+
+  if (lengths[256] == 0)
+    return fail("Missing end-of-block code");
+  if (!buildTree(_litTree, lengths, hlit) || !buildTree(_distTree, lengths + hlit, hdist))
+    return fail("Invalid Huffman tree");
+  return true;
+}
+
+int GzipInflateStream::decodeSymbol(const Tree &tree)
+{
+  int sum = 0;
+  int cur = 0;
+  int len = 0;
+  do
+  {
+    int bit = getBits(1);
+    if (bit < 0)
+      return -1;
+    cur = 2 * cur + bit;
+    if (++len == 16)
+      return -1;
+    sum += tree.counts[len];
+    cur -= tree.counts[len];
+  } while (cur >= 0);
+  return tree.symbols[sum + cur];
+}
+
+/**
+ * @brief 圧縮データを1バイト読む。受信待ちの時間は伸長時間から除外する
+ */
+bool GzipInflateStream::readSourceByte(uint8_t &b)
+{
+  unsigned long start = micros();
+  // readBytes()はStreamのタイムアウトまで受信を待つ
+  size_t n = _source.readBytes(&b, 1);
+  _waitMicros += micros() - start;
+  if (n != 1)
+    return false;
+  _stats.compressedBytes++;
+  return true;
+}
+
+int GzipInflateStream::getBits(uint8_t num)
+{
+  while (_bitCount < num)
+  {
+    uint8_t b;
+    if (!readSourceByte(b))
+      return -1;
+    _bitBuf |= (uint32_t)b << _bitCount;
+    _bitCount += 8;
+  }
+  int value = _bitBuf & ((1UL << num) - 1);
+  _bitBuf >>= num;
+  _bitCount -= num;
+  return value;
+}
+
+uint8_t GzipInflateStream::emit(uint8_t b)
+{
+  _window[_outTotal & _windowMask] = b;
+  _outTotal++;
+  _stats.decompressedBytes++;
+
+  // CRC32 (多項式 0xEDB88320) をテーブルなしで更新する
+  _crc ^= b;
+  for (uint8_t i = 0; i < 8; i++)
+    _crc = (_crc >> 1) ^ (0xEDB88320 & (0 - (_crc & 1)));
+  return b;
+}
+
+bool GzipInflateStream::fail(const char *message)
+{
+  if (_state != State::Failed)
+  {
+    _error = message;
+    _state = State::Failed;
+    _matchLength = 0;
+  }
+  return false;
+}
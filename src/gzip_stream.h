@@ -0,0 +1,93 @@
+#pragma once
+
+#include <Arduino.h>
+
+// 伸長処理の統計
+struct InflateStats
+{
+  uint32_t compressedBytes;   // 受信した圧縮データのバイト数 (gzipヘッダー・トレーラーを含む)
+  uint32_t decompressedBytes; // 伸長後のバイト数
+  uint32_t inflateMicros;     // 伸長処理に費やしたCPU時間 (受信待ちの時間を除く)
+};
+
+/**
+ * @brief gzip形式のデータを受信しながら逐次伸長するStream
+ *
+ * 圧縮データ全体・伸長データ全体をバッファに溜めず、1バイト単位で伸長結果を返すため、
+ * deserializeJson()などに直接渡すことができる。過去の出力を参照するためのスライド窓は
+ * 呼び出し側が用意する (2の累乗サイズ)。窓より遠い位置を参照するデータはエラーとなる。
+ */
+class GzipInflateStream : public Stream
+{
+public:
+  /**
+   * @param source 圧縮データの読み出し元 (WiFiClientなど)
+   * @param window スライド窓として使用するバッファ
+   * @param windowSize 窓のサイズ (2の累乗)
+   */
+  GzipInflateStream(Stream &source, uint8_t *window, size_t windowSize);
+
+  int available() override;
+  int read() override;
+  int peek() override;
+  size_t write(uint8_t) override { return 0; }
+
+  // 伸長が最後まで (CRC32・サイズの検証を含めて) 成功したか
+  bool finished() const { return _state == State::Done; }
+  // 伸長中にエラーが発生した場合のメッセージ (エラーがなければnullptr)
+  const char *error() const { return _error; }
+  const InflateStats &stats() const { return _stats; }
+
+private:
+  // ハフマン符号表 (符号長ごとの個数と、符号順に並べたシンボル)
+  struct Tree
+  {
+    uint16_t counts[16];
+    uint16_t symbols[288];
+  };
+
+  enum class State : uint8_t
+  {
+    Header,     // gzipヘッダー未読
+    BlockStart, // 次のブロックヘッダーを読む
+    Stored,     // 無圧縮ブロックの途中
+    Huffman,    // ハフマン符号化ブロックの途中
+    Done,       // 伸長完了
+    Failed      // エラー
+  };
+
+  int inflateNext();
+  bool readHeader();
+  bool readTrailer();
+  bool startBlock();
+  bool buildTree(Tree &tree, const uint8_t *lengths, uint16_t num);
+  bool decodeTrees();
+  int decodeSymbol(const Tree &tree);
+  bool readSourceByte(uint8_t &b);
+  int getBits(uint8_t num);
+  uint8_t emit(uint8_t b);
+  bool fail(const char *message);
+
+  Stream &_source;
+  uint8_t *_window;
+  size_t _windowMask;
+  uint32_t _outTotal = 0;
+  uint32_t _crc = 0xFFFFFFFF;
+
+  uint32_t _bitBuf = 0;
+  uint8_t _bitCount = 0;
+
+  State _state = State::Header;
+  bool _finalBlock = false;
+  uint16_t _storedRemaining = 0;
+  uint16_t _matchLength = 0;
+  uint16_t _matchDistance = 0;
+  int _peeked = -1;
+
+  Tree _litTree;
+  Tree _distTree;
+
+  const char *_error = nullptr;
+  uint32_t _waitMicros = 0;
+  InflateStats _stats = {0, 0, 0};
+};
@@ -0,0 +1,244 @@
+#include "history.h"
+
+// この時刻より前は、NTPの同期前 (起動からの秒数) とみなして記録しない (2020-01-01)
+#define HISTORY_MIN_EPOCH 1577836800UL
+#define HISTORY_TIERS 3
+
+// 集約中の区間 (下の階層の値を、区間が終わるまで合計しておく)
+struct Accumulator
+{
+  uint32_t slot;  // 区間の番号 (UNIX時刻 / 区間の長さ)
+  uint16_t count; // まとめた値の数
+  int32_t sum[HISTORY_CHANNELS];
+  int16_t min[HISTORY_CHANNELS];
+  int16_t max[HISTORY_CHANNELS];
+};
+
+// 1分ごとの階層は平均値のみを保持する
+struct MinuteSample
+{
+  int16_t value[HISTORY_CHANNELS];
+};
+
+// 10分・1時間ごとの階層
+struct Rollup
+{
+  HistoryStat stat[HISTORY_CHANNELS];
+};
+
+// 階層ごとのリングバッファの状態。区間slotの値は [slot % 容量] の位置に置く
+struct TierState
+{
+  uint32_t newest; // 最後に書き込んだ区間の番号
+  uint16_t count;  // 保持している区間の数 (容量以下)
+  Accumulator acc;
+};
+
+static MinuteSample minutes[HISTORY_MINUTE_SLOTS];
+static Rollup tenMinutes[HISTORY_TEN_MINUTE_SLOTS];
+static Rollup hours[HISTORY_HOUR_SLOTS];
+static TierState tiers[HISTORY_TIERS];
+
+static const uint16_t CAPACITY[HISTORY_TIERS] = {HISTORY_MINUTE_SLOTS, HISTORY_TEN_MINUTE_SLOTS, HISTORY_HOUR_SLOTS};
+static const uint32_t INTERVAL[HISTORY_TIERS] = {60, 600, 3600};
+static const char *const TIER_NAMES[HISTORY_TIERS] = {"1m", "10m", "1h"};
+
+static int16_t toFixed(float value)
+{
+  float scaled = value * HISTORY_SCALE;
+  if (scaled >= INT16_MAX)
+    return INT16_MAX;
+  if (scaled <= -INT16_MAX)
+    return -INT16_MAX; // INT16_MIN (HISTORY_NO_DATA) は使わない
+  return (int16_t)lroundf(scaled);
+}
+
+static Rollup *rollups(uint8_t tier)
+{
+  return tier == 1 ? tenMinutes : hours;
+}
+
+static void readSlot(uint8_t tier, size_t index, HistoryStat *stat)
+{
+  for (uint8_t c = 0; c < HISTORY_CHANNELS; c++)
+  {
+    if (tier == 0)
+    {
+      int16_t value = minutes[index].value[c];
+      stat[c] = {value, value, value};
+    }
+    else
+    {
+      stat[c] = rollups(tier)[index].stat[c];
+    }
+  }
+}
+
+static void writeSlot(uint8_t tier, size_t index, const HistoryStat *stat)
+{
+  for (uint8_t c = 0; c < HISTORY_CHANNELS; c++)
+  {
+    if (tier == 0)
+      minutes[index].value[c] = stat[c].avg;
+    else
+      rollups(tier)[index].stat[c] = stat[c];
+  }
+}
+
+/**
+ * @brief 区間slotを書き込む位置まで進める。飛ばした区間は「測定値なし」にする
+ * @return bool slotが最後に書き込んだ区間より新しければtrue (時刻が戻った場合はfalse)
+ */
+static bool advanceTo(uint8_t tier, uint32_t slot)
+{
+  TierState &state = tiers[tier];
+  uint16_t capacity = CAPACITY[tier];
+  if (state.count > 0 && slot <= state.newest)
+    return false;
+
+  uint32_t gap = state.count == 0 ? 1 : slot - state.newest;
+  const HistoryStat empty[HISTORY_CHANNELS] = {{HISTORY_NO_DATA, HISTORY_NO_DATA, HISTORY_NO_DATA},
+                                               {HISTORY_NO_DATA, HISTORY_NO_DATA, HISTORY_NO_DATA}};
+  for (uint32_t i = 1; i < gap && i < capacity; i++)
+    writeSlot(tier, (slot - i) % capacity, empty);
+
+  state.newest = slot;
+  state.count = min((uint32_t)capacity, state.count + gap);
+  return true;
+}
+
+static void accumulate(Accumulator &acc, uint32_t slot, const HistoryStat *stat)
+{
+  if (acc.count == 0)
+  {
+    acc.slot = slot;
+    for (uint8_t c = 0; c < HISTORY_CHANNELS; c++)
+    {
+      acc.sum[c] = 0;
+      acc.min[c] = stat[c].min;
+      acc.max[c] = stat[c].max;
+    }
+  }
+  for (uint8_t c = 0; c < HISTORY_CHANNELS; c++)
+  {
+    acc.sum[c] += stat[c].avg;
+    acc.min[c] = min(acc.min[c], stat[c].min);
+    acc.max[c] = max(acc.max[c], stat[c].max);
+  }
+  acc.count++;
+}
+
+/**
+ * @brief 集約中の区間を確定して階層に書き込み、その値を1つ上の階層に集約する
+ */
+static void closeSlot(uint8_t tier)
+{
+  Accumulator &acc = tiers[tier].acc;
+  if (acc.count == 0)
+    return;
+
+  HistoryStat stat[HISTORY_CHANNELS];
+  for (uint8_t c = 0; c < HISTORY_CHANNELS; c++)
+  {
+    int32_t half = acc.sum[c] >= 0 ? acc.count / 2 : -(int32_t)(acc.count / 2);
+    stat[c] = {acc.min[c], (int16_t)((acc.sum[c] + half) / (int32_t)acc.count), acc.max[c]};
+  }
+  uint32_t slot = acc.slot;
+  acc.count = 0;
+  if (!advanceTo(tier, slot))
+    return;
+  writeSlot(tier, slot % CAPACITY[tier], stat);
+
+  if (tier + 1 >= HISTORY_TIERS)
+    return;
+  uint8_t upper = tier + 1;
+  uint32_t upperSlot = slot * INTERVAL[tier] / INTERVAL[upper];
+  Accumulator &upperAcc = tiers[upper].acc;
+  if (upperAcc.count > 0 && upperAcc.slot != upperSlot)
+    closeSlot(upper);
+  accumulate(upperAcc, upperSlot, stat);
+  // 上の階層の区間の最後であれば、次の値を待たずに確定する
+  if ((slot + 1) * INTERVAL[tier] % INTERVAL[upper] == 0)
+    closeSlot(upper);
+}
+
+void historyAdd(uint32_t epoch, float temp, float hum)
+{
+  if (epoch < HISTORY_MIN_EPOCH)
+    return;
+
+  uint32_t slot = epoch / INTERVAL[0];
+  Accumulator &acc = tiers[0].acc;
+  if (acc.count > 0 && slot < acc.slot)
+    return; // 時刻が戻った (NTPによる補正など)
+  if (acc.count > 0 && slot != acc.slot)
+    closeSlot(0);
+
+  int16_t t = toFixed(temp);
+  int16_t h = toFixed(hum);
+  const HistoryStat sample[HISTORY_CHANNELS] = {{t, t, t}, {h, h, h}};
+  accumulate(acc, slot, sample);
+}
+
+uint32_t historyInterval(HistoryTier tier)
+{
+  return INTERVAL[(uint8_t)tier];
+}
+
+bool historyGet(HistoryTier tier, size_t age, HistoryRow &row)
+{
+  uint8_t t = (uint8_t)tier;
+  const TierState &state = tiers[t];
+  if (age >= state.count)
+    return false;
+
+  uint32_t slot = state.newest - age;
+  row.time = slot * INTERVAL[t];
+  readSlot(t, slot % CAPACITY[t], row.stat);
+  return row.stat[0].avg != HISTORY_NO_DATA;
+}
+
+size_t historyWriteJson(Print &out, HistoryTier tier, uint32_t from, uint32_t to)
+{
+  uint8_t t = (uint8_t)tier;
+  out.printf("{\"tier\":\"%s\",\"interval\":%lu,\"scale\":%d,\"rows\":[", TIER_NAMES[t], (unsigned long)INTERVAL[t],
+             HISTORY_SCALE);
+
+  size_t rows = 0;
+  HistoryRow row;
+  for (size_t age = tiers[t].count; age-- > 0;)
+  {
+    if (!historyGet(tier, age, row) || row.time < from || row.time > to)
+      continue;
+    out.printf(rows == 0 ? "[%lu" : ",[%lu", (unsigned long)row.time);
+    for (uint8_t c = 0; c < HISTORY_CHANNELS; c++)
+    {
+      if (tier == HistoryTier::Minute)
+        out.printf(",%d", row.stat[c].avg);
+      else
+        out.printf(",%d,%d,%d", row.stat[c].min, row.stat[c].avg, row.stat[c].max);
+    }
+    out.print(']');
+    rows++;
+  }
+  out.print("]}");
+  return rows;
+}
+
+const char *historyTierName(HistoryTier tier)
+{
+  return TIER_NAMES[(uint8_t)tier];
+}
+
+bool historyParseTier(const char *name, HistoryTier &tier)
+{
+  for (uint8_t t = 0; t < HISTORY_TIERS; t++)
+  {
+    if (strcmp(name, TIER_NAMES[t]) == 0)
+    {
+      tier = (HistoryTier)t;
+      return true;
+    }
+  }
+  return false;
+}
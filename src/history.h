@@ -0,0 +1,92 @@
+#pragma once
+
+#include <Arduino.h>
+
+// 各階層に保持する区間の数
+#define HISTORY_MINUTE_SLOTS 240     // 1分ごと: 4時間
+#define HISTORY_TEN_MINUTE_SLOTS 144 // 10分ごと: 24時間
+#define HISTORY_HOUR_SLOTS 168       // 1時間ごと: 7日
+
+// 値は0.01単位の固定小数点 (int16_t) で保持する
+#define HISTORY_SCALE 100
+// 測定値がない区間を表す値
+#define HISTORY_NO_DATA INT16_MIN
+
+// 履歴の階層
+enum class HistoryTier : uint8_t
+{
+  Minute,     // 1分ごとの平均値
+  TenMinutes, // 10分ごとの最小・平均・最大
+  Hour        // 1時間ごとの最小・平均・最大
+};
+
+// 記録する系列
+enum class HistoryChannel : uint8_t
+{
+  Temperature,
+  Humidity
+};
+#define HISTORY_CHANNELS 2
+
+// 1区間・1系列分の統計 (0.01単位)。1分ごとの階層ではmin/avg/maxはすべて平均値と同じ
+struct HistoryStat
+{
+  int16_t min;
+  int16_t avg;
+  int16_t max;
+};
+
+// 1区間分の履歴
+struct HistoryRow
+{
+  uint32_t time; // 区間の開始時刻 (UNIX時刻)
+  HistoryStat stat[HISTORY_CHANNELS];
+};
+
+/**
+ * @brief 測定値を記録する。1分ごとの平均値にまとめ、10分・1時間の区間が終わるたびに上の階層へ集約する
+ *
+ * 時刻が未同期 (NTPの同期前) の場合は記録しない。
+ * @param epoch 測定時刻 (UNIX時刻)
+ * @param temp 温度 (℃)
+ * @param hum 湿度 (%)
+ */
+void historyAdd(uint32_t epoch, float temp, float hum);
+
+/**
+ * @brief 区間の長さ (秒) を返す
+ */
+uint32_t historyInterval(HistoryTier tier);
+
+/**
+ * @brief 完了した区間のうち、新しい方から数えてage番目の区間を返す
+ * @param tier 階層
+ * @param age 0が最新の区間
+ * @param row 格納先
+ * @return bool 保持している範囲内で、かつ測定値があればtrue
+ */
+bool historyGet(HistoryTier tier, size_t age, HistoryRow &row);
+
+/**
+ * @brief 指定した期間の履歴をJSONで出力する (サーバーからの範囲取得用)
+ *
+ * {"tier":"10m","interval":600,"scale":100,"rows":[[時刻,温度min,avg,max,湿度min,avg,max],...]}
+ * 1分ごとの階層の行は [時刻,温度,湿度]。測定値がない区間は出力しない。
+ * @param out 出力先
+ * @param tier 階層
+ * @param from 期間の開始 (UNIX時刻, この時刻以降に始まる区間)
+ * @param to 期間の終了 (UNIX時刻, この時刻以前に始まる区間)
+ * @return size_t 出力した行数
+ */
+size_t historyWriteJson(Print &out, HistoryTier tier, uint32_t from, uint32_t to);
+
+/**
+ * @brief 階層の名前 ("1m" / "10m" / "1h") を返す
+ */
+const char *historyTierName(HistoryTier tier);
+
+/**
+ * @brief 名前から階層を求める
+ * @return bool 名前が正しければtrue
+ */
+bool historyParseTier(const char *name, HistoryTier &tier);
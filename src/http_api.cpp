@@ -0,0 +1,90 @@
+#include "http_api.h"
+#include "history.h"
+#include "remote_command.h"
+#include "log.h"
+#include <ESP8266WebServer.h>
+
+#define HTTP_API_PORT 80
+// 応答をこの大きさごとにまとめてチャンク転送する (バイト)
+#define RESPONSE_CHUNK_SIZE 256
+
+static ESP8266WebServer server(HTTP_API_PORT);
+
+// 書き込まれた内容をRESPONSE_CHUNK_SIZEごとにチャンク転送するPrint
+class ChunkedResponse : public Print
+{
+public:
+  size_t write(uint8_t c) override
+  {
+    _buffer[_length++] = c;
+    if (_length == sizeof(_buffer))
+      sendBuffered();
+    return 1;
+  }
+  void sendBuffered()
+  {
+    if (_length > 0)
+      server.sendContent(_buffer, _length);
+    _length = 0;
+  }
+
+private:
+  char _buffer[RESPONSE_CHUNK_SIZE];
+  size_t _length = 0;
+};
+
+static void sendError(int status, const char *message)
+{
+  char body[96];
+  snprintf(body, sizeof(body), "{\"error\":\"%s\"}", message);
+  server.send(status, "application/json", body);
+}
+
+static void handleHistory()
+{
+  HistoryTier tier = HistoryTier::TenMinutes;
+  if (server.hasArg("tier") && !historyParseTier(server.arg("tier").c_str(), tier))
+  {
+    sendError(400, "tier must be 1m, 10m or 1h");
+    return;
+  }
+  uint32_t from = server.hasArg("from") ? strtoul(server.arg("from").c_str(), nullptr, 10) : 0;
+  uint32_t to = server.hasArg("to") ? strtoul(server.arg("to").c_str(), nullptr, 10) : UINT32_MAX;
+
+  // 最大で7KB程度になるため、Stringに組み立てずにチャンク転送する
+  if (!server.chunkedResponseModeStart(200, "application/json"))
+  {
+    sendError(505, "HTTP/1.1 required");
+    return;
+  }
+  ChunkedResponse response;
+  size_t rows = historyWriteJson(response, tier, from, to);
+  response.sendBuffered();
+  server.chunkedResponseFinalize();
+  LOG_I(LogTag::Http, "GET /history tier=%s: %u rows", historyTierName(tier), (unsigned)rows);
+}
+
+// UDPと同じ形式のコマンドを本文で受け取る。実行はloop()のremoteCommandNext()で行う
+static void handleCommand()
+{
+  String body = server.arg("plain");
+  String reply;
+  bool accepted = remoteCommandSubmit(body.c_str(), body.length(), reply);
+  server.send(accepted ? 202 : 403, "text/plain", reply);
+  LOG_I(LogTag::Http, "POST /command: %s", reply.c_str());
+}
+
+void httpApiBegin()
+{
+  server.on("/history", HTTP_GET, handleHistory);
+  server.on("/command", HTTP_POST, handleCommand);
+  server.onNotFound([]()
+                    { sendError(404, "not found"); });
+  server.begin();
+  LOG_I(LogTag::Http, "HTTP API listening on port %u", HTTP_API_PORT);
+}
+
+void httpApiLoop()
+{
+  server.handleClient();
+}
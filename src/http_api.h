@@ -0,0 +1,19 @@
+#pragma once
+
+#include <Arduino.h>
+
+/**
+ * @brief LAN内からの問い合わせに応答するHTTPサーバーを開始する。WiFi接続後にsetup()から呼び出す
+ *
+ * GET /history?tier=1m|10m|1h&from=<UNIX時刻>&to=<UNIX時刻>
+ *   指定した階層・期間のセンサー値の履歴をJSONで返す (サーバー停止中の欠測の補完用)。
+ *   tierの既定値は10m、from/toを省略した場合は保持しているすべての区間を返す。
+ * POST /command
+ *   本文のコマンド (remote_command.hの形式) を検証し、受け付けた場合は202、拒否した場合は403を返す。
+ */
+void httpApiBegin();
+
+/**
+ * @brief 受信したリクエストを1件処理する。loop()から毎回呼び出す
+ */
+void httpApiLoop();
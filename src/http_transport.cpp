@@ -0,0 +1,217 @@
+#include "http_transport.h"
+#include "log.h"
+#include <ESP8266WiFi.h>
+#include <WiFiClientSecure.h>
+
+// 保持する接続の数 (POST先とYahoo!天気APIの2ホスト分)
+#define TRANSPORT_SLOTS 2
+
+// 接続先ホストごとの接続情報
+// HTTPClientはデストラクタで接続を閉じてしまうため、WiFiClientと一緒に保持し続ける
+struct TransportSlot
+{
+  char host[64];
+  uint16_t port;
+  bool secure;
+  WiFiClient *client; // https の場合は WiFiClientSecure
+  HTTPClient *http;
+  unsigned long lastUsed;
+};
+
+static TransportSlot slots[TRANSPORT_SLOTS];
+static TransportStats stats = {0, 0, 0};
+
+/**
+ * @brief URLからスキーム・ホスト・ポートを取り出す
+ * @return 対応していないスキームやホスト名が長すぎる場合はfalse
+ */
+static bool parseUrl(const char *url, bool &secure, char *host, size_t hostSize, uint16_t &port)
+{
+  const char *p;
+  if (strncmp(url, "https://", 8) == 0)
+  {
+    secure = true;
+    port = 443;
+    p = url + 8;
+  }
+  else if (strncmp(url, "http://", 7) == 0)
+  {
+    secure = false;
+    port = 80;
+    p = url + 7;
+  }
+  else
+  {
+    return false;
+  }
+
+  size_t len = strcspn(p, ":/?");
+  if (len == 0 || len >= hostSize)
+    return false;
+  memcpy(host, p, len);
+  host[len] = '\0';
+
+  if (p[len] == ':')
+    port = (uint16_t)atoi(p + len + 1);
+  return true;
+}
+
+/**
+ * @brief 接続先に対応するスロットを探す。無ければ最も長く使われていないスロットを入れ替える
+ */
+static TransportSlot *acquireSlot(const char *url)
+{
+  bool secure;
+  char host[sizeof(slots[0].host)];
+  uint16_t port;
+  if (!parseUrl(url, secure, host, sizeof(host), port))
+  {
+    LOG_E(LogTag::Http, "Unsupported URL: %s", url);
+    return nullptr;
+  }
+
+  TransportSlot *victim = &slots[0];
+  for (TransportSlot &slot : slots)
+  {
+    if (slot.client && slot.secure == secure && slot.port == port && strcmp(slot.host, host) == 0)
+      return &slot;
+    if (!slot.client)
+      victim = &slot; // 空きスロットを優先する
+    else if (victim->client && slot.lastUsed < victim->lastUsed)
+      victim = &slot;
+  }
+
+  // 入れ替えるスロットの接続を解放する
+  if (victim->client)
+  {
+    LOG_D(LogTag::Http, "Evicting connection to %s:%u", victim->host, victim->port);
+    delete victim->http;
+    victim->client->stop();
+    delete victim->client;
+    victim->http = nullptr;
+    victim->client = nullptr;
+  }
+
+  if (secure)
+  {
+    WiFiClientSecure *secureClient = new WiFiClientSecure;
+    if (!secureClient)
+      return nullptr;
+    secureClient->setInsecure(); // 証明書の検証をスキップ
+    victim->client = secureClient;
+  }
+  else
+  {
+    victim->client = new WiFiClient;
+  }
+  victim->http = new HTTPClient;
+  if (!victim->client || !victim->http)
+  {
+    delete victim->http;
+    delete victim->client;
+    victim->http = nullptr;
+    victim->client = nullptr;
+    return nullptr;
+  }
+
+  strcpy(victim->host, host);
+  victim->port = port;
+  victim->secure = secure;
+  return victim;
+}
+
+static TransportSlot *findSlot(HTTPClient *http)
+{
+  for (TransportSlot &slot : slots)
+  {
+    if (slot.http == http)
+      return &slot;
+  }
+  return nullptr;
+}
+
+HTTPClient *transportBegin(const char *url)
+{
+  TransportSlot *slot = acquireSlot(url);
+  if (!slot)
+    return nullptr;
+
+  slot->lastUsed = millis();
+  if (slot->client->connected())
+  {
+    stats.reused++;
+  }
+  else
+  {
+    // サーバー側で閉じられた接続はTLSバッファなどを解放してから張り直す
+    slot->client->stop();
+    stats.opened++;
+  }
+
+  slot->http->setReuse(true);
+  if (!slot->http->begin(*slot->client, url))
+    return nullptr;
+  return slot->http;
+}
+
+void transportEnd(HTTPClient *http)
+{
+  if (http)
+    http->end();
+}
+
+/**
+ * @brief 再利用した接続が切れていたことを示すエラーかどうか
+ */
+static bool isStaleConnectionError(int code)
+{
+  return code == HTTPC_ERROR_SEND_HEADER_FAILED ||
+         code == HTTPC_ERROR_SEND_PAYLOAD_FAILED ||
+         code == HTTPC_ERROR_CONNECTION_LOST ||
+         code == HTTPC_ERROR_NOT_CONNECTED;
+}
+
+int transportPost(const char *url, const char *contentType, const String &payload, String &response, String &error)
+{
+  int httpCode = 0;
+  // 1回目: 保持している接続を使う / 2回目: 接続が切れていた場合のみ張り直して再送
+  for (int attempt = 0; attempt < 2; attempt++)
+  {
+    HTTPClient *http = transportBegin(url);
+    if (!http)
+    {
+      error = "HTTP begin failed";
+      return HTTPC_ERROR_CONNECTION_FAILED;
+    }
+    bool reused = http->connected();
+
+    http->addHeader("Content-Type", contentType);
+    // User-Agentを一般的なブラウザに偽装して、サーバー側のブロックを回避する
+    http->setUserAgent("Mozilla/5.0 (Windows NT 10.0; Win64; x64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/108.0.0.0 Safari/537.36");
+
+    httpCode = http->POST(payload);
+    if (httpCode > 0)
+      response = http->getString();
+    error = http->errorToString(httpCode);
+
+    if (httpCode < 0 && reused && isStaleConnectionError(httpCode))
+    {
+      LOG_I(LogTag::Http, "Reused connection was closed (%d). Reconnecting...", httpCode);
+      TransportSlot *slot = findSlot(http);
+      http->end();
+      if (slot)
+        slot->client->stop();
+      stats.reconnects++;
+      continue;
+    }
+
+    transportEnd(http);
+    break;
+  }
+  return httpCode;
+}
+
+const TransportStats &transportStats()
+{
+  return stats;
+}
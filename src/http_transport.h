@@ -0,0 +1,43 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ESP8266HTTPClient.h>
+
+// 接続の再利用状況の統計
+struct TransportStats
+{
+  uint32_t reused;     // 既存のkeep-alive接続を再利用した回数
+  uint32_t opened;     // 新規に接続した回数
+  uint32_t reconnects; // 再利用した接続がサーバー側で切断されていたため張り直した回数
+};
+
+/**
+ * @brief URLのスキームに応じたクライアント (http: WiFiClient / https: WiFiClientSecure) で
+ *        HTTPClientを開始する。同一ホストへの接続は保持され、次回以降のリクエストで再利用される
+ * @param url リクエスト先のURL
+ * @return HTTPClient* 接続先ホスト用のHTTPClient (失敗時はnullptr)。使用後はtransportEnd()を呼ぶこと
+ */
+HTTPClient *transportBegin(const char *url);
+
+/**
+ * @brief transportBegin()で開始したリクエストを終了する。keep-alive可能な接続は閉じずに保持する
+ * @param http transportBegin()が返したHTTPClient
+ */
+void transportEnd(HTTPClient *http);
+
+/**
+ * @brief 保持している接続を再利用してPOSTする。再利用した接続がサーバー側で閉じられていた場合は、
+ *        接続を張り直して1回だけ再送する
+ * @param url リクエスト先のURL
+ * @param contentType Content-Typeヘッダーの値
+ * @param payload 送信するボディ
+ * @param response レスポンスボディの格納先
+ * @param error エラーメッセージの格納先
+ * @return int HTTPステータスコード (失敗時は負のHTTPClientエラーコード)
+ */
+int transportPost(const char *url, const char *contentType, const String &payload, String &response, String &error);
+
+/**
+ * @brief 接続の再利用状況を返す
+ */
+const TransportStats &transportStats();
@@ -0,0 +1,157 @@
+#include "log.h"
+
+// リングバッファのサイズ (バイト)
+#define LOG_BUFFER_SIZE 1024
+// 1行の最大長 (これを超える部分は切り捨てる)
+#define LOG_LINE_MAX 160
+
+// LOG_BINARYを定義すると、テキストの代わりに以下のコンパクトなバイナリ形式で出力する
+//   0x1E, (レベル << 4) | タグ, millis() (4バイト, リトルエンディアン), 本文の長さ (1バイト), 本文
+#ifdef LOG_BINARY
+#define LOG_FRAME_START 0x1E
+#endif
+
+static char ring[LOG_BUFFER_SIZE];
+static size_t ringHead = 0; // 次に書き込む位置
+static size_t ringTail = 0; // 次に送り出す位置
+static size_t ringUsed = 0;
+static uint32_t droppedLines = 0;
+
+#ifndef LOG_BINARY
+static const char LEVEL_CHARS[] = {'D', 'I', 'W', 'E'};
+static const char *const TAG_NAMES[] = {"main", "wifi", "wthr", "http", "tele", "disp", "sys", "ota"};
+#endif
+
+static bool ringPush(const char *data, size_t len)
+{
+  if (len > LOG_BUFFER_SIZE - ringUsed)
+    return false;
+  for (size_t i = 0; i < len; i++)
+  {
+    ring[ringHead] = data[i];
+    ringHead = (ringHead + 1) % LOG_BUFFER_SIZE;
+  }
+  ringUsed += len;
+  return true;
+}
+
+/**
+ * @brief 1行分をテキスト (またはバイナリ) 形式に整形する
+ * @return size_t 整形後のバイト数 (失敗時は0)
+ */
+static size_t formatLine(char *line, LogLevel level, LogTag tag, const char *format, va_list args)
+{
+  size_t prefix;
+#ifdef LOG_BINARY
+  uint32_t now = millis();
+  line[0] = LOG_FRAME_START;
+  line[1] = ((uint8_t)level << 4) | (uint8_t)tag;
+  memcpy(&line[2], &now, 4);
+  prefix = 7;
+#else
+  prefix = snprintf(line, LOG_LINE_MAX, "[%c][%-4s] ", LEVEL_CHARS[(uint8_t)level], TAG_NAMES[(uint8_t)tag]);
+#endif
+
+  int n = vsnprintf_P(line + prefix, LOG_LINE_MAX - prefix - 2, format, args);
+  if (n < 0)
+    return 0;
+  size_t len = prefix + min((size_t)n, LOG_LINE_MAX - prefix - 3);
+
+#ifdef LOG_BINARY
+  line[6] = len - prefix;
+#else
+  line[len++] = '\r';
+  line[len++] = '\n';
+#endif
+  return len;
+}
+
+static size_t formatLineF(char *line, LogLevel level, LogTag tag, const char *format, ...)
+{
+  va_list args;
+  va_start(args, format);
+  size_t len = formatLine(line, level, tag, format, args);
+  va_end(args);
+  return len;
+}
+
+/**
+ * @brief 1行分のデータを、行の途中で切れないようにまとめてリングバッファに入れる
+ */
+static void pushLine(const char *line, size_t len)
+{
+  // 破棄した行があれば、その件数の報告と今回の行の両方が入る空きができた時点で報告する
+  if (droppedLines > 0)
+  {
+    char notice[LOG_LINE_MAX];
+    size_t n = formatLineF(notice, LogLevel::Warn, LogTag::System, PSTR("%u log lines dropped"), droppedLines);
+    if (n + len > LOG_BUFFER_SIZE - ringUsed)
+    {
+      droppedLines++;
+      return;
+    }
+    ringPush(notice, n);
+    droppedLines = 0;
+  }
+  if (!ringPush(line, len))
+    droppedLines++;
+}
+
+static void logWriteV(LogLevel level, LogTag tag, const char *format, va_list args)
+{
+  char line[LOG_LINE_MAX];
+  size_t len = formatLine(line, level, tag, format, args);
+  if (len > 0)
+    pushLine(line, len);
+}
+
+void logWrite(LogLevel level, LogTag tag, const char *format, ...)
+{
+  va_list args;
+  va_start(args, format);
+  logWriteV(level, tag, format, args);
+  va_end(args);
+}
+
+bool logRateAllow(LogRateLimit &limit, uint32_t intervalMs, LogLevel level, LogTag tag)
+{
+  uint32_t now = millis();
+  if (limit.started && now - limit.lastMillis < intervalMs)
+  {
+    if (limit.suppressed < UINT16_MAX)
+      limit.suppressed++;
+    return false;
+  }
+
+  if (limit.suppressed > 0)
+    logWrite(level, tag, PSTR("(%u similar lines suppressed)"), limit.suppressed);
+  limit.started = true;
+  limit.lastMillis = now;
+  limit.suppressed = 0;
+  return true;
+}
+
+void logDrain()
+{
+  // 送信FIFOの空き容量だけ書き込み、UARTの送信完了を待たない
+  int room = Serial.availableForWrite();
+  while (room > 0 && ringUsed > 0)
+  {
+    size_t chunk = min((size_t)room, ringUsed);
+    chunk = min(chunk, LOG_BUFFER_SIZE - ringTail); // リングの末尾で折り返さない範囲
+    Serial.write((const uint8_t *)&ring[ringTail], chunk);
+    ringTail = (ringTail + chunk) % LOG_BUFFER_SIZE;
+    ringUsed -= chunk;
+    room -= chunk;
+  }
+}
+
+void logFlush()
+{
+  while (ringUsed > 0)
+  {
+    logDrain();
+    yield();
+  }
+  Serial.flush();
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <Arduino.h>
+
+// --- ログレベル ---
+// ビルドフラグ (-D LOG_LEVEL=LOG_LEVEL_DEBUG など) で指定したレベル未満のログは、コンパイル時に取り除かれる
+#define LOG_LEVEL_DEBUG 0
+#define LOG_LEVEL_INFO 1
+#define LOG_LEVEL_WARN 2
+#define LOG_LEVEL_ERROR 3
+#define LOG_LEVEL_NONE 4
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_INFO
+#endif
+
+enum class LogLevel : uint8_t
+{
+  Debug = LOG_LEVEL_DEBUG,
+  Info = LOG_LEVEL_INFO,
+  Warn = LOG_LEVEL_WARN,
+  Error = LOG_LEVEL_ERROR
+};
+
+// ログの出力元モジュール (4ビットに収まること)
+enum class LogTag : uint8_t
+{
+  Main,
+  WiFi,
+  Weather,
+  Http,
+  Telemetry,
+  Display,
+  System,
+  Ota
+};
+
+constexpr bool logEnabled(LogLevel level)
+{
+  return (uint8_t)level >= LOG_LEVEL;
+}
+
+// 繰り返し出力されるログの間引き状態 (LOG_EVERY()の呼び出し箇所ごとに1つ)
+struct LogRateLimit
+{
+  uint32_t lastMillis;
+  uint16_t suppressed;
+  bool started;
+};
+
+/**
+ * @brief ログを1行、RAM上のリングバッファに書き込む。バッファが一杯の場合は破棄し、UARTの送信待ちでブロックしない
+ * @param level ログレベル
+ * @param tag 出力元モジュール
+ * @param format PROGMEM上の書式文字列 (PSTR())
+ */
+void logWrite(LogLevel level, LogTag tag, const char *format, ...) __attribute__((format(printf, 3, 4)));
+
+/**
+ * @brief 前回の出力から指定時間が経過していれば出力を許可する。間引いた件数は次の出力時に報告する
+ */
+bool logRateAllow(LogRateLimit &limit, uint32_t intervalMs, LogLevel level, LogTag tag);
+
+/**
+ * @brief リングバッファの内容を、UARTの送信FIFOに空きがある分だけ送り出す。loop()から毎回呼び出す
+ */
+void logDrain();
+
+/**
+ * @brief リングバッファの内容をすべて送り出すまで待つ (起動処理中や再起動の直前に使用する)
+ */
+void logFlush();
+
+#define LOG_AT(level, tag, format, ...)                           \
+  do                                                              \
+  {                                                               \
+    if constexpr (logEnabled(level))                              \
+      logWrite(level, tag, PSTR(format), ##__VA_ARGS__);          \
+  } while (0)
+
+#define LOG_D(tag, format, ...) LOG_AT(LogLevel::Debug, tag, format, ##__VA_ARGS__)
+#define LOG_I(tag, format, ...) LOG_AT(LogLevel::Info, tag, format, ##__VA_ARGS__)
+#define LOG_W(tag, format, ...) LOG_AT(LogLevel::Warn, tag, format, ##__VA_ARGS__)
+#define LOG_E(tag, format, ...) LOG_AT(LogLevel::Error, tag, format, ##__VA_ARGS__)
+
+// 同じ箇所のログを intervalMs に1回までに間引いて出力する
+#define LOG_EVERY(intervalMs, level, tag, format, ...)                   \
+  do                                                                     \
+  {                                                                      \
+    if constexpr (logEnabled(level))                                     \
+    {                                                                    \
+      static LogRateLimit logRateLimit_ = {0, 0, false};                 \
+      if (logRateAllow(logRateLimit_, intervalMs, level, tag))           \
+        logWrite(level, tag, PSTR(format), ##__VA_ARGS__);               \
+    }                                                                    \
+  } while (0)
@@ -0,0 +1,178 @@
+#include "loop_monitor.h"
+#include "log.h"
+#include <Ticker.h>
+
+// ヒストグラムのバケット数。バケットiには [2^i, 2^(i+1)) µs の反復を数える (最後のバケットはそれ以上すべて)
+#define HISTOGRAM_BUCKETS 24
+// 区間ごとの統計を保持する最大数
+#define MAX_SITES 16
+// この時間を超えた区間を「遅い区間」として数える (µs)
+#define SLOW_SEGMENT_MICROS 50000
+// ソフトウェアWDT (約3.2秒) が近かったとして警告する、yieldなしの経過時間 (ms)
+#define SOFT_WDT_WARN_MS 1500
+// yieldの時刻を記録するTickerの周期 (ms)
+#define YIELD_TICK_MS 100
+
+struct SiteStats
+{
+  const char *site;
+  uint32_t maxMicros;  // この区間の最長時間
+  uint32_t slowCount;  // SLOW_SEGMENT_MICROSを超えた回数
+};
+
+static uint32_t histogram[HISTOGRAM_BUCKETS];
+static SiteStats sites[MAX_SITES];
+static uint8_t siteCount = 0;
+
+static uint32_t iterationStart = 0;
+static uint32_t iterationCount = 0;
+static uint32_t maxIterationMicros = 0;
+static const char *maxIterationSite = nullptr; // 最長の反復で最も時間を使った区間
+
+static const char *currentSite = nullptr;
+static uint32_t segmentStart = 0;
+static const char *iterationWorstSite = nullptr;
+static uint32_t iterationWorstMicros = 0;
+
+// Tickerのコールバックは、スケッチがSDKに制御を返したとき (yield・delay・loop()の終了、
+// ライブラリ内部での通信の待ちなど) にだけ実行されるため、最後に実行された時刻を最後のyieldとみなす
+static Ticker yieldTicker;
+static volatile uint32_t lastYieldMillis = 0;
+static volatile bool watchdogWarned = false;
+
+static SiteStats *findSite(const char *site)
+{
+  for (uint8_t i = 0; i < siteCount; i++)
+  {
+    if (sites[i].site == site)
+      return &sites[i];
+  }
+  if (siteCount >= MAX_SITES)
+    return nullptr;
+  sites[siteCount] = {site, 0, 0};
+  return &sites[siteCount++];
+}
+
+static void markYield()
+{
+  lastYieldMillis = millis();
+  watchdogWarned = false;
+}
+
+/**
+ * @brief 直前のyieldからの経過時間を確認し、ソフトウェアWDTが近かった場合は警告する。
+ *        警告はyieldなしの区間が終わった後 (次の区間の開始時など) に出る
+ */
+static void checkWatchdog(uint32_t nowMillis)
+{
+  // 初回の呼び出しでTickerを開始する
+  if (!yieldTicker.active())
+  {
+    markYield();
+    yieldTicker.attach_ms(YIELD_TICK_MS, markYield);
+    return;
+  }
+  uint32_t sinceYield = nowMillis - lastYieldMillis;
+  if (sinceYield > SOFT_WDT_WARN_MS && !watchdogWarned)
+  {
+    LOG_W(LogTag::System, "No yield for %u ms (at %s). Soft WDT fires at ~3200 ms.",
+          sinceYield, currentSite ? currentSite : "?");
+    watchdogWarned = true;
+  }
+}
+
+/**
+ * @brief 現在の区間を閉じ、その時間を区間の統計に加える
+ */
+static void closeSegment(uint32_t now)
+{
+  if (!currentSite)
+    return;
+
+  uint32_t elapsed = now - segmentStart;
+  SiteStats *stats = findSite(currentSite);
+  if (stats)
+  {
+    if (elapsed > stats->maxMicros)
+      stats->maxMicros = elapsed;
+    if (elapsed > SLOW_SEGMENT_MICROS)
+      stats->slowCount++;
+  }
+  if (elapsed > iterationWorstMicros)
+  {
+    iterationWorstMicros = elapsed;
+    iterationWorstSite = currentSite;
+  }
+}
+
+void loopMonitorBeginIteration()
+{
+  uint32_t now = micros();
+  closeSegment(now);
+
+  if (iterationCount > 0)
+  {
+    uint32_t elapsed = now - iterationStart;
+    uint8_t bucket = elapsed ? 31 - __builtin_clz(elapsed) : 0;
+    if (bucket >= HISTOGRAM_BUCKETS)
+      bucket = HISTOGRAM_BUCKETS - 1;
+    histogram[bucket]++;
+
+    if (elapsed > maxIterationMicros)
+    {
+      maxIterationMicros = elapsed;
+      maxIterationSite = iterationWorstSite;
+    }
+  }
+
+  iterationCount++;
+  iterationStart = now;
+  iterationWorstSite = nullptr;
+  iterationWorstMicros = 0;
+  currentSite = nullptr;
+  checkWatchdog(millis());
+}
+
+void loopMonitorSite(const char *site)
+{
+  uint32_t now = micros();
+  closeSegment(now);
+  checkWatchdog(millis());
+  currentSite = site;
+  segmentStart = now;
+}
+
+void loopMonitorYield()
+{
+  checkWatchdog(millis());
+  yield();
+}
+
+void loopMonitorDelay(unsigned long ms)
+{
+  checkWatchdog(millis());
+  delay(ms);
+}
+
+void loopMonitorDump(Print &out)
+{
+  out.printf("--- Loop latency (%u iterations, max %u us at %s) ---\n",
+             iterationCount, maxIterationMicros, maxIterationSite ? maxIterationSite : "-");
+  for (uint8_t i = 0; i < HISTOGRAM_BUCKETS; i++)
+  {
+    if (histogram[i] == 0)
+      continue;
+    if (i == HISTOGRAM_BUCKETS - 1)
+      out.printf("  >= %8lu us: %u\n", 1UL << i, histogram[i]);
+    else
+      out.printf("  < %9lu us: %u\n", 1UL << (i + 1), histogram[i]);
+  }
+
+  out.println(F("--- Worst segments by site ---"));
+  for (uint8_t i = 0; i < siteCount; i++)
+  {
+    out.printf("  %-14s max %8u us, >%u ms: %u\n",
+               sites[i].site, sites[i].maxMicros, SLOW_SEGMENT_MICROS / 1000, sites[i].slowCount);
+  }
+  out.println(F("------------------------------"));
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <Arduino.h>
+
+// yieldなしの経過時間は、最初にいずれかの関数が呼ばれたときに開始するTickerで測る
+
+/**
+ * @brief loop()の先頭で呼び出す。前回の反復にかかった時間をヒストグラムに記録する
+ */
+void loopMonitorBeginIteration();
+
+/**
+ * @brief ここから始まる区間の名前を記録する。直前の区間にかかった時間は直前の名前に帰属させる
+ * @param site 区間の名前 (文字列リテラルを渡すこと。ポインタで区別する)
+ */
+void loopMonitorSite(const char *site);
+
+/**
+ * @brief yieldなしの経過時間を確認してからyield()を呼び出す。長時間の待ち処理ではyield()の代わりに使う
+ */
+void loopMonitorYield();
+
+/**
+ * @brief yieldなしの経過時間を確認してからdelay()を呼び出す (delay()は内部でyieldする)
+ * @param ms 待ち時間 (ミリ秒)
+ */
+void loopMonitorDelay(unsigned long ms);
+
+/**
+ * @brief ヒストグラムと区間ごとの最悪値を出力する
+ * @param out 出力先 (Serialなど)
+ */
+void loopMonitorDump(Print &out);
@@ -12,6 +12,16 @@
 #include "wol.h"          // WoL送信関数
 #include "weather.h"      // 天気情報取得関数
 #include "wifi_handler.h" // WiFi接続ハンドラ
+#include "telemetry.h"    // MQTT / UDPによるセンサーデータ送信
+#include "http_transport.h" // keep-alive接続を再利用するHTTP通信
+#include "display_flush.h"  // フレームバッファの分割転送
+#include "crash_log.h"      // リセット要因の記録
+#include "loop_monitor.h"   // ループ処理時間の計測
+#include "log.h"            // レベル付きのバッファリングされたログ
+#include "history.h"        // センサー値の履歴
+#include "http_api.h"       // 履歴を取得するためのHTTPサーバー
+#include "remote_command.h" // LAN内からのコマンド
+#include "ota_update.h"     // ファームウェアのOTA更新
 
 // --- 静的IPアドレスの設定 ---
 // ご自身のネットワーク環境に合わせて変更してください
@@ -36,11 +46,14 @@ IPAddress secondaryDNS(8, 8, 4, 4);    // (オプション) セカンダリDNS
 // I2Cピンの定義 (OLEDディスプレイ用)
 #define I2C_SDA 4  // D2
 #define I2C_SCL 14 // D5
+// I2Cクロック (Hz)。SSD1306は400kHz (Fast mode) まで保証されており、多くの個体はそれ以上でも動作する
+#define I2C_CLOCK 400000
 
 // OLEDディスプレイの定義
 #define SCREEN_WIDTH 128 // OLEDの幅 (ピクセル)
 #define SCREEN_HEIGHT 64 // OLEDの高さ (ピクセル)
 #define OLED_RESET -1    // リセットピン (-1はArduinoのリセットピンを共有)
+#define OLED_ADDRESS 0x3C
 
 // NTPサーバーとタイムゾーンの設定 (JST: 日本標準時)
 const char *ntpServer = "pool.ntp.org";
@@ -58,12 +71,22 @@ bool longPressHandled = false;
 
 bool isDisplayOn = true; // 画面の表示状態を管理
 
+// WoL送信後に "Sending WoL..." を表示する時間 (ms)。表示中もループは止めない
+const long wolMessageDuration = 2000;
+unsigned long wolMessageStart = 0;
+bool isWolMessageShown = false;
+
 // --- データPOST関連の設定 ---
 const int ROOM_ID = 13; // 部屋のID (定数)
 unsigned long lastPostTime = 0;
 // 10分 (ミリ秒)
 const long postInterval = 10 * 60 * 1000;
 
+// --- テレメトリ送信方式の設定 ---
+// Http: POST_URLへJSONをPOST / Mqtt: ブローカーへPublish / Udp: InfluxDBライン形式で送信
+const TelemetryTransport TELEMETRY_TRANSPORT = TelemetryTransport::Http;
+IPAddress telemetryHost(192, 168, 223, 10); // MQTTブローカー / UDPコレクターのIPアドレス
+
 // POST結果表示用の変数
 int lastPostResult = 0;          // 0:未実行, >0:HTTPコード, <0:クライアントエラー
 String lastPostErrorString = ""; // POST失敗時の詳細エラーメッセージ
@@ -73,7 +96,8 @@ const long postResultDisplayDuration = 5000; // 5秒間表示
 // DHTセンサーのオブジェクトを作成
 DHT dht(DHTPIN, DHTTYPE);
 // OLEDディスプレイのオブジェクトを作成
-Adafruit_SSD1306 display(SCREEN_WIDTH, SCREEN_HEIGHT, &Wire, OLED_RESET);
+// 転送中・転送後ともにI2C_CLOCKを使用する (ライブラリ既定では転送後に100kHzへ戻される)
+Adafruit_SSD1306 display(SCREEN_WIDTH, SCREEN_HEIGHT, &Wire, OLED_RESET, I2C_CLOCK, I2C_CLOCK);
 
 // 天気情報更新用の変数
 unsigned long lastWeatherCheck = 0;
@@ -87,6 +111,28 @@ float rainAmount = 0.0;
 unsigned long lastLoopTime = 0;
 const long loopInterval = 1000;    // 1秒
 bool rainWarningBlinkState = true; // 1秒ごとのループで状態を反転させる
+// 複数地点の雨雲情報を表示する場合、下段の地点をこの秒数ごとに切り替える
+#define RAIN_LOCATION_ROTATE_SEC 4
+size_t rainLocationIndex = 0; // 下段に表示中の地点
+uint8_t rainLocationTicks = 0;
+// 履歴 (スパークライン) のページを、HISTORY_PAGE_PERIOD_SEC秒ごとにHISTORY_PAGE_SEC秒間表示する
+#define HISTORY_PAGE_PERIOD_SEC 30
+#define HISTORY_PAGE_SEC 5
+// スパークラインの幅 (ピクセル)。1ピクセルが10分ごとの履歴の1区間 (96ピクセルで16時間分)
+#define SPARKLINE_WIDTH 96
+uint8_t historyPageTicks = 0;
+
+// DNS障害からの最終回復処理: メッセージを表示してシステムを再起動する
+void restartOnDnsFailure()
+{
+  LOG_E(LogTag::Main, "--- Unrecoverable DNS Failure Detected. Restarting system... ---");
+  logFlush();
+  display.clearDisplay();
+  display.println("DNS Failed.\nRestarting...");
+  display.display();
+  loopMonitorDelay(3000); // メッセージを3秒間表示
+  ESP.restart();
+}
 
 void setup()
 {
@@ -101,17 +147,24 @@ void setup()
   pinMode(SWITCH_PIN, INPUT_PULLUP);
   pinMode(FLASH_BUTTON_PIN, INPUT_PULLUP);
 
-  Serial.println(F("Booting..."));
+  LOG_I(LogTag::Main, "Booting... (firmware %s)", FIRMWARE_VERSION);
+
+  // 前回のリセット要因をフラッシュのリングログに記録し、直近の記録を表示する
+  crashLogBegin();
+  logFlush();
+  crashLogDump(Serial, 3);
 
   // I2C通信とOLEDディスプレイを先に初期化
   Wire.begin(I2C_SDA, I2C_SCL);
-  if (!display.begin(SSD1306_SWITCHCAPVCC, 0x3C))
+  if (!display.begin(SSD1306_SWITCHCAPVCC, OLED_ADDRESS))
   {
-    Serial.println(F("SSD1306 allocation failed"));
+    LOG_E(LogTag::Display, "SSD1306 allocation failed");
+    logFlush();
     for (;;)
       ; // 失敗した場合は無限ループ
   }
-  Serial.println(F("SSD1306 Initialized."));
+  LOG_I(LogTag::Display, "SSD1306 Initialized.");
+  displayFlushBegin(&display, OLED_ADDRESS, I2C_CLOCK);
 
   // 起動メッセージをOLEDに表示
   display.clearDisplay();
@@ -123,15 +176,18 @@ void setup()
 
   // Wi-Fiに接続
   ensureWiFiConnected(&display);
-  Serial.println(" Connected!");
-  Serial.print("IP address: ");
-  Serial.println(WiFi.localIP());
+  LOG_I(LogTag::WiFi, "Connected! IP address: %s", WiFi.localIP().toString().c_str());
+  logFlush(); // 起動処理中はloop()が回らないため、ここで送り出す
 
   // NTPによる時刻同期を開始
   configTime(gmtOffset_sec, daylightOffset_sec, ntpServer);
 
+  // 履歴を取得するためのHTTPサーバーと、LAN内からのコマンドの受け付けを開始
+  httpApiBegin();
+  remoteCommandBegin();
+
   // 起動時に天気情報を取得
-  Serial.println("\nChecking for rain clouds at startup...");
+  LOG_I(LogTag::Weather, "Checking for rain clouds at startup...");
   display.clearDisplay();
   display.setTextSize(1);
   display.setCursor(0, 28);
@@ -140,21 +196,14 @@ void setup()
 
   if (ensureWiFiConnected(&display))
   {
+    crashLogSetSubsystem(Subsystem::WeatherFetch);
     RainInfo rainInfo = checkRainCloud();
     isRainingSoon = rainInfo.willRain;
     rainTime = rainInfo.minutesUntilRain;
     rainAmount = rainInfo.rainfall;
     lastWeatherCheck = millis(); // 次の定期チェックタイマーをリセット
-    // DNS障害からの最終回復処理: システムを再起動する
     if (rainInfo.statusMessage == "DNS lookup failed")
-    {
-      Serial.println("\n--- Unrecoverable DNS Failure Detected. Restarting system... ---");
-      display.clearDisplay();
-      display.println("DNS Failed.\nRestarting...");
-      display.display();
-      delay(3000); // メッセージを3秒間表示
-      ESP.restart();
-    }
+      restartOnDnsFailure();
     delay(1000); // メッセージを少し表示
   }
 
@@ -164,12 +213,57 @@ void setup()
   // 起動時に画面をクリア
   display.clearDisplay();
   display.display();
-  Serial.println("---------------------------------");
+  displayFlushInvalidate(); // 以降の描画は分割転送で行う
+  crashLogSetSubsystem(Subsystem::Idle);
+  LOG_I(LogTag::Main, "---------------------------------");
+  logFlush();
+}
+
+// 複数地点の雨雲情報を、地点名とともに下段の2行に描画する関数
+void drawRainLocation()
+{
+  const WeatherLocation &location = weatherLocation(rainLocationIndex);
+  const RainTimeline &timeline = weatherTimeline(rainLocationIndex);
+  RainInfo info = summarizeRainTimeline(timeline);
+
+  display.setTextSize(1);
+  display.setTextColor(SSD1306_WHITE);
+  display.setCursor(0, 48);
+  display.printf("%s (%u/%u)", location.label, (unsigned)(rainLocationIndex + 1), (unsigned)weatherLocationCount());
+
+  display.setCursor(0, 56);
+  if (timeline.steps == 0)
+  {
+    display.print("No forecast data");
+  }
+  else if (info.willRain)
+  {
+    // 点滅状態がtrueのときだけ、反転表示で強調して描画する
+    if (rainWarningBlinkState)
+    {
+      display.setTextColor(SSD1306_BLACK, SSD1306_WHITE);
+      if (info.minutesUntilRain == 0)
+        display.printf("Rain now %.1fmm", info.rainfall);
+      else
+        display.printf("Rain in %dmin %.1fmm", info.minutesUntilRain, info.rainfall);
+    }
+  }
+  else
+  {
+    display.print("No rain for 1 hour");
+  }
 }
 
 // 雨雲接近の通知を描画する関数
 void drawRainWarning()
 {
+  // 複数地点を設定している場合は、地点を切り替えながら表示する
+  if (weatherLocationCount() > 1)
+  {
+    drawRainLocation();
+    return;
+  }
+
   // isRainingSoonフラグに応じて文字色を切り替える
   if (isRainingSoon) // 雨が降る/降っている場合
   {
@@ -201,80 +295,366 @@ void drawRainWarning()
   }
 }
 
-// センサーデータをサーバーにPOSTする関数
-int postSensorData(float temp, float hum)
+// 10分ごとの履歴の平均値を、縦軸を最小値〜最大値に合わせた折れ線で描画する関数
+void drawSparkline(int16_t y, int16_t height, HistoryChannel channel, const char *label)
 {
-  int httpResponseCode = 0;
-  if (ensureWiFiConnected(&display))
+  int16_t values[SPARKLINE_WIDTH];
+  int16_t low = INT16_MAX, high = INT16_MIN;
+  HistoryRow row;
+  for (int16_t i = 0; i < SPARKLINE_WIDTH; i++)
   {
-    // 接続が確認できたので処理を続行
-    // WiFiClientSecureはスコープを抜けるときに自動的にリソースを解放します
-    std::unique_ptr<WiFiClientSecure> client(new WiFiClientSecure);
+    // 右端が最新の区間
+    if (historyGet(HistoryTier::TenMinutes, SPARKLINE_WIDTH - 1 - i, row))
+    {
+      values[i] = row.stat[(uint8_t)channel].avg;
+      low = min(low, values[i]);
+      high = max(high, values[i]);
+    }
+    else
+    {
+      values[i] = HISTORY_NO_DATA;
+    }
+  }
+  // 変化が小さいときに細かな揺れを強調しないよう、縦軸は最低でも1.0 (℃ / %) の幅にする
+  if (high - low < HISTORY_SCALE)
+    high = low + HISTORY_SCALE;
 
-    if (!client)
+  // 左側に最大値・系列名・最小値を表示する
+  display.setTextSize(1);
+  display.setCursor(0, y);
+  display.print(high / (float)HISTORY_SCALE, 1);
+  display.setCursor(0, y + height / 2 - 4);
+  display.print(label);
+  display.setCursor(0, y + height - 8);
+  display.print(low / (float)HISTORY_SCALE, 1);
+
+  int16_t x0 = SCREEN_WIDTH - SPARKLINE_WIDTH;
+  int16_t previousY = -1;
+  for (int16_t i = 0; i < SPARKLINE_WIDTH; i++)
+  {
+    if (values[i] == HISTORY_NO_DATA)
     {
-      lastPostErrorString = "Out of memory";
-      Serial.println(lastPostErrorString);
-      return -100; // メモリ不足を示す独自のエラーコード
+      previousY = -1;
+      continue;
     }
+    int16_t py = y + height - 1 - (int32_t)(values[i] - low) * (height - 1) / (high - low);
+    if (previousY < 0)
+      display.drawPixel(x0 + i, py, SSD1306_WHITE);
+    else
+      display.drawLine(x0 + i - 1, previousY, x0 + i, py, SSD1306_WHITE);
+    previousY = py;
+  }
+}
 
-    client->setInsecure(); // 証明書の検証をスキップ
+// 履歴のページ (時刻と、直近16時間の温度・湿度のスパークライン) を描画する関数
+// @return 10分ごとの履歴がまだない場合は何も描画せずfalseを返す
+bool drawHistoryPage(const char *timeStr)
+{
+  HistoryRow row;
+  if (!historyGet(HistoryTier::TenMinutes, 0, row))
+    return false;
 
-    HTTPClient http;
+  display.setTextSize(1);
+  display.setCursor(0, 0);
+  display.print(timeStr);
+  display.setCursor(SCREEN_WIDTH - SPARKLINE_WIDTH + 28, 0);
+  display.print("16h trend");
+
+  drawSparkline(10, 26, HistoryChannel::Temperature, "C");
+  drawSparkline(38, 26, HistoryChannel::Humidity, "%");
+  return true;
+}
 
-    // JSONドキュメントを作成
-    // ArduinoJson v7以降では、サイズ指定のないJsonDocumentを使用します
-    JsonDocument doc;
-    doc["room"] = ROOM_ID;
-    doc["temp"] = temp;
-    doc["hum"] = hum;
-    doc["atm"] = nullptr; // atmはnull固定
+// WoL送信中のページ (時刻と送信中メッセージ) を描画する関数
+void drawWolPage(const char *timeStr)
+{
+  display.setTextSize(2);
+  display.setCursor(12, 0);
+  display.println(timeStr);
+  display.setCursor(0, 24);
+  display.println(F("Sending"));
+  display.println(F("  WoL..."));
+}
 
-    String jsonPayload;
-    serializeJson(doc, jsonPayload);
+// POSTの結果、または次のPOSTまでのカウントダウンを描画する関数
+void drawPostStatus(int remainingMinutes, int remainingSeconds, unsigned long currentMillis)
+{
+  // POST結果の表示ロジック
+  bool lastPostFailed = (lastPostResult <= 0 && lastPostResult != 0);
+  bool showSuccessMessage = (lastPostResult > 0 && currentMillis - postResultDisplayStart < postResultDisplayDuration);
 
-    Serial.println("Posting sensor data...");
-    Serial.println(jsonPayload);
+  if (showSuccessMessage)
+  {
+    // 成功時は5秒間だけ結果を表示
+    if (TELEMETRY_TRANSPORT == TelemetryTransport::Http)
+      display.printf("POST OK (%d)", lastPostResult);
+    else
+      display.printf("%s OK", telemetryTransportName(TELEMETRY_TRANSPORT));
+  }
+  else if (lastPostFailed)
+  {
+    // 失敗時は、カウントダウンの横に失敗コードを表示し続ける
+    // エラーメッセージが長い場合があるので、先頭から一部だけ表示
+    char errorSnippet[15];
+    strncpy(errorSnippet, lastPostErrorString.c_str(), sizeof(errorSnippet) - 1);
 
-    // --- 通信直前のシステム状態をログ出力 ---
-    Serial.printf("[Pre-POST] Free Heap: %u bytes, WiFi Status: %d, RSSI: %d dBm\n", ESP.getFreeHeap(), WiFi.status(), WiFi.RSSI());
+    // DNSエラーの場合は特別に表示
+    if (lastPostErrorString.indexOf("DNS") != -1)
+    {
+      strncpy(errorSnippet, "DNS Failed", sizeof(errorSnippet) - 1);
+    }
 
-    // HTTP POSTリクエストを開始
-    http.begin(*client, POST_URL);
-    http.addHeader("Content-Type", "application/json");
-    // User-Agentを一般的なブラウザに偽装して、サーバー側のブロックを回避する
-    http.setUserAgent("Mozilla/5.0 (Windows NT 10.0; Win64; x64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/108.0.0.0 Safari/537.36");
+    errorSnippet[sizeof(errorSnippet) - 1] = '\0';
 
-    httpResponseCode = http.POST(jsonPayload);
+    display.printf("Post in: %02d:%02d (%s)", remainingMinutes, remainingSeconds, errorSnippet);
+  }
+  else
+  {
+    // 通常時はカウントダウンのみ表示
+    display.printf("Post in: %02d:%02d", remainingMinutes, remainingSeconds);
+  }
+}
 
-    if (httpResponseCode > 0)
-    {
-      String response = http.getString();
-      Serial.print("HTTP Response code: ");
-      Serial.println(httpResponseCode);
-      Serial.println(response);
-    }
-    else
-    {
-      Serial.print("Error on sending POST: ");
-      Serial.println(httpResponseCode);
-    }
-    // エラーコードを文字列に変換
-    lastPostErrorString = http.errorToString(httpResponseCode);
-    // シリアルモニターにも詳細なエラーメッセージを出力
-    Serial.printf("[HTTP] POST... failed, error: %s\n", lastPostErrorString.c_str());
+// 通常のページ (時刻・POSTの状態・温湿度・雨雲情報) を描画する関数
+void drawMainPage(const char *timeStr, float temperature, float humidity, unsigned long currentMillis)
+{
+  display.setTextSize(2);
+  display.setCursor(12, 0);
+  display.println(timeStr);
+
+  unsigned long remainingMillis = postInterval - (currentMillis - lastPostTime);
+  if (remainingMillis > postInterval)
+    remainingMillis = postInterval;
+  int remainingMinutes = remainingMillis / 1000 / 60;
+  int remainingSeconds = (remainingMillis / 1000) % 60;
+  display.setTextSize(1);
+  display.setCursor(0, 18);
 
-    http.end();
+  // ファームウェアの更新中は、POSTの状態の代わりに進捗を表示する
+  if (otaState() == OtaState::Downloading)
+  {
+    display.printf("Updating: %u%%", otaProgress());
+  }
+  else if (otaState() == OtaState::Restarting)
+  {
+    display.print("Update OK, restarting");
   }
   else
   {
-    Serial.println("WiFi Disconnected. Cannot post data.");
-    httpResponseCode = -1; // WiFi未接続エラー
-    lastPostErrorString = "WiFi Disconnected";
+    drawPostStatus(remainingMinutes, remainingSeconds, currentMillis);
+  }
+
+  display.setTextSize(2);
+  display.setCursor(0, 30);
+  display.print(temperature, 1);
+  display.print((char)247);
+  display.print("C ");
+  display.print(humidity, 0);
+  display.print("%");
+
+  drawRainWarning();
+}
+
+// センサーデータをHTTP POSTで送信する関数
+int postReadingHttp(const SensorReading &reading)
+{
+  String jsonPayload = formatReadingJson(reading);
+
+  LOG_I(LogTag::Http, "Posting sensor data...");
+  LOG_D(LogTag::Http, "%s", jsonPayload.c_str());
+
+  // --- 通信直前のシステム状態をログ出力 ---
+  LOG_D(LogTag::Http, "[Pre-POST] Free Heap: %u bytes, WiFi Status: %d, RSSI: %d dBm", ESP.getFreeHeap(), WiFi.status(), WiFi.RSSI());
+
+  // URLのスキームに応じたクライアントで、保持しているkeep-alive接続を再利用してPOSTする
+  String response;
+  int httpResponseCode = transportPost(POST_URL, "application/json", jsonPayload, response, lastPostErrorString);
+
+  if (httpResponseCode > 0)
+  {
+    LOG_I(LogTag::Http, "HTTP Response code: %d", httpResponseCode);
+    LOG_D(LogTag::Http, "%s", response.c_str());
+  }
+  else
+  {
+    // シリアルモニターにも詳細なエラーメッセージを出力
+    LOG_W(LogTag::Http, "POST failed (%d), error: %s", httpResponseCode, lastPostErrorString.c_str());
   }
+
+  const TransportStats &stats = transportStats();
+  LOG_D(LogTag::Http, "Transport reused: %u, opened: %u, reconnects: %u", stats.reused, stats.opened, stats.reconnects);
   return httpResponseCode;
 }
 
+// センサーデータを設定された送信方式でサーバーへ送る関数
+int postSensorData(float temp, float hum)
+{
+  if (!ensureWiFiConnected(&display))
+  {
+    LOG_W(LogTag::Http, "WiFi Disconnected. Cannot post data.");
+    lastPostErrorString = "WiFi Disconnected";
+    return -1; // WiFi未接続エラー
+  }
+
+  // 接続が確認できたので処理を続行
+  Subsystem previousSubsystem = crashLogSetSubsystem(Subsystem::Post);
+  SensorReading reading = {ROOM_ID, temp, hum};
+  int result;
+  switch (TELEMETRY_TRANSPORT)
+  {
+  case TelemetryTransport::Mqtt:
+    result = publishReadingMqtt(reading, lastPostErrorString);
+    break;
+  case TelemetryTransport::Udp:
+    result = publishReadingUdp(reading, lastPostErrorString);
+    break;
+  default:
+    result = postReadingHttp(reading);
+    break;
+  }
+  if (result < 0 || result >= 400)
+    crashLogSetNetError(result);
+  crashLogSetSubsystem(previousSubsystem);
+  return result;
+}
+
+/**
+ * @brief 現在の状態を描画し、OLEDへの分割転送を要求します。画面がOFFの場合は何もしません。
+ */
+void renderDisplay(unsigned long currentMillis)
+{
+  if (!isDisplayOn)
+    return;
+  Subsystem previousSubsystem = crashLogSetSubsystem(Subsystem::Render);
+
+  // 湿度と温度を読み取る (表示用)
+  float humidity = dht.readHumidity();
+  float temperature = dht.readTemperature();
+
+  char timeStr[9]; // HH:MM:SS 形式 (8文字 + NULL終端)
+  struct tm timeinfo;
+  if (!getLocalTime(&timeinfo))
+  {
+    LOG_EVERY(60000, LogLevel::Warn, LogTag::Display, "Failed to obtain time for display");
+    strcpy(timeStr, "--:--:--");
+  }
+  else
+  {
+    strftime(timeStr, sizeof(timeStr), "%T", &timeinfo); // %T は %H:%M:%S と同じ
+  }
+
+  // 読み取りが成功したかチェック
+  if (isnan(humidity) || isnan(temperature))
+  {
+    LOG_EVERY(60000, LogLevel::Warn, LogTag::Display, "Failed to read from DHT sensor for display!");
+  }
+  else
+  {
+    // 温度オフセットを適用
+    temperature = temperature + TEMP_OFFSET;
+  }
+
+  if (isWolMessageShown && currentMillis - wolMessageStart >= wolMessageDuration)
+    isWolMessageShown = false;
+
+  // --- OLEDディスプレイに結果を出力 ---
+  display.clearDisplay();
+  display.setTextColor(SSD1306_WHITE);
+  if (isWolMessageShown)
+  {
+    drawWolPage(timeStr);
+  }
+  else
+  {
+    // 一定時間ごとに履歴のページを表示する (履歴がまだない場合は通常のページ)
+    bool historyPage = historyPageTicks >= HISTORY_PAGE_PERIOD_SEC - HISTORY_PAGE_SEC && drawHistoryPage(timeStr);
+    if (!historyPage)
+      drawMainPage(timeStr, temperature, humidity, currentMillis);
+  }
+  // 一括転送はループを長時間止めるため、差分を分割転送する
+  displayFlushRequest();
+  crashLogSetSubsystem(previousSubsystem);
+}
+
+/**
+ * @brief WoLパケットを送信し、送信中メッセージを表示します。
+ * @param target 送信先の番号 (wolTarget()の番号)
+ */
+void sendWakeOnLan(size_t target)
+{
+  LOG_I(LogTag::Main, "Sending WoL packet to %s...", wolTarget(target));
+
+  // WoL送信前にWiFi接続を確認・復旧
+  if (!ensureWiFiConnected(&display))
+    return;
+
+  sendWolPacket(wolTarget(target));
+  // メッセージは2秒間表示する。待機せず、その間も時計の更新やボタンの処理を続ける
+  wolMessageStart = millis();
+  isWolMessageShown = true;
+  renderDisplay(wolMessageStart);
+}
+
+/**
+ * @brief 画面をON/OFFします。
+ */
+void setDisplayOn(bool on)
+{
+  if (on == isDisplayOn)
+    return;
+  isDisplayOn = on;
+  display.ssd1306_command(on ? SSD1306_DISPLAYON : SSD1306_DISPLAYOFF);
+  LOG_I(LogTag::Display, on ? "Display ON" : "Display OFF");
+  if (on)
+    renderDisplay(millis()); // 次の1秒を待たずに最新の内容を表示する
+}
+
+/**
+ * @brief センサー値を読み取ってすぐにPOSTし、次の定期POSTまでのタイマーをリセットします。
+ */
+void manualPost()
+{
+  // センサー値を読み取る
+  float hum = dht.readHumidity();
+  float temp = dht.readTemperature();
+
+  // 読み取りが成功した場合のみPOST
+  if (!isnan(hum) && !isnan(temp))
+  {
+    // 温度オフセットを適用
+    temp = temp + TEMP_OFFSET;
+    lastPostResult = postSensorData(temp, hum);
+    postResultDisplayStart = millis(); // 結果表示の開始時刻を記録
+
+    // 次の定期POSTまでのタイマーをリセット
+    lastPostTime = millis();
+  }
+  else
+  {
+    LOG_W(LogTag::Main, "Failed to read from DHT sensor! Cannot POST.");
+  }
+}
+
+/**
+ * @brief 雨雲情報を取得し、次の定期チェックまでのタイマーをリセットします。
+ */
+void checkWeather()
+{
+  lastWeatherCheck = millis();
+  if (!ensureWiFiConnected(&display))
+    return;
+
+  Subsystem previousSubsystem = crashLogSetSubsystem(Subsystem::WeatherFetch);
+  RainInfo rainInfo = checkRainCloud();
+  isRainingSoon = rainInfo.willRain;
+  rainTime = rainInfo.minutesUntilRain;
+  rainAmount = rainInfo.rainfall;
+  crashLogSetSubsystem(previousSubsystem);
+
+  if (rainInfo.statusMessage == "DNS lookup failed")
+    restartOnDnsFailure();
+}
+
 /**
  * @brief スイッチの状態をチェックし、長押し/短押しを処理します。
  */
@@ -298,30 +678,13 @@ void handleSwitch()
       if (isDisplayOn)
       {
         // 画面がONの時 -> WoLパケットを送信
-        Serial.println("Switch short pressed. Sending WoL packet...");
-
-        // WoL送信前にWiFi接続を確認・復旧
-        if (!ensureWiFiConnected(&display))
-          return;
-
-        // OLEDに送信中メッセージを表示
-        display.clearDisplay();
-        display.setTextSize(2);
-        display.setTextColor(SSD1306_WHITE);
-        display.setCursor(0, 24);
-        display.println(F("Sending"));
-        display.println(F("  WoL..."));
-        display.display();
-
-        sendWolPacket(MAC_ADDRESS);
-        delay(2000); // メッセージを2秒間表示
+        LOG_I(LogTag::Main, "Switch short pressed.");
+        sendWakeOnLan(0);
       }
       else
       {
         // 画面がOFFの時 -> 画面をONにする
-        isDisplayOn = true;
-        display.ssd1306_command(SSD1306_DISPLAYON);
-        Serial.println("Display ON");
+        setDisplayOn(true);
       }
     }
     isPressing = false;
@@ -333,13 +696,8 @@ void handleSwitch()
     if (millis() - pressStartTime > LONG_PRESS_TIME)
     {
       // --- 長押し (Long Press) の処理 ---
-      if (isDisplayOn)
-      {
-        // 画面がONの時 -> 画面をOFFにする
-        isDisplayOn = false;
-        display.ssd1306_command(SSD1306_DISPLAYOFF);
-        Serial.println("Display OFF");
-      }
+      // 画面がONの時 -> 画面をOFFにする
+      setDisplayOn(false);
       longPressHandled = true; // 長押し処理が完了したことをマーク
     }
   }
@@ -347,40 +705,125 @@ void handleSwitch()
   lastSwitchState = switchState;
 }
 
+/**
+ * @brief LAN内から受け付けたコマンドを、スイッチ・Flashボタンと同じ処理で実行します。
+ */
+void handleRemoteCommand(const RemoteCommand &command)
+{
+  switch (command.type)
+  {
+  case RemoteCommandType::Wake:
+    LOG_I(LogTag::Main, "Remote command %lu: wake %u", (unsigned long)command.seq, command.target);
+    sendWakeOnLan(command.target);
+    break;
+  case RemoteCommandType::DisplayOn:
+  case RemoteCommandType::DisplayOff:
+    LOG_I(LogTag::Main, "Remote command %lu: display %s", (unsigned long)command.seq,
+          command.type == RemoteCommandType::DisplayOn ? "on" : "off");
+    setDisplayOn(command.type == RemoteCommandType::DisplayOn);
+    break;
+  case RemoteCommandType::Post:
+    LOG_I(LogTag::Main, "Remote command %lu: manual POST", (unsigned long)command.seq);
+    manualPost();
+    break;
+  case RemoteCommandType::Weather:
+    LOG_I(LogTag::Main, "Remote command %lu: refresh weather", (unsigned long)command.seq);
+    checkWeather();
+    break;
+  }
+}
+
+/**
+ * @brief シリアルから受信した1文字のコマンドを処理します。
+ *        c: クラッシュログの表示 / l: ループ処理時間と画面転送の統計の表示 / w: WiFi接続時間の表示 / u: ファームウェアの更新の確認 /
+ *        ?: コマンド一覧
+ */
+void handleSerialCommand()
+{
+  if (Serial.available() <= 0)
+    return;
+
+  switch (Serial.read())
+  {
+  case 'c':
+    logFlush(); // ダンプがバッファ内のログと混ざらないよう、先に送り出す
+    crashLogDump(Serial, 16);
+    break;
+  case 'l':
+    logFlush();
+    loopMonitorDump(Serial);
+    displayFlushDump(Serial);
+    break;
+  case 'w':
+    logFlush();
+    wifiConnectDump(Serial);
+    break;
+  case 'u':
+    otaCheckNow();
+    break;
+  case '?':
+    logFlush();
+    Serial.println(F("Commands: c = crash log, l = loop latency and display flush, w = WiFi connect, u = check for update"));
+    break;
+  default:
+    break;
+  }
+}
+
 void loop()
 {
+  // 前回の反復にかかった時間を記録し、以降は区間ごとに時間を計測する
+  loopMonitorBeginIteration();
+
   // D1ピンに接続されたスイッチの処理
+  loopMonitorSite("switch");
   handleSwitch();
 
-  // Flashボタンが押されたかチェック (手動POST)
-  if (digitalRead(FLASH_BUTTON_PIN) == LOW)
-  {
-    Serial.println("Flash button pressed. Manual POST triggered...");
+  // MQTTの常時接続を維持
+  loopMonitorSite("telemetry");
+  telemetryLoop();
 
-    // センサー値を読み取る
-    float hum = dht.readHumidity();
-    float temp = dht.readTemperature();
+  // LAN内からのHTTPリクエストを処理 (1回あたり1件)
+  loopMonitorSite("http-api");
+  httpApiLoop();
 
-    // 読み取りが成功した場合のみPOST
-    if (!isnan(hum) && !isnan(temp))
-    {
-      // 温度オフセットを適用
-      temp = temp + TEMP_OFFSET;
-      lastPostResult = postSensorData(temp, hum);
-      postResultDisplayStart = millis(); // 結果表示の開始時刻を記録
+  // LAN内からのコマンド (UDP / HTTP) を、受け付けたその反復のうちに実行する
+  loopMonitorSite("remote-command");
+  remoteCommandPoll();
+  RemoteCommand command;
+  while (remoteCommandNext(command))
+    handleRemoteCommand(command);
 
-      // 次の定期POSTまでのタイマーをリセット
-      lastPostTime = millis();
-    }
-    else
-    {
-      Serial.println(F("Failed to read from DHT sensor! Cannot POST."));
-    }
+  // 描画済みフレームをOLEDへ少しずつ転送する (1回あたり1チャンク)
+  loopMonitorSite("display-flush");
+  bool flushing = displayFlushStep();
+
+  // ファームウェアの更新を定期的に確認し、ダウンロード中は1チャンクずつ書き込む。
+  // フラッシュの消去でフレームの転送が間延びしないよう、転送中は休む
+  loopMonitorSite("ota");
+  if (!flushing)
+    otaLoop();
+
+  // バッファに溜まったログを、UARTの送信FIFOに空きがある分だけ送り出す
+  loopMonitorSite("log");
+  logDrain();
+
+  // シリアルからのコマンドを処理
+  loopMonitorSite("serial");
+  handleSerialCommand();
+
+  // Flashボタンが押されたかチェック (手動POST)
+  loopMonitorSite("flash-button");
+  if (digitalRead(FLASH_BUTTON_PIN) == LOW)
+  {
+    LOG_I(LogTag::Main, "Flash button pressed. Manual POST triggered...");
+    manualPost();
 
     // ボタンが離されるまで待機 (チャタリング防止)
-    delay(50); // 短い遅延
+    loopMonitorDelay(50); // 短い遅延
+    // 押し続けられてもソフトウェアWDTが発動しないよう、待機中もyieldする
     while (digitalRead(FLASH_BUTTON_PIN) == LOW)
-      ;
+      loopMonitorYield();
   }
 
   // 天気情報を定期的にチェック
@@ -391,31 +834,18 @@ void loop()
     return;
   lastLoopTime = currentMillis;
 
+  // 稼働時間とヒープの状態をRTCメモリに記録
+  crashLogTick();
+
+  loopMonitorSite("weather");
   if (currentMillis - lastWeatherCheck >= weatherCheckInterval)
   {
-    lastWeatherCheck = currentMillis;
-    Serial.println("\nChecking for rain clouds...");
-    if (ensureWiFiConnected(&display))
-    {
-      RainInfo rainInfo = checkRainCloud();
-      isRainingSoon = rainInfo.willRain;
-      rainTime = rainInfo.minutesUntilRain;
-      rainAmount = rainInfo.rainfall;
-
-      // DNS障害からの最終回復処理: システムを再起動する
-      if (rainInfo.statusMessage == "DNS lookup failed")
-      {
-        Serial.println("\n--- Unrecoverable DNS Failure Detected. Restarting system... ---");
-        display.clearDisplay();
-        display.println("DNS Failed.\nRestarting...");
-        display.display();
-        delay(3000); // メッセージを3秒間表示
-        ESP.restart();
-      }
-    }
+    LOG_I(LogTag::Weather, "Checking for rain clouds...");
+    checkWeather();
   }
 
   // 10分ごとにセンサーデータをPOST
+  loopMonitorSite("post");
   if (currentMillis - lastPostTime >= postInterval)
   {
     lastPostTime = currentMillis;
@@ -430,19 +860,12 @@ void loop()
 
       // DNS障害からの最終回復処理 (postSensorDataは内部でエラーメッセージを設定する)
       if (lastPostErrorString.indexOf("DNS") != -1)
-      {
-        Serial.println("\n--- Unrecoverable DNS Failure Detected. Restarting system... ---");
-        display.clearDisplay();
-        display.println("DNS Failed.\nRestarting...");
-        display.display();
-        delay(3000); // メッセージを3秒間表示
-        ESP.restart();
-      }
+        restartOnDnsFailure();
     }
   }
 
   // 雨が降る予報の場合、点滅用の状態を切り替える
-  if (isRainingSoon)
+  if (isRainingSoon || weatherLocationCount() > 1)
   {
     rainWarningBlinkState = !rainWarningBlinkState;
   }
@@ -451,116 +874,41 @@ void loop()
     rainWarningBlinkState = true; // 雨が降らない場合は常に表示状態にする
   }
 
+  // 下段に表示する地点を切り替える
+  if (weatherLocationCount() > 1 && ++rainLocationTicks >= RAIN_LOCATION_ROTATE_SEC)
+  {
+    rainLocationTicks = 0;
+    rainLocationIndex = (rainLocationIndex + 1) % weatherLocationCount();
+  }
+
+  // 履歴のページを表示する時間を数える
+  historyPageTicks = (historyPageTicks + 1) % HISTORY_PAGE_PERIOD_SEC;
+
   // --- シリアルモニタへの定期ログ出力 ---
   // 画面の状態に関わらず、センサー値などをシリアルに出力します。
-  // （POST用の読み取りとは別に、デバッグ用に毎秒読み取ります）
+  // （POST用の読み取りとは別に読み取ります。同じ内容が続くため1分に1回に間引きます）
+  loopMonitorSite("dht-log");
   float debug_hum = dht.readHumidity();
   float debug_temp = dht.readTemperature();
   if (!isnan(debug_hum) && !isnan(debug_temp))
   {
     debug_temp = debug_temp + TEMP_OFFSET; // オフセット適用
-    Serial.print(F("Humidity: "));
-    Serial.print(debug_hum);
-    Serial.print(F("%  Temperature: "));
-    Serial.print(debug_temp);
-    Serial.println(F(" *C"));
+    LOG_EVERY(60000, LogLevel::Info, LogTag::Main, "Humidity: %.2f%%  Temperature: %.2f *C", debug_hum, debug_temp);
+    // 1分ごとの平均値にまとめて履歴に記録する (時刻が未同期の間は記録されない)
+    historyAdd(time(nullptr), debug_temp, debug_hum);
   }
   else
   {
-    Serial.println(F("Failed to read from DHT sensor for serial log!"));
+    LOG_EVERY(60000, LogLevel::Warn, LogTag::Main, "Failed to read from DHT sensor for serial log!");
   }
 
   // 画面がONのときだけ、描画処理を実行
-  if (isDisplayOn)
-  {
-    // 湿度と温度を読み取る (表示用)
-    float humidity = dht.readHumidity();
-    float temperature = dht.readTemperature();
+  loopMonitorSite("render");
+  renderDisplay(currentMillis);
 
-    char timeStr[9]; // HH:MM:SS 形式 (8文字 + NULL終端)
-    struct tm timeinfo;
-    if (!getLocalTime(&timeinfo))
-    {
-      Serial.println("Failed to obtain time for display");
-      strcpy(timeStr, "--:--:--");
-    }
-    else
-    {
-      strftime(timeStr, sizeof(timeStr), "%T", &timeinfo); // %T は %H:%M:%S と同じ
-    }
-
-    // 読み取りが成功したかチェック
-    if (isnan(humidity) || isnan(temperature))
-    {
-      Serial.println(F("Failed to read from DHT sensor for display!"));
-    }
-    else
-    {
-      // 温度オフセットを適用
-      temperature = temperature + TEMP_OFFSET;
-    }
-
-    // --- OLEDディスプレイに結果を出力 ---
-    display.clearDisplay();
-    display.setTextColor(SSD1306_WHITE);
-
-    display.setTextSize(2);
-    display.setCursor(12, 0);
-    display.println(timeStr);
-
-    unsigned long remainingMillis = postInterval - (currentMillis - lastPostTime);
-    if (remainingMillis > postInterval)
-      remainingMillis = postInterval;
-    int remainingMinutes = remainingMillis / 1000 / 60;
-    int remainingSeconds = (remainingMillis / 1000) % 60;
-    display.setTextSize(1);
-    display.setCursor(0, 18);
-
-    // POST結果の表示ロジック
-    bool lastPostFailed = (lastPostResult <= 0 && lastPostResult != 0);
-    bool showSuccessMessage = (lastPostResult > 0 && currentMillis - postResultDisplayStart < postResultDisplayDuration);
-
-    if (showSuccessMessage)
-    {
-      // 成功時は5秒間だけ結果を表示
-      display.printf("POST OK (%d)", lastPostResult);
-    }
-    else if (lastPostFailed)
-    {
-      // 失敗時は、カウントダウンの横に失敗コードを表示し続ける
-      // エラーメッセージが長い場合があるので、先頭から一部だけ表示
-      char errorSnippet[15];
-      strncpy(errorSnippet, lastPostErrorString.c_str(), sizeof(errorSnippet) - 1);
-
-      // DNSエラーの場合は特別に表示
-      if (lastPostErrorString.indexOf("DNS") != -1)
-      {
-        strncpy(errorSnippet, "DNS Failed", sizeof(errorSnippet) - 1);
-      }
-
-      errorSnippet[sizeof(errorSnippet) - 1] = '\0';
-
-      display.printf("Post in: %02d:%02d (%s)", remainingMinutes, remainingSeconds, errorSnippet);
-    }
-    else
-    {
-      // 通常時はカウントダウンのみ表示
-      display.printf("Post in: %02d:%02d", remainingMinutes, remainingSeconds);
-    }
-
-    display.setTextSize(2);
-    display.setCursor(0, 30);
-    display.print(temperature, 1);
-    display.print((char)247);
-    display.print("C ");
-    display.print(humidity, 0);
-    display.print("%");
-
-    drawRainWarning();
-    display.display();
-  }
+  crashLogSetSubsystem(Subsystem::Idle);
 
   // delay()はWiFi接続を不安定にするため使用しない。
   // yield()を呼び出してバックグラウンド処理にCPU時間を譲る。
-  yield();
+  loopMonitorYield();
 }
\ No newline at end of file
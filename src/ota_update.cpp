@@ -0,0 +1,307 @@
+#include "ota_update.h"
+#include "crash_log.h"
+#include "rtc_layout.h"
+#include "log.h"
+#include <ESP8266WiFi.h>
+#include <ESP8266HTTPClient.h>
+#include <ArduinoJson.h>
+#include <Updater.h>
+#include <bearssl/bearssl_hash.h>
+#include "secrets.h" // OTA_MANIFEST_URL (任意)
+
+// マニフェストを確認する間隔 (ms)
+#define OTA_CHECK_INTERVAL_MS (6UL * 60 * 60 * 1000)
+// 起動後、最初にマニフェストを確認するまでの時間 (ms)。起動直後の天気の取得などと重ならないようにする
+#define OTA_FIRST_CHECK_MS (60UL * 1000)
+// 1回のotaLoop()で受信・書き込みする最大のバイト数。フラッシュの消去 (4KBごと) 以外でループを長く止めない大きさ
+#define OTA_CHUNK_SIZE 1024
+// 受信が途絶えてから失敗とみなすまでの時間 (ms)
+#define OTA_STALL_TIMEOUT_MS 10000
+// ハッシュを検証するまで書き込まずに保持する、イメージ末尾のバイト数。
+// 全バイトを書き込んだ後のUpdate.end()は再起動時の書き換えを予約してしまうため、検証に失敗した場合に破棄できるよう残しておく
+#define OTA_HOLD_BACK 16
+// 書き込みが完了してから再起動するまでの時間 (ms)。その間は画面に完了を表示する
+#define OTA_RESTART_DELAY_MS 3000
+#define OTA_STATE_MAGIC 0x4F544131 // "OTA1"
+
+// 最後に書き込んだイメージのハッシュ (RTCメモリに保持し、再起動後に同じイメージを再び書き込まないようにする)
+struct RtcOtaState
+{
+  uint32_t magic;
+  uint8_t stagedHash[br_sha256_SIZE];
+};
+
+#ifdef OTA_MANIFEST_URL
+static WiFiClient client;
+static HTTPClient http;
+static br_sha256_context sha;
+static uint8_t expectedHash[br_sha256_SIZE];
+static uint8_t tail[OTA_HOLD_BACK];
+static char newVersion[24];
+static uint32_t imageSize = 0;
+static uint32_t received = 0;
+static unsigned long downloadStart = 0;
+static unsigned long lastDataMillis = 0;
+static unsigned long restartAt = 0;
+static unsigned long lastCheck = 0;
+static bool firstCheckDone = false;
+static bool checkRequested = false;
+#endif
+static OtaState state = OtaState::Idle;
+
+size_t otaWritableBytes(uint32_t received, size_t n, uint32_t imageSize, uint32_t &tailOffset)
+{
+  uint32_t writeLimit = imageSize - OTA_HOLD_BACK;
+  size_t writable = received < writeLimit ? min((uint32_t)n, writeLimit - received) : 0;
+  tailOffset = writable < n ? received + writable - writeLimit : 0;
+  return writable;
+}
+
+#ifdef OTA_MANIFEST_URL
+static bool parseHash(const char *hex, uint8_t *hash)
+{
+  if (strlen(hex) != br_sha256_SIZE * 2)
+    return false;
+  for (size_t i = 0; i < br_sha256_SIZE; i++)
+  {
+    char byte[3] = {hex[i * 2], hex[i * 2 + 1], '\0'};
+    char *end;
+    hash[i] = (uint8_t)strtoul(byte, &end, 16);
+    if (*end != '\0')
+      return false;
+  }
+  return true;
+}
+
+/**
+ * @brief 前回の再起動の前に、同じハッシュのイメージを書き込んでいればtrueを返す
+ */
+static bool alreadyStaged(const uint8_t *hash)
+{
+  RtcOtaState rtcState;
+  ESP.rtcUserMemoryRead(RTC_BLOCK_OTA, (uint32_t *)&rtcState, sizeof(rtcState));
+  return rtcState.magic == OTA_STATE_MAGIC && memcmp(rtcState.stagedHash, hash, sizeof(rtcState.stagedHash)) == 0;
+}
+
+static void saveStagedHash(const uint8_t *hash)
+{
+  RtcOtaState rtcState;
+  rtcState.magic = OTA_STATE_MAGIC;
+  memcpy(rtcState.stagedHash, hash, sizeof(rtcState.stagedHash));
+  ESP.rtcUserMemoryWrite(RTC_BLOCK_OTA, (uint32_t *)&rtcState, sizeof(rtcState));
+}
+
+static void fail(const char *reason)
+{
+  LOG_W(LogTag::Ota, "Update %s failed after %u/%u bytes: %s", newVersion, received, imageSize, reason);
+  http.end();
+  Update.end(false); // 全バイトを書き込む前なので、予約されずに破棄される
+  state = OtaState::Idle;
+}
+
+static void startDownload(const char *version, const char *url, uint32_t size)
+{
+  strncpy(newVersion, version, sizeof(newVersion) - 1);
+  imageSize = size;
+  received = 0;
+
+  if (!http.begin(client, url))
+  {
+    LOG_W(LogTag::Ota, "Invalid image URL: %s", url);
+    return;
+  }
+  // HTTP/1.1ではチャンク形式で応答されることがあり、getStream()から読むとチャンクの区切りがイメージに混ざる。
+  // HTTP/1.0で要求して、ボディをそのまま受信する
+  http.useHTTP10(true);
+  int code = http.GET();
+  if (code != HTTP_CODE_OK)
+  {
+    LOG_W(LogTag::Ota, "Image request failed (%d)", code);
+    http.end();
+    return;
+  }
+  int length = http.getSize();
+  // 長さが分からない応答は、受信したバイト数がイメージの終わりかどうかを判断できないため拒否する
+  if (length < 0 || (uint32_t)length != size)
+  {
+    LOG_W(LogTag::Ota, "Image size %d does not match manifest (%u)", length, size);
+    http.end();
+    return;
+  }
+  // gzip圧縮したイメージもそのまま受け付ける (伸長は再起動時にブートローダーが行う)
+  if (!Update.begin(size))
+  {
+    LOG_W(LogTag::Ota, "Cannot stage %u bytes: %s", size, Update.getErrorString().c_str());
+    http.end();
+    return;
+  }
+
+  br_sha256_init(&sha);
+  downloadStart = lastDataMillis = millis();
+  state = OtaState::Downloading;
+  LOG_I(LogTag::Ota, "Downloading firmware %s (%u bytes)...", version, size);
+}
+
+static void checkManifest()
+{
+  LOG_I(LogTag::Ota, "Checking for firmware update (running %s)...", FIRMWARE_VERSION);
+  if (!http.begin(client, OTA_MANIFEST_URL))
+  {
+    LOG_W(LogTag::Ota, "Invalid manifest URL");
+    return;
+  }
+  http.useHTTP10(true);
+  int code = http.GET();
+  if (code != HTTP_CODE_OK)
+  {
+    LOG_W(LogTag::Ota, "Manifest request failed (%d)", code);
+    http.end();
+    return;
+  }
+  JsonDocument manifest;
+  DeserializationError error = deserializeJson(manifest, http.getStream());
+  http.end();
+  if (error)
+  {
+    LOG_W(LogTag::Ota, "Invalid manifest: %s", error.c_str());
+    return;
+  }
+
+  const char *version = manifest["version"].as<const char *>();
+  const char *url = manifest["url"].as<const char *>();
+  const char *sha256 = manifest["sha256"].as<const char *>();
+  uint32_t size = manifest["size"].as<uint32_t>();
+  if (!version || !url || !sha256 || size <= OTA_HOLD_BACK || !parseHash(sha256, expectedHash))
+  {
+    LOG_W(LogTag::Ota, "Manifest must have version, url, size and sha256");
+    return;
+  }
+  if (strcmp(version, FIRMWARE_VERSION) == 0)
+  {
+    LOG_I(LogTag::Ota, "Firmware is up to date");
+    return;
+  }
+  // 書き込んだイメージで起動してもバージョンが変わらない場合 (FIRMWARE_VERSIONの変更忘れなど)、
+  // 同じイメージの書き込みと再起動を繰り返さないようにする
+  if (alreadyStaged(expectedHash))
+  {
+    LOG_W(LogTag::Ota, "Image for %s was already staged but reports %s; skipping", version, FIRMWARE_VERSION);
+    return;
+  }
+  startDownload(version, url, size);
+}
+
+/**
+ * @brief 受信済みのデータを最大OTA_CHUNK_SIZEバイトだけ読み、ハッシュを更新して書き込む (受信を待たない)
+ */
+static void downloadStep()
+{
+  WiFiClient &stream = http.getStream();
+  size_t available = stream.available();
+  if (available == 0)
+  {
+    if (!stream.connected())
+      fail("connection closed");
+    else if (millis() - lastDataMillis > OTA_STALL_TIMEOUT_MS)
+      fail("download stalled");
+    return;
+  }
+
+  uint8_t buffer[OTA_CHUNK_SIZE];
+  size_t n = stream.read(buffer, min(available, (size_t)min((uint32_t)sizeof(buffer), imageSize - received)));
+  br_sha256_update(&sha, buffer, n);
+
+  // 末尾のOTA_HOLD_BACKバイトは、ハッシュを検証するまで書き込まずに保持する
+  uint32_t tailOffset;
+  size_t writable = otaWritableBytes(received, n, imageSize, tailOffset);
+  if (writable > 0 && Update.write(buffer, writable) != writable)
+  {
+    fail(Update.getErrorString().c_str());
+    return;
+  }
+  if (writable < n)
+    memcpy(tail + tailOffset, buffer + writable, n - writable);
+  received += n;
+  lastDataMillis = millis();
+  if (received < imageSize)
+    return;
+
+  http.end();
+  uint8_t hash[br_sha256_SIZE];
+  br_sha256_out(&sha, hash);
+  if (memcmp(hash, expectedHash, sizeof(hash)) != 0)
+  {
+    fail("SHA-256 mismatch");
+    return;
+  }
+  if (Update.write(tail, OTA_HOLD_BACK) != OTA_HOLD_BACK || !Update.end())
+  {
+    fail(Update.getErrorString().c_str());
+    return;
+  }
+  saveStagedHash(hash);
+  LOG_I(LogTag::Ota, "Firmware %s verified and staged in %lu ms. Restarting...", newVersion, millis() - downloadStart);
+  restartAt = millis();
+  state = OtaState::Restarting;
+}
+#endif
+
+void otaLoop()
+{
+#ifdef OTA_MANIFEST_URL
+  if (state == OtaState::Restarting)
+  {
+    if (millis() - restartAt >= OTA_RESTART_DELAY_MS)
+    {
+      logFlush();
+      ESP.restart();
+    }
+    return;
+  }
+
+  Subsystem previousSubsystem;
+  if (state == OtaState::Downloading)
+  {
+    previousSubsystem = crashLogSetSubsystem(Subsystem::OtaUpdate);
+    downloadStep();
+    crashLogSetSubsystem(previousSubsystem);
+    return;
+  }
+
+  unsigned long interval = firstCheckDone ? OTA_CHECK_INTERVAL_MS : OTA_FIRST_CHECK_MS;
+  if (!checkRequested && millis() - lastCheck < interval)
+    return;
+  // WiFiの再接続はPOST・天気の取得に任せ、ここでは待たない
+  if (WiFi.status() != WL_CONNECTED)
+    return;
+  checkRequested = false;
+  firstCheckDone = true;
+  lastCheck = millis();
+  previousSubsystem = crashLogSetSubsystem(Subsystem::OtaUpdate);
+  checkManifest();
+  crashLogSetSubsystem(previousSubsystem);
+#endif
+}
+
+void otaCheckNow()
+{
+#ifdef OTA_MANIFEST_URL
+  checkRequested = true;
+#else
+  LOG_I(LogTag::Ota, "OTA update is disabled (OTA_MANIFEST_URL is not set)");
+#endif
+}
+
+OtaState otaState()
+{
+  return state;
+}
+
+uint8_t otaProgress()
+{
+#ifdef OTA_MANIFEST_URL
+  if (imageSize > 0)
+    return (uint64_t)received * 100 / imageSize;
+#endif
+  return 0;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <Arduino.h>
+
+// ファームウェアのバージョン (platformio.iniのbuild_flagsで指定する)。マニフェストのversionと異なれば更新する
+#ifndef FIRMWARE_VERSION
+#define FIRMWARE_VERSION "dev"
+#endif
+
+// 更新処理の状態
+enum class OtaState : uint8_t
+{
+  Idle,        // 待機中 (定期的にマニフェストを確認する)
+  Downloading, // イメージを受信しながら書き込み中
+  Restarting   // 書き込みと検証が完了し、再起動を待っている
+};
+
+/**
+ * @brief loop()から毎回呼び出す。一定間隔でマニフェストを確認し、ダウンロード中は1チャンクだけ受信して書き込む
+ *
+ * マニフェストはsecrets.hのOTA_MANIFEST_URLから取得するJSON:
+ *   {"version":"1.1.0","url":"http://.../firmware.bin.gz","size":<イメージのバイト数>,"sha256":"<16進数64文字>"}
+ * イメージはgzip圧縮したまま (firmware.bin.gz) フラッシュの更新領域に書き込み、再起動時にブートローダーが伸長する。
+ * SHA-256が一致しない場合は、末尾を書き込まずに破棄する (再起動しない)。
+ * OTA_MANIFEST_URLが定義されていない場合は何もしない。
+ */
+void otaLoop();
+
+/**
+ * @brief 次のotaLoop()で、間隔を待たずにマニフェストを確認する
+ */
+void otaCheckNow();
+
+/**
+ * @brief 更新処理の状態を返す
+ */
+OtaState otaState();
+
+/**
+ * @brief ダウンロードの進捗 (0-100%) を返す
+ */
+uint8_t otaProgress();
+
+// 以下の関数はテストから参照されるため、ヘッダーで宣言します
+/**
+ * @brief 受信したチャンクのうち、すぐにフラッシュへ書き込めるバイト数を返す
+ *
+ * イメージ末尾のOTA_HOLD_BACKバイトはハッシュを検証するまで書き込まないため、チャンクがそこにかかる場合は
+ * 書き込める先頭部分だけを返す。残り (n - 戻り値) バイトは末尾のバッファのtailOffsetの位置に保持する。
+ * @param received このチャンクより前に受信したバイト数
+ * @param n チャンクのバイト数
+ * @param imageSize イメージ全体のバイト数 (OTA_HOLD_BACKより大きいこと)
+ * @param tailOffset 残りを保持する、末尾のバッファ内の位置の格納先 (残りがない場合は0)
+ * @return size_t 書き込めるバイト数
+ */
+size_t otaWritableBytes(uint32_t received, size_t n, uint32_t imageSize, uint32_t &tailOffset);
@@ -0,0 +1,234 @@
+#include "remote_command.h"
+#include "rtc_layout.h"
+#include "log.h"
+#include "wol.h"
+#include <WiFiUdp.h>
+#include <errno.h>
+#include <bearssl/bearssl_hmac.h>
+#include "secrets.h" // COMMAND_KEY (任意)
+
+#define COMMAND_PORT 4210
+// 受け付けるコマンドの最大長 (バイト)
+#define COMMAND_MAX_LENGTH 127
+// 送信側と端末の時刻のずれの許容範囲 (秒)。これより古いコマンドは再送とみなして拒否する
+#define COMMAND_MAX_SKEW_SEC 30
+// 実行を待つコマンドの最大数
+#define COMMAND_QUEUE_SIZE 4
+// この時刻より前は、NTPの同期前とみなしてコマンドを受け付けない (2020-01-01)
+#define COMMAND_MIN_EPOCH 1577836800UL
+#define COMMAND_STATE_MAGIC 0x434D4431 // "CMD1"
+
+#define HMAC_HEX_LENGTH (br_sha256_SIZE * 2)
+
+// 最後に受け付けた通し番号 (RTCメモリに保持し、再起動後も再送を拒否する)
+struct RtcCommandState
+{
+  uint32_t magic;
+  uint32_t lastSeq;
+  uint16_t checksum;
+  uint16_t reserved;
+};
+
+static RtcCommandState commandState;
+static RemoteCommand queue[COMMAND_QUEUE_SIZE];
+static uint8_t queueHead = 0;
+static uint8_t queueCount = 0;
+
+#ifdef COMMAND_KEY
+static WiFiUDP udp;
+#endif
+
+static uint16_t stateChecksum(const RtcCommandState &s)
+{
+  const uint8_t *p = (const uint8_t *)&s;
+  uint16_t sum = 0;
+  for (size_t i = 0; i < offsetof(RtcCommandState, checksum); i++)
+    sum = (sum << 1 | sum >> 15) ^ p[i];
+  return sum;
+}
+
+static void saveState()
+{
+  commandState.checksum = stateChecksum(commandState);
+  ESP.rtcUserMemoryWrite(RTC_BLOCK_COMMAND, (uint32_t *)&commandState, sizeof(commandState));
+}
+
+static int hexValue(char c)
+{
+  if (c >= '0' && c <= '9')
+    return c - '0';
+  c |= 0x20; // 小文字にする
+  if (c >= 'a' && c <= 'f')
+    return c - 'a' + 10;
+  return -1;
+}
+
+/**
+ * @brief 16進数の文字列とHMACを比較する。一致しない位置によって時間が変わらないよう、常に全体を比較する
+ */
+static bool hmacEquals(const char *hex, const uint8_t *mac)
+{
+  uint8_t diff = 0;
+  for (size_t i = 0; i < br_sha256_SIZE; i++)
+  {
+    int high = hexValue(hex[i * 2]);
+    int low = hexValue(hex[i * 2 + 1]);
+    if (high < 0 || low < 0)
+      return false;
+    diff |= ((high << 4) | low) ^ mac[i];
+  }
+  return diff == 0;
+}
+
+const char *parseRemoteCommand(const char *text, size_t len, const uint8_t *key, size_t keyLen, uint32_t now,
+                               uint32_t lastSeq, size_t targetCount, RemoteCommand &command)
+{
+  if (len > COMMAND_MAX_LENGTH)
+    return "too long";
+  char line[COMMAND_MAX_LENGTH + 1];
+  memcpy(line, text, len);
+  line[len] = '\0';
+  // 末尾の改行は無視する
+  while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r'))
+    line[--len] = '\0';
+
+  // 最後の空白より後ろがHMAC、前が署名の対象
+  char *separator = strrchr(line, ' ');
+  if (!separator || strlen(separator + 1) != HMAC_HEX_LENGTH)
+    return "malformed";
+
+  uint8_t mac[br_sha256_SIZE];
+  br_hmac_key_context keyContext;
+  br_hmac_context hmac;
+  br_hmac_key_init(&keyContext, &br_sha256_vtable, key, keyLen);
+  br_hmac_init(&hmac, &keyContext, 0);
+  br_hmac_update(&hmac, line, separator - line);
+  br_hmac_out(&hmac, mac);
+  if (!hmacEquals(separator + 1, mac))
+    return "bad signature";
+  *separator = '\0';
+
+  // 通し番号はRTCメモリに32ビットで保持するため、範囲外の値は拒否する
+  // (sscanf()の%luは範囲外の値をULONG_MAXに丸めるため、受け付けると以降のコマンドがすべて再送扱いになる)
+  if (!isdigit((unsigned char)line[0]))
+    return "malformed";
+  char *rest;
+  errno = 0;
+  unsigned long seq = strtoul(line, &rest, 10);
+  if (errno == ERANGE || seq > UINT32_MAX || *rest != ' ')
+    return "malformed";
+
+  unsigned long timestamp;
+  char name[12], arg[8] = "";
+  if (sscanf(rest, "%lu %11s %7s", &timestamp, name, arg) < 2)
+    return "malformed";
+
+  // 再送の防止: 時刻が許容範囲内で、通し番号が最後に受け付けたものより大きいこと
+  if (now < COMMAND_MIN_EPOCH)
+    return "time not synced";
+  if (timestamp + COMMAND_MAX_SKEW_SEC < now || timestamp > now + COMMAND_MAX_SKEW_SEC)
+    return "stale timestamp";
+  if (seq <= lastSeq)
+    return "replayed";
+
+  command.seq = seq;
+  command.target = 0;
+  if (strcmp(name, "wake") == 0)
+  {
+    char *end;
+    unsigned long target = strtoul(arg, &end, 10);
+    // 存在しない送信先は、"ok"を返してから実行時に捨てるのではなく、ここで拒否する
+    if (*end != '\0' || target >= targetCount || target > UINT8_MAX)
+      return "bad target";
+    command.type = RemoteCommandType::Wake;
+    command.target = target;
+  }
+  else if (strcmp(name, "display") == 0 && strcmp(arg, "on") == 0)
+    command.type = RemoteCommandType::DisplayOn;
+  else if (strcmp(name, "display") == 0 && strcmp(arg, "off") == 0)
+    command.type = RemoteCommandType::DisplayOff;
+  else if (strcmp(name, "post") == 0)
+    command.type = RemoteCommandType::Post;
+  else if (strcmp(name, "weather") == 0)
+    command.type = RemoteCommandType::Weather;
+  else
+    return "unknown command";
+  return nullptr;
+}
+
+bool remoteCommandSubmit(const char *text, size_t len, String &reply)
+{
+#ifdef COMMAND_KEY
+  RemoteCommand command;
+  const char *error = parseRemoteCommand(text, len, (const uint8_t *)COMMAND_KEY, strlen(COMMAND_KEY),
+                                         time(nullptr), commandState.lastSeq, wolTargetCount(), command);
+  if (!error && queueCount == COMMAND_QUEUE_SIZE)
+    error = "busy";
+  if (error)
+  {
+    LOG_W(LogTag::Main, "Command rejected: %s", error);
+    reply = String("error ") + error;
+    return false;
+  }
+
+  commandState.lastSeq = command.seq;
+  saveState();
+  queue[(queueHead + queueCount) % COMMAND_QUEUE_SIZE] = command;
+  queueCount++;
+  reply = String("ok ") + String(command.seq);
+  return true;
+#else
+  (void)text;
+  (void)len;
+  reply = "error disabled";
+  return false;
+#endif
+}
+
+void remoteCommandBegin()
+{
+  ESP.rtcUserMemoryRead(RTC_BLOCK_COMMAND, (uint32_t *)&commandState, sizeof(commandState));
+  if (commandState.magic != COMMAND_STATE_MAGIC || commandState.checksum != stateChecksum(commandState))
+  {
+    memset(&commandState, 0, sizeof(commandState));
+    commandState.magic = COMMAND_STATE_MAGIC;
+  }
+
+#ifdef COMMAND_KEY
+  udp.begin(COMMAND_PORT);
+  LOG_I(LogTag::Main, "Command listener on UDP port %u", COMMAND_PORT);
+#else
+  LOG_I(LogTag::Main, "Command listener disabled (COMMAND_KEY is not set)");
+#endif
+}
+
+void remoteCommandPoll()
+{
+#ifdef COMMAND_KEY
+  int size = udp.parsePacket();
+  if (size <= 0)
+    return;
+
+  char packet[COMMAND_MAX_LENGTH + 1];
+  String reply;
+  if (size > COMMAND_MAX_LENGTH)
+    reply = "error too long";
+  else
+    remoteCommandSubmit(packet, udp.read((uint8_t *)packet, size), reply);
+  udp.flush(); // 読み残しを破棄する
+
+  udp.beginPacket(udp.remoteIP(), udp.remotePort());
+  udp.write((const uint8_t *)reply.c_str(), reply.length());
+  udp.endPacket();
+#endif
+}
+
+bool remoteCommandNext(RemoteCommand &command)
+{
+  if (queueCount == 0)
+    return false;
+  command = queue[queueHead];
+  queueHead = (queueHead + 1) % COMMAND_QUEUE_SIZE;
+  queueCount--;
+  return true;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <Arduino.h>
+
+// LAN内から受け付けるコマンド
+enum class RemoteCommandType : uint8_t
+{
+  Wake,       // WoLパケットを送信する (target: 送信先の番号)
+  DisplayOn,  // 画面を点灯する
+  DisplayOff, // 画面を消灯する
+  Post,       // センサーデータを今すぐ送信する (Flashボタンと同じ)
+  Weather     // 天気情報を今すぐ取得する
+};
+
+struct RemoteCommand
+{
+  RemoteCommandType type;
+  uint8_t target;
+  uint32_t seq; // 送信側が付けた通し番号
+};
+
+/**
+ * @brief コマンドを受け付けるUDPポートを開く。WiFi接続後にsetup()から呼び出す
+ *
+ * secrets.hでCOMMAND_KEYが定義されていない場合は何もしない (コマンドを受け付けない)。
+ */
+void remoteCommandBegin();
+
+/**
+ * @brief 受信したUDPパケットを1つだけ検証し、有効なコマンドをキューに入れて送信元に結果を返す。
+ *        loop()から毎回呼び出す (受信していなければすぐに戻る)
+ */
+void remoteCommandPoll();
+
+/**
+ * @brief UDP以外 (HTTPなど) で受け取ったコマンドを検証し、有効ならキューに入れる
+ * @param text コマンドの文字列 (UDPと同じ形式)
+ * @param len 文字列の長さ
+ * @param reply 結果 ("ok <seq>" または "error <理由>") の格納先
+ * @return bool キューに入れた場合はtrue
+ */
+bool remoteCommandSubmit(const char *text, size_t len, String &reply);
+
+/**
+ * @brief キューからコマンドを1つ取り出す
+ * @return bool 取り出した場合はtrue
+ */
+bool remoteCommandNext(RemoteCommand &command);
+
+// 以下の関数はテストから参照されるため、ヘッダーで宣言します
+/**
+ * @brief "<seq> <UNIX時刻> <コマンド> [引数] <HMAC>" 形式のコマンドを検証して解釈する
+ *
+ * HMACは "<seq> <UNIX時刻> <コマンド> [引数]" に対するHMAC-SHA256 (16進数64文字)。
+ * コマンドは "wake [番号]" / "display on" / "display off" / "post" / "weather"。
+ * @param text コマンドの文字列
+ * @param len 文字列の長さ
+ * @param key HMACの鍵
+ * @param keyLen 鍵の長さ
+ * @param now 現在のUNIX時刻
+ * @param lastSeq 最後に受け付けたコマンドの通し番号 (これ以下の番号は再送とみなして拒否する)
+ * @param targetCount WoLの送信先の数 (wakeの番号がこれ以上なら拒否する)
+ * @param command 解釈したコマンドの格納先
+ * @return const char* 拒否した理由 (受け付けた場合はnullptr)
+ */
+const char *parseRemoteCommand(const char *text, size_t len, const uint8_t *key, size_t keyLen, uint32_t now,
+                               uint32_t lastSeq, size_t targetCount, RemoteCommand &command);
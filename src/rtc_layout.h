@@ -0,0 +1,10 @@
+#pragma once
+
+// --- RTCユーザーメモリの割り当て ---
+// RTCユーザーメモリ (512バイト) はソフトウェアリセット・WDTリセット・例外リセットを経ても保持される。
+// オフセットは4バイト単位のブロック番号。先頭の128バイト (ブロック0-31) はOTA (eboot) が使用するため避ける。
+#define RTC_BLOCK_CRASH_LOG 32 // クラッシュログ用の稼働中セッション情報 (16バイト)
+#define RTC_BLOCK_WIFI_CACHE 36 // WiFiの接続先 (BSSID/チャンネル/PSK) のキャッシュ (48バイト, ブロック36-47)
+#define RTC_BLOCK_COMMAND 48 // 最後に受け付けたリモートコマンドの通し番号 (12バイト, ブロック48-50)
+#define RTC_BLOCK_CRASH_REPEAT 51 // 同じ要因で繰り返したリセットのうち、フラッシュに書き込んでいない回数 (4バイト)
+#define RTC_BLOCK_OTA 52 // 最後に書き込んだOTAイメージのSHA-256 (36バイト, ブロック52-60)
@@ -0,0 +1,147 @@
+#include "telemetry.h"
+#include "log.h"
+#include <ESP8266WiFi.h>
+#include <WiFiUdp.h>
+#include <ArduinoJson.h>
+#include <MQTT.h>
+
+// --- 送信先の設定 ---
+// main.cppから設定を引用
+extern IPAddress telemetryHost; // MQTTブローカー / UDPコレクターのIPアドレス
+
+const uint16_t MQTT_PORT = 1883;
+const uint16_t UDP_COLLECTOR_PORT = 8089; // InfluxDBのUDPリスナーの標準ポート
+const int MQTT_QOS = 1;                   // 0: 送りっぱなし, 1: PUBACKで到達確認
+const int MQTT_KEEP_ALIVE_SEC = 60;
+const int MQTT_TIMEOUT_MS = 1000; // CONNACK / PUBACK の待ち時間
+
+// 接続を維持するため、MQTTクライアントはグローバルに保持する
+static WiFiClient mqttNet;
+static MQTTClient mqtt(256);
+static bool mqttInitialized = false;
+
+String formatReadingJson(const SensorReading &reading)
+{
+  // ArduinoJson v7以降では、サイズ指定のないJsonDocumentを使用します
+  JsonDocument doc;
+  doc["room"] = reading.room;
+  doc["temp"] = reading.temp;
+  doc["hum"] = reading.hum;
+  doc["atm"] = nullptr; // atmはnull固定
+
+  String jsonPayload;
+  serializeJson(doc, jsonPayload);
+  return jsonPayload;
+}
+
+size_t formatReadingLineProtocol(const SensorReading &reading, char *buf, size_t bufSize)
+{
+  // 例: "deskesp,room=13 temp=23.40,hum=45.00" (タイムスタンプはコレクター側で付与する)
+  int len = snprintf(buf, bufSize, "deskesp,room=%d temp=%.2f,hum=%.2f",
+                     reading.room, reading.temp, reading.hum);
+  if (len < 0)
+    return 0;
+  return (size_t)len < bufSize ? (size_t)len : bufSize - 1;
+}
+
+/**
+ * @brief MQTTブローカーへの接続を確立する (接続済みなら何もしない)
+ * @return 接続できればtrue
+ */
+static bool ensureMqttConnected()
+{
+  if (!mqttInitialized)
+  {
+    mqtt.begin(telemetryHost, MQTT_PORT, mqttNet);
+    mqtt.setKeepAlive(MQTT_KEEP_ALIVE_SEC);
+    mqtt.setTimeout(MQTT_TIMEOUT_MS);
+    mqttInitialized = true;
+  }
+
+  if (mqtt.connected())
+    return true;
+
+  char clientId[24];
+  snprintf(clientId, sizeof(clientId), "deskesp-%06x", ESP.getChipId());
+  if (!mqtt.connect(clientId))
+  {
+    LOG_W(LogTag::Telemetry, "MQTT connect to %s:%u as %s failed (err=%d, rc=%d)",
+          telemetryHost.toString().c_str(), MQTT_PORT, clientId, mqtt.lastError(), mqtt.returnCode());
+    return false;
+  }
+  LOG_I(LogTag::Telemetry, "Connected to MQTT broker %s:%u as %s", telemetryHost.toString().c_str(), MQTT_PORT, clientId);
+  return true;
+}
+
+int publishReadingMqtt(const SensorReading &reading, String &error)
+{
+  if (!ensureMqttConnected())
+  {
+    error = "MQTT connect failed";
+    return mqtt.lastError() < 0 ? mqtt.lastError() : -1;
+  }
+
+  char topic[32];
+  snprintf(topic, sizeof(topic), "deskesp/room/%d", reading.room);
+  String payload = formatReadingJson(reading);
+
+  LOG_D(LogTag::Telemetry, "Publishing to %s (QoS %d): %s", topic, MQTT_QOS, payload.c_str());
+  if (!mqtt.publish(topic, payload.c_str(), (int)payload.length(), false, MQTT_QOS))
+  {
+    error = "MQTT publish failed";
+    int err = mqtt.lastError();
+    LOG_W(LogTag::Telemetry, "%s (err=%d)", error.c_str(), err);
+    // 送信に失敗した接続は再利用せず、次回に張り直す
+    mqtt.disconnect();
+    return err < 0 ? err : -1;
+  }
+
+  error = "OK";
+  return 1;
+}
+
+int publishReadingUdp(const SensorReading &reading, String &error)
+{
+  char line[64];
+  size_t len = formatReadingLineProtocol(reading, line, sizeof(line));
+
+  LOG_D(LogTag::Telemetry, "Sending UDP line to %s:%u: %s", telemetryHost.toString().c_str(), UDP_COLLECTOR_PORT, line);
+
+  WiFiUDP udp;
+  if (!udp.beginPacket(telemetryHost, UDP_COLLECTOR_PORT))
+  {
+    error = "UDP begin failed";
+    return -1;
+  }
+  udp.write((const uint8_t *)line, len);
+  if (!udp.endPacket())
+  {
+    error = "UDP send failed";
+    return -2;
+  }
+
+  error = "OK";
+  return 1;
+}
+
+void telemetryLoop()
+{
+  // 接続中のみ処理する (再接続はpublish時に行い、loopをブロックしない)
+  if (mqttInitialized && mqtt.connected())
+  {
+    mqtt.loop();
+  }
+}
+
+const char *telemetryTransportName(TelemetryTransport transport)
+{
+  switch (transport)
+  {
+  case TelemetryTransport::Mqtt:
+    return "MQTT";
+  case TelemetryTransport::Udp:
+    return "UDP";
+  default:
+    return "POST";
+  }
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <Arduino.h>
+
+// センサーデータの送信方式
+enum class TelemetryTransport
+{
+  Http, // POST_URLへJSONをPOSTする (従来方式)
+  Mqtt, // MQTTブローカーへ常時接続でPublishする
+  Udp   // InfluxDBライン形式でUDPコレクターへ送りっぱなしにする
+};
+
+// 1回分の測定値 (各送信方式で共通に使用する)
+struct SensorReading
+{
+  int room;   // 部屋ID
+  float temp; // 温度 (℃)
+  float hum;  // 湿度 (%)
+};
+
+/**
+ * @brief 測定値をHTTP POST用のJSON文字列に変換する
+ * @param reading 測定値
+ * @return String {"room":..,"temp":..,"hum":..,"atm":null} 形式のJSON
+ */
+String formatReadingJson(const SensorReading &reading);
+
+/**
+ * @brief 測定値をInfluxDBライン形式に変換する
+ * @param reading 測定値
+ * @param buf 出力先バッファ
+ * @param bufSize バッファサイズ
+ * @return size_t 書き込んだ文字数 (NULL終端を除く)
+ */
+size_t formatReadingLineProtocol(const SensorReading &reading, char *buf, size_t bufSize);
+
+/**
+ * @brief 測定値をMQTTブローカーへPublishする。未接続の場合は接続してから送信する
+ * @param reading 測定値
+ * @param error 失敗時のエラーメッセージ (成功時は"OK")
+ * @return int 成功時は正の値、失敗時は負のエラーコード
+ */
+int publishReadingMqtt(const SensorReading &reading, String &error);
+
+/**
+ * @brief 測定値をUDPコレクターへ送信する (応答は待たない)
+ * @param reading 測定値
+ * @param error 失敗時のエラーメッセージ (成功時は"OK")
+ * @return int 成功時は正の値、失敗時は負のエラーコード
+ */
+int publishReadingUdp(const SensorReading &reading, String &error);
+
+/**
+ * @brief MQTTの常時接続を維持する (キープアライブ送信・受信処理)。loop()から毎回呼び出す
+ */
+void telemetryLoop();
+
+/**
+ * @brief 送信方式の表示名を返す
+ */
+const char *telemetryTransportName(TelemetryTransport transport);
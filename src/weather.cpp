@@ -1,28 +1,68 @@
 #include "weather.h"
 #include "secrets.h"
+#include "http_transport.h"
+#include "gzip_stream.h"
+#include "crash_log.h"
+#include "log.h"
 #include <ESP8266WiFi.h>
-#include <WiFiClientSecure.h>
 #include <ESP8266HTTPClient.h>
 #include <ArduinoJson.h>
 
-RainInfo parseYahooWeatherJson(JsonDocument &doc)
+// 1番目の地点のラベル (secrets.hで変更可能)
+#ifndef PRIMARY_LOCATION_LABEL
+#define PRIMARY_LOCATION_LABEL "Office"
+#endif
+
+// 雨雲をチェックする地点。2番目以降はsecrets.hのWEATHER_EXTRA_LOCATIONSで追加する
+static const WeatherLocation locations[] = {
+    {PRIMARY_LOCATION_LABEL, LONGITUDE, LATITUDE},
+#ifdef WEATHER_EXTRA_LOCATIONS
+    WEATHER_EXTRA_LOCATIONS
+#endif
+};
+#define LOCATION_COUNT (sizeof(locations) / sizeof(locations[0]))
+static_assert(LOCATION_COUNT <= MAX_WEATHER_LOCATIONS, "Too many weather locations");
+
+static RainTimeline locationTimelines[LOCATION_COUNT];
+
+size_t weatherLocationCount()
 {
-  RainInfo rainInfo = {false, 0, 0.0, ""};
+  return LOCATION_COUNT;
+}
+
+const WeatherLocation &weatherLocation(size_t index)
+{
+  return locations[index];
+}
+
+const RainTimeline &weatherTimeline(size_t index)
+{
+  return locationTimelines[index];
+}
 
-  JsonArray weatherList = doc["Feature"][0]["Property"]["WeatherList"]["Weather"].as<JsonArray>();
+/**
+ * @brief 1地点分のWeatherList (日時と降雨量の配列) を降水予報に変換する
+ * @param weatherList Property.WeatherList.Weather の配列
+ * @param timeline 変換結果の格納先
+ */
+static void parseWeatherList(JsonArrayConst weatherList, RainTimeline &timeline)
+{
+  memset(&timeline, 0, sizeof(timeline));
   if (weatherList.isNull() || weatherList.size() == 0)
-  {
-    rainInfo.statusMessage = "WeatherList is empty";
-    return rainInfo;
-  }
+    return;
 
   // --- デバッグ用: 受信したWeatherListをシリアルに出力 ---
-  Serial.println(F("--- Received WeatherList ---"));
-  serializeJson(doc["Feature"][0]["Property"]["WeatherList"]["Weather"], Serial);
-  Serial.println(); // 見やすいように改行を追加
-  Serial.println(F("----------------------------"));
+  // (1行に収まらないため、バッファを送り出してから直接書き込む。デバッグビルド以外では取り除かれる)
+  if constexpr (logEnabled(LogLevel::Debug))
+  {
+    logFlush();
+    Serial.println(F("--- Received WeatherList ---"));
+    serializeJson(weatherList, Serial);
+    Serial.println(); // 見やすいように改行を追加
+    Serial.println(F("----------------------------"));
+  }
 
-  Serial.println("--- Precipitation Forecast (10-60 min) ---");
+  LOG_D(LogTag::Weather, "--- Precipitation Forecast (10-60 min) ---");
   // 日付文字列(YYYYMMDDHHmm)を数値として取得し、メモリ効率を改善
   long long firstDateNum = weatherList[0]["Date"].as<long long>();
 
@@ -33,112 +73,277 @@ RainInfo parseYahooWeatherJson(JsonDocument &doc)
   int firstMinute = firstDateNum % 100;
   int firstTotalMinutes = firstHour * 60 + firstMinute;
 
-  // 最初の雨が降る時間を探す
-  for (JsonObject weather : weatherList)
+  for (JsonVariantConst weather : weatherList)
   {
     // 降水量は小数点を含むためfloatで取得する
-    float rainFall = weather["Rainfall"];
+    float rainFall = weather["Rainfall"].as<float>();
     long long currentDateNum = weather["Date"].as<long long>();
     int currentHour = (currentDateNum / 100) % 100;
     int currentMinute = currentDateNum % 100;
     int minutes = (currentHour * 60 + currentMinute) - firstTotalMinutes;
+    if (minutes < 0)
+      minutes += 24 * 60; // 日付をまたぐ場合
 
     // 10分後から60分後の予報をシリアルに出力
     if (minutes >= 10 && minutes <= 60)
     {
-      Serial.printf("  %d min later: %.2f mm/h\n", minutes, rainFall);
+      LOG_D(LogTag::Weather, "  %d min later: %.2f mm/h", minutes, rainFall);
     }
 
-    // 最初に雨が降る時間を見つける (0mmより大きい場合)
-    // まだ雨が降ると判定されていない場合のみチェック
-    if (!rainInfo.willRain && rainFall > 0)
+    int step = minutes / RAIN_TIMELINE_INTERVAL_MIN;
+    if (minutes % RAIN_TIMELINE_INTERVAL_MIN != 0 || step >= RAIN_TIMELINE_STEPS)
+      continue;
+    // APIの降水量は小数点以下2桁のため、0.01mm/h単位の整数で保持する
+    timeline.rainfall[step] = (uint16_t)constrain(lroundf(rainFall * 100), 0L, (long)UINT16_MAX);
+    if (step >= timeline.steps)
+      timeline.steps = step + 1;
+  }
+}
+
+RainInfo summarizeRainTimeline(const RainTimeline &timeline)
+{
+  RainInfo rainInfo = {false, 0, 0.0, ""};
+  if (timeline.steps == 0)
+  {
+    rainInfo.statusMessage = "WeatherList is empty";
+    return rainInfo;
+  }
+
+  // 最初に雨が降る時間を見つける (0mmより大きい場合)
+  for (uint8_t i = 0; i < timeline.steps; i++)
+  {
+    if (timeline.rainfall[i] > 0)
     {
       rainInfo.willRain = true;
-      rainInfo.minutesUntilRain = minutes;
-      rainInfo.rainfall = rainFall;
-      // break; // 最初の雨を見つけたらループを抜ける -> 全ての予報を出力するためにコメントアウト
+      rainInfo.minutesUntilRain = i * RAIN_TIMELINE_INTERVAL_MIN;
+      rainInfo.rainfall = timeline.rainfall[i] / 100.0f;
+      break;
     }
   }
   rainInfo.statusMessage = rainInfo.willRain ? "Rain approaching!" : "No rain expected.";
   return rainInfo;
 }
 
-RainInfo checkRainCloud()
+RainInfo parseYahooWeatherJson(const String &payload)
 {
-  RainInfo rainInfo = {false, 0, 0.0, ""};
-
-  HTTPClient http;
-  // WiFiClientSecureはスコープを抜けるときに自動的にリソースを解放します
-  std::unique_ptr<WiFiClientSecure> client(new WiFiClientSecure);
-
-  if (!client)
+  JsonDocument doc;
+  DeserializationError error = deserializeJson(doc, payload);
+  if (error)
   {
-    rainInfo.statusMessage = "Out of memory";
-    Serial.println(rainInfo.statusMessage);
+    RainInfo rainInfo = {false, 0, 0.0, "JSON Parse Error"};
     return rainInfo;
   }
 
-  client->setInsecure(); // 証明書の検証をスキップ
+  RainTimeline timeline;
+  parseWeatherList(doc["Feature"][0]["Property"]["WeatherList"]["Weather"].as<JsonArrayConst>(), timeline);
+  return summarizeRainTimeline(timeline);
+}
 
-  // APIエンドポイントのURLを構築
-  // Stringの連結はメモリの断片化を引き起こすため、snprintfを使用してURLを構築する
-  char url[256];
-  snprintf(url, sizeof(url),
-           "https://map.yahooapis.jp/weather/V1/place?coordinates=%s,%s&appid=%s&output=json&interval=5",
-           LONGITUDE, LATITUDE, YAHOO_APP_ID);
+size_t parseYahooWeatherStream(Stream &stream, RainTimeline *timelines, size_t maxCount)
+{
+  // Feature配列の先頭まで読み飛ばす
+  if (!stream.find("\"Feature\":["))
+    return 0;
 
-  Serial.print("Requesting URL: ");
-  Serial.println(url);
+  // 地点ごとのオブジェクトから、日時と降雨量だけを取り出す
+  JsonDocument filter;
+  filter["Property"]["WeatherList"]["Weather"][0]["Date"] = true;
+  filter["Property"]["WeatherList"]["Weather"][0]["Rainfall"] = true;
 
-  // --- DNS名前解決のテスト ---
-  IPAddress resolvedIP;
-  const char *host = "map.yahooapis.jp";
-  Serial.printf("Resolving DNS for %s... ", host);
-  if (!WiFi.hostByName(host, resolvedIP))
+  // 配列の要素を1つずつ解析し、同じJsonDocumentを使い回す
+  JsonDocument doc;
+  size_t count = 0;
+  do
   {
-    Serial.println("DNS lookup failed!");
-    rainInfo.statusMessage = "DNS lookup failed";
-    return rainInfo;
-  }
-  Serial.printf("OK. IP: %s\n", resolvedIP.toString().c_str());
+    DeserializationError error = deserializeJson(doc, stream, DeserializationOption::Filter(filter));
+    if (error)
+    {
+      LOG_W(LogTag::Weather, "Feature %u: %s", (unsigned)count, error.c_str());
+      break;
+    }
+    if (count < maxCount)
+      parseWeatherList(doc["Property"]["WeatherList"]["Weather"].as<JsonArrayConst>(), timelines[count++]);
+  } while (stream.findUntil(",", "]"));
+  return count;
+}
 
-  // --- 通信直前のシステム状態をログ出力 ---
-  Serial.printf("[Pre-GET] Free Heap: %u bytes, WiFi Status: %d, RSSI: %d dBm\n", ESP.getFreeHeap(), WiFi.status(), WiFi.RSSI());
+// gzip伸長用のスライド窓の最大・最小のサイズ (2の累乗)。
+// DEFLATEは最大32KB前までを参照し、複数地点分の応答では前の地点の繰り返しも参照されるため、空きヒープが許す限り大きく確保する
+#define INFLATE_WINDOW_MAX 32768
+#define INFLATE_WINDOW_MIN 4096
+// 窓を確保した後も残しておくヒープ (JSONの解析やTLSの受信など)
+#define INFLATE_HEAP_RESERVE 8192
+
+// 窓が小さすぎて伸長できなかった場合は、その取得を非圧縮でやり直し、以降も非圧縮で要求する
+static bool gzipEnabled = true;
+
+/**
+ * @brief 現在の空きヒープで確保できる、最も大きいスライド窓のサイズを返す
+ */
+static size_t inflateWindowSize()
+{
+  size_t size = INFLATE_WINDOW_MAX;
+  uint32_t maxBlock = ESP.getMaxFreeBlockSize();
+  while (size > INFLATE_WINDOW_MIN && size + INFLATE_HEAP_RESERVE > maxBlock)
+    size /= 2;
+  return size;
+}
+
+/**
+ * @brief gzip圧縮されたレスポンスを受信しながら伸長し、そのまま地点ごとの降水予報に変換する
+ * @param stream レスポンスボディのストリーム
+ * @param timelines 降水予報の格納先
+ * @param maxCount timelinesの要素数
+ * @return size_t 解析できた地点の数 (伸長に失敗した場合は0)
+ */
+static size_t parseGzipWeatherStream(Stream &stream, RainTimeline *timelines, size_t maxCount)
+{
+  size_t windowSize = inflateWindowSize();
+  std::unique_ptr<uint8_t[]> window(new uint8_t[windowSize]);
+  if (!window)
+    return 0;
+  // 符号表を含むため、スタックではなくヒープに確保する
+  std::unique_ptr<GzipInflateStream> inflater(new GzipInflateStream(stream, window.get(), windowSize));
+  if (!inflater)
+    return 0;
+
+  size_t count = parseYahooWeatherStream(*inflater, timelines, maxCount);
+
+  // JSONの後ろに残ったデータとgzipトレーラーまで読み、CRC32とサイズを検証する
+  while (inflater->read() >= 0)
+    ;
 
-  if (http.begin(*client, url))
+  // 圧縮の効果と伸長のコストを確認できるよう、通常のビルドでも取得ごとに出力する
+  const InflateStats &stats = inflater->stats();
+  LOG_I(LogTag::Weather, "[gzip] %u bytes -> %u bytes, inflate: %u us, window: %u bytes",
+        stats.compressedBytes, stats.decompressedBytes, stats.inflateMicros, (unsigned)windowSize);
+
+  if (!inflater->finished())
+  {
+    LOG_W(LogTag::Weather, "[gzip] Inflate failed: %s", inflater->error() ? inflater->error() : "Incomplete stream");
+    if (inflater->error() && strcmp(inflater->error(), "Distance exceeds window") == 0)
+      gzipEnabled = false;
+    return 0;
+  }
+  return count;
+}
+
+/**
+ * @brief 降水予報を1回要求し、地点ごとの降水予報 (locationTimelines) と代表地点の結果 (rainInfo) を設定する
+ * @param url リクエストURL
+ * @param rainInfo 代表地点の結果 (失敗時はstatusMessageにエラーを設定する)
+ */
+static void requestWeather(const char *url, RainInfo &rainInfo)
+{
+  // https用のクライアントは通信モジュールが保持し、keep-alive接続を次回以降も再利用する
+  HTTPClient *http = transportBegin(url);
+  if (http)
   {
-    int httpCode = http.GET();
+    // 既定のHTTP/1.1では "Accept-Encoding: identity" が付与されチャンク形式で応答されるため、
+    // HTTP/1.0で要求してgzipを受け入れる (keep-aliveは明示的に要求する)
+    http->useHTTP10(true);
+    http->setReuse(true);
+    if (gzipEnabled)
+      http->addHeader("Accept-Encoding", "gzip");
+    const char *headerKeys[] = {"Content-Encoding"};
+    http->collectHeaders(headerKeys, 1);
+
+    int httpCode = http->GET();
 
     if (httpCode > 0)
     {
       if (httpCode == HTTP_CODE_OK || httpCode == HTTP_CODE_MOVED_PERMANENTLY)
       {
-        // チャンク形式のレスポンスを確実に処理するため、一度Stringに全データを受信してから解析する。
-        String payload = http.getString();
-        JsonDocument doc;
-        DeserializationError error = deserializeJson(doc, payload);
-        if (error)
+        // レスポンス全体をバッファに溜めず、受信しながら地点ごとに解析する
+        size_t count;
+        if (http->header("Content-Encoding").equalsIgnoreCase("gzip"))
+          count = parseGzipWeatherStream(http->getStream(), locationTimelines, LOCATION_COUNT);
+        else
+          count = parseYahooWeatherStream(http->getStream(), locationTimelines, LOCATION_COUNT);
+        if (count == 0)
+        {
           rainInfo.statusMessage = "JSON Parse Error";
+        }
         else
-          rainInfo = parseYahooWeatherJson(doc);
+        {
+          if (count < LOCATION_COUNT)
+            LOG_W(LogTag::Weather, "Forecast received for %u of %u locations", (unsigned)count, (unsigned)LOCATION_COUNT);
+          for (size_t i = 1; i < count; i++)
+          {
+            RainInfo info = summarizeRainTimeline(locationTimelines[i]);
+            LOG_D(LogTag::Weather, "%s: %s (%d min, %.2f mm/h)", locations[i].label,
+                  info.statusMessage.c_str(), info.minutesUntilRain, info.rainfall);
+          }
+          rainInfo = summarizeRainTimeline(locationTimelines[0]);
+        }
       }
       else
       {
         rainInfo.statusMessage = "HTTP GET Error: " + String(httpCode);
+        crashLogSetNetError(httpCode);
       }
     }
     else
     {
       // GETリクエスト失敗時の詳細なエラーを取得
-      rainInfo.statusMessage = http.errorToString(httpCode).c_str();
+      crashLogSetNetError(httpCode);
+      rainInfo.statusMessage = http->errorToString(httpCode).c_str();
     }
-    http.end();
+    transportEnd(http);
   }
   else
   {
     rainInfo.statusMessage = "HTTP begin failed";
   }
+}
+
+RainInfo checkRainCloud()
+{
+  RainInfo rainInfo = {false, 0, 0.0, ""};
+
+  // 前回の予報が残らないよう、取得できなかった地点は空にする
+  memset(locationTimelines, 0, sizeof(locationTimelines));
+
+  // APIエンドポイントのURLを構築 (複数の地点は "経度,緯度" を空白区切りで並べ、1回で取得する)
+  // Stringの連結はメモリの断片化を引き起こすため、snprintfを使用してURLを構築する
+  char url[512];
+  size_t len = snprintf(url, sizeof(url), "https://map.yahooapis.jp/weather/V1/place?coordinates=");
+  for (size_t i = 0; i < LOCATION_COUNT && len < sizeof(url); i++)
+  {
+    len += snprintf(url + len, sizeof(url) - len, "%s%s,%s",
+                    i > 0 ? "%20" : "", locations[i].longitude, locations[i].latitude);
+  }
+  if (len < sizeof(url))
+    snprintf(url + len, sizeof(url) - len, "&appid=%s&output=json&interval=%d", YAHOO_APP_ID, RAIN_TIMELINE_INTERVAL_MIN);
+
+  LOG_D(LogTag::Weather, "Requesting URL: %s", url);
+
+  // --- DNS名前解決のテスト ---
+  IPAddress resolvedIP;
+  const char *host = "map.yahooapis.jp";
+  if (!WiFi.hostByName(host, resolvedIP))
+  {
+    LOG_E(LogTag::Weather, "DNS lookup failed for %s!", host);
+    crashLogSetNetError(NET_ERROR_DNS_LOOKUP);
+    rainInfo.statusMessage = "DNS lookup failed";
+    return rainInfo;
+  }
+  LOG_D(LogTag::Weather, "Resolved %s: %s", host, resolvedIP.toString().c_str());
+
+  // --- 通信直前のシステム状態をログ出力 ---
+  LOG_D(LogTag::Weather, "[Pre-GET] Free Heap: %u bytes, WiFi Status: %d, RSSI: %d dBm", ESP.getFreeHeap(), WiFi.status(), WiFi.RSSI());
+
+  bool usedGzip = gzipEnabled;
+  requestWeather(url, rainInfo);
+  if (usedGzip && !gzipEnabled)
+  {
+    // 伸長できなかった取得を捨てずに、非圧縮ですぐにやり直す
+    LOG_I(LogTag::Weather, "Retrying without compression...");
+    memset(locationTimelines, 0, sizeof(locationTimelines));
+    rainInfo = {false, 0, 0.0, ""};
+    requestWeather(url, rainInfo);
+  }
 
-  Serial.println(rainInfo.statusMessage);
+  LOG_I(LogTag::Weather, "%s", rainInfo.statusMessage.c_str());
   return rainInfo;
 }
\ No newline at end of file
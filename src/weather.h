@@ -2,6 +2,12 @@
 
 #include <Arduino.h>
 
+// 1回のリクエストで取得できる地点数の上限 (APIの仕様)
+#define MAX_WEATHER_LOCATIONS 10
+// 予報の間隔 (分) と、1地点あたりに保持する予報の数 (0分後〜60分後)
+#define RAIN_TIMELINE_INTERVAL_MIN 5
+#define RAIN_TIMELINE_STEPS 13
+
 // 雨雲情報の結果を格納する構造体
 struct RainInfo
 {
@@ -11,16 +17,66 @@ struct RainInfo
   String statusMessage; // API通信ステータス
 };
 
+// 雨雲をチェックする地点
+struct WeatherLocation
+{
+  const char *label; // OLEDに表示する名前
+  const char *longitude;
+  const char *latitude;
+};
+
+// 1地点分の降水予報 (RAIN_TIMELINE_INTERVAL_MIN分間隔)
+struct RainTimeline
+{
+  uint16_t rainfall[RAIN_TIMELINE_STEPS]; // 降雨量 (0.01mm/h単位)
+  uint8_t steps;                          // 有効な予報の数 (0の場合は取得できていない)
+};
+
 /**
- * @brief Yahoo!天気APIから降水情報を取得し、雨雲の接近をチェックする
- * @return RainInfo 雨雲情報の結果
+ * @brief Yahoo!天気APIから全地点の降水情報を1回のリクエストで取得し、雨雲の接近をチェックする
+ * @return RainInfo 1番目の地点 (LATITUDE/LONGITUDE) の雨雲情報の結果
  */
 RainInfo checkRainCloud();
 
-// この関数はテストから参照されるため、ヘッダーで宣言します
+/**
+ * @brief 設定されている地点の数 (1番目はLATITUDE/LONGITUDEの地点)
+ */
+size_t weatherLocationCount();
+
+/**
+ * @brief 指定した地点の設定を返す
+ * @param index 地点の番号 (0 <= index < weatherLocationCount())
+ */
+const WeatherLocation &weatherLocation(size_t index);
+
+/**
+ * @brief 直前のcheckRainCloud()で取得した、指定した地点の降水予報を返す
+ * @param index 地点の番号 (0 <= index < weatherLocationCount())
+ */
+const RainTimeline &weatherTimeline(size_t index);
+
+/**
+ * @brief 降水予報から、最初に雨が降る時間と降雨量を求める
+ * @param timeline 1地点分の降水予報
+ * @return RainInfo 雨雲情報の結果
+ */
+RainInfo summarizeRainTimeline(const RainTimeline &timeline);
+
+// 以下の関数はテストから参照されるため、ヘッダーで宣言します
 /**
  * @brief Yahoo!天気APIのJSONペイロードを解釈して雨雲情報を生成する
  * @param payload APIから取得したJSON文字列
- * @return RainInfo 雨雲情報の結果
+ * @return RainInfo 1番目の地点の雨雲情報の結果
+ */
+RainInfo parseYahooWeatherJson(const String &payload);
+
+/**
+ * @brief Yahoo!天気APIのレスポンスを受信しながら、地点 (Feature) ごとに1つずつ解析して降水予報に変換する
+ *
+ * レスポンス全体をJsonDocumentに展開せず、地点1つ分の予報 (日時と降雨量のみ) だけをメモリに置く。
+ * @param stream レスポンスボディのストリーム
+ * @param timelines 降水予報の格納先 (リクエストした地点の順)
+ * @param maxCount timelinesの要素数
+ * @return size_t 解析できた地点の数
  */
-RainInfo parseYahooWeatherJson(const String &payload);
\ No newline at end of file
+size_t parseYahooWeatherStream(Stream &stream, RainTimeline *timelines, size_t maxCount);
@@ -1,89 +1,314 @@
-#include "wifi_handler.h"
-#include <ESP8266WiFi.h>
-#include "secrets.h" // ssid, password
-
-// --- 静的IPアドレスの設定 ---
-// main.cppから設定を引用
-extern IPAddress local_IP;
-extern IPAddress gateway;
-extern IPAddress subnet;
-extern IPAddress primaryDNS;
-extern IPAddress secondaryDNS;
-
-bool ensureWiFiConnected(Adafruit_SSD1306 *display)
-{
-    if (WiFi.status() == WL_CONNECTED)
-    {
-        // DNS解決失敗からの回復を試みるため、接続済みの場合でもDNSサーバーを再設定する。
-        // これにより、長時間稼働中にDNS設定が失われる問題に対処する。
-        if (!WiFi.config(local_IP, gateway, subnet, primaryDNS, secondaryDNS))
-        {
-            Serial.println("STA Failed to re-configure DNS");
-        }
-        return true; // すでに接続済み
-    }
-
-    Serial.println("WiFi disconnected. Reconnecting...");
-    if (display)
-    {
-        display->clearDisplay();
-        display->setTextSize(1);
-        display->setTextColor(SSD1306_WHITE);
-        display->setCursor(0, 28);
-        display->print("Reconnecting WiFi...");
-        display->display();
-    }
-
-    // 静的IPアドレスを再設定
-    if (!WiFi.config(local_IP, gateway, subnet, primaryDNS, secondaryDNS))
-    {
-        Serial.println("STA Failed to configure");
-    }
-
-    WiFi.begin(ssid, password);
-
-    unsigned long startTime = millis();
-    // 最大15秒間、再接続を試みる
-    while (WiFi.status() != WL_CONNECTED && millis() - startTime < 15000)
-    {
-        Serial.print(".");
-        if (display)
-        {
-            display->print(".");
-            display->display();
-        }
-        // delay()はバックグラウンド処理をブロックするため、短いdelayとyield()を組み合わせる
-        for (int i = 0; i < 50; i++)
-        {
-            delay(10);
-            yield();
-        }
-    }
-
-    if (WiFi.status() == WL_CONNECTED)
-    {
-        Serial.println("\nWiFi reconnected!");
-        return true;
-    }
-
-    Serial.println("\nFailed to reconnect WiFi.");
-    return false;
-}
-
-/**
- * @brief WiFiを強制的に切断し、再接続を試みる。DNS障害などからの回復に使用する。
- *
- * @param display OLEDディスプレイのポインタ
- * @return bool 再接続に成功した場合はtrue
- */
-bool forceWiFiReconnect(Adafruit_SSD1306 *display)
-{
-    Serial.println("\n--- Forcing WiFi Reconnection ---");
-    WiFi.disconnect(); // ネットワークスタックをリセットするために、まず切断する
-    for (int i = 0; i < 10; i++)
-    { // 切断処理を待つ
-        delay(100);
-        yield();
-    }
-    return ensureWiFiConnected(display); // 通常の再接続処理を呼び出す
+#include "wifi_handler.h"
+#include "display_flush.h"
+#include "crash_log.h"
+#include "loop_monitor.h"
+#include "rtc_layout.h"
+#include "log.h"
+#include <ESP8266WiFi.h>
+#include <bearssl/bearssl_hmac.h>
+#include "secrets.h" // ssid, password
+
+// --- 静的IPアドレスの設定 ---
+// main.cppから設定を引用
+extern IPAddress local_IP;
+extern IPAddress gateway;
+extern IPAddress subnet;
+extern IPAddress primaryDNS;
+extern IPAddress secondaryDNS;
+
+#define WIFI_CACHE_MAGIC 0x57464331 // "WFC1"
+// 接続を待つ時間の上限 (スキャンを含む全体)
+#define WIFI_CONNECT_TIMEOUT_MS 15000
+// キャッシュしたBSSID/チャンネルで接続を試みる時間。これを過ぎたらスキャンに切り替える
+#define FAST_CONNECT_TIMEOUT_MS 2000
+// PSKの導出 (PBKDF2-HMAC-SHA1) の反復回数と長さ (WPA2-PSKの仕様)
+#define PSK_ITERATIONS 4096
+#define PSK_LENGTH 32
+
+// 前回接続したアクセスポイントの情報 (RTCメモリに保持し、再接続・再起動時のスキャンを省略する)
+struct RtcWiFiCache
+{
+    uint32_t magic;
+    uint8_t bssid[6];
+    uint8_t channel;          // 0の場合はBSSID/チャンネルが無効 (直接接続に失敗した)
+    uint8_t pskValid;         // pskが導出済みか
+    uint8_t psk[PSK_LENGTH];  // パスフレーズから導出したPSK (WiFi.begin()に渡すとSDK内での導出を省略できる)
+    uint16_t credentials;     // SSIDとパスワードのチェックサム (変更されたらキャッシュを破棄する)
+    uint16_t checksum;
+};
+
+static RtcWiFiCache cache;
+static WiFiConnectStats stats;
+
+static uint16_t checksumBytes(uint16_t sum, const uint8_t *p, size_t len)
+{
+    for (size_t i = 0; i < len; i++)
+        sum = (sum << 1 | sum >> 15) ^ p[i];
+    return sum;
+}
+
+static uint16_t credentialsChecksum()
+{
+    uint16_t sum = checksumBytes(0, (const uint8_t *)ssid, strlen(ssid) + 1);
+    return checksumBytes(sum, (const uint8_t *)password, strlen(password));
+}
+
+static uint16_t cacheChecksum(const RtcWiFiCache &c)
+{
+    return checksumBytes(0, (const uint8_t *)&c, offsetof(RtcWiFiCache, checksum));
+}
+
+/**
+ * @brief RTCメモリからキャッシュを読み出す。壊れているか、SSID/パスワードが変更されていれば破棄する
+ */
+static void loadCache()
+{
+    ESP.rtcUserMemoryRead(RTC_BLOCK_WIFI_CACHE, (uint32_t *)&cache, sizeof(cache));
+    if (cache.magic != WIFI_CACHE_MAGIC || cache.checksum != cacheChecksum(cache) ||
+        cache.credentials != credentialsChecksum())
+    {
+        memset(&cache, 0, sizeof(cache));
+    }
+}
+
+static void saveCache()
+{
+    cache.magic = WIFI_CACHE_MAGIC;
+    cache.credentials = credentialsChecksum();
+    cache.checksum = cacheChecksum(cache);
+    ESP.rtcUserMemoryWrite(RTC_BLOCK_WIFI_CACHE, (uint32_t *)&cache, sizeof(cache));
+}
+
+/**
+ * @brief パスフレーズとSSIDからPSKを導出する (PBKDF2-HMAC-SHA1, 4096回)
+ *
+ * 数百msかかるため、一定の反復ごとにyieldしてWDTリセットを防ぐ。
+ */
+static void derivePsk(uint8_t *psk)
+{
+    br_hmac_key_context key;
+    br_hmac_key_init(&key, &br_sha1_vtable, password, strlen(password));
+
+    for (uint8_t block = 1; block * br_sha1_SIZE < PSK_LENGTH + br_sha1_SIZE; block++)
+    {
+        uint8_t u[br_sha1_SIZE];
+        uint8_t t[br_sha1_SIZE];
+        const uint8_t counter[4] = {0, 0, 0, block};
+        br_hmac_context hmac;
+        br_hmac_init(&hmac, &key, 0);
+        br_hmac_update(&hmac, ssid, strlen(ssid));
+        br_hmac_update(&hmac, counter, sizeof(counter));
+        br_hmac_out(&hmac, u);
+        memcpy(t, u, sizeof(t));
+
+        for (int i = 1; i < PSK_ITERATIONS; i++)
+        {
+            br_hmac_init(&hmac, &key, 0);
+            br_hmac_update(&hmac, u, sizeof(u));
+            br_hmac_out(&hmac, u);
+            for (size_t j = 0; j < sizeof(t); j++)
+                t[j] ^= u[j];
+            if ((i & 0xFF) == 0)
+                loopMonitorYield();
+        }
+
+        size_t offset = (block - 1) * br_sha1_SIZE;
+        memcpy(psk + offset, t, min((size_t)br_sha1_SIZE, (size_t)PSK_LENGTH - offset));
+    }
+}
+
+/**
+ * @brief WiFi.begin()に渡す鍵を返す。導出済みのPSKがあれば16進数64文字に変換して渡す
+ */
+static const char *connectKey(char *hex)
+{
+    if (!cache.pskValid)
+        return password;
+    for (size_t i = 0; i < PSK_LENGTH; i++)
+        sprintf(&hex[i * 2], "%02x", cache.psk[i]);
+    return hex;
+}
+
+/**
+ * @brief 接続が完了するか、startTimeからtimeoutMsが経過するまで待つ
+ */
+static bool waitForConnection(Adafruit_SSD1306 *display, unsigned long startTime, unsigned long timeoutMs)
+{
+    unsigned long lastDot = startTime;
+    while (WiFi.status() != WL_CONNECTED)
+    {
+        if (millis() - startTime >= timeoutMs)
+            return false;
+        if (display && millis() - lastDot >= 500)
+        {
+            display->print(".");
+            display->display();
+            lastDot += 500;
+        }
+        // delay()はバックグラウンド処理をブロックするため、短いdelayとyield()を組み合わせる
+        delay(10);
+        logDrain(); // 待ち時間の間にログを送り出す
+        loopMonitorYield();
+    }
+    return true;
+}
+
+/**
+ * @brief 接続したアクセスポイントのBSSID/チャンネルをキャッシュし、PSKが未導出なら導出する
+ */
+static void updateCache()
+{
+    bool changed = false;
+    int32_t channel = WiFi.channel();
+    if (cache.channel != channel || memcmp(cache.bssid, WiFi.BSSID(), sizeof(cache.bssid)) != 0)
+    {
+        memcpy(cache.bssid, WiFi.BSSID(), sizeof(cache.bssid));
+        cache.channel = channel;
+        changed = true;
+    }
+    // 8-63文字のパスフレーズの場合のみ導出する (64文字は16進数のPSKそのもの)
+    size_t passLength = strlen(password);
+    if (!cache.pskValid && passLength >= 8 && passLength <= 63)
+    {
+        unsigned long startTime = millis();
+        derivePsk(cache.psk);
+        cache.pskValid = 1;
+        changed = true;
+        LOG_I(LogTag::WiFi, "PSK derived in %lu ms", millis() - startTime);
+    }
+    if (changed)
+    {
+        saveCache();
+    }
+}
+
+bool ensureWiFiConnected(Adafruit_SSD1306 *display)
+{
+    if (WiFi.status() == WL_CONNECTED)
+    {
+        // DNS解決失敗からの回復を試みるため、接続済みの場合でもDNSサーバーを再設定する。
+        // これにより、長時間稼働中にDNS設定が失われる問題に対処する。
+        if (!WiFi.config(local_IP, gateway, subnet, primaryDNS, secondaryDNS))
+        {
+            LOG_EVERY(60000, LogLevel::Warn, LogTag::WiFi, "STA Failed to re-configure DNS");
+        }
+        return true; // すでに接続済み
+    }
+
+    LOG_W(LogTag::WiFi, "WiFi disconnected. Reconnecting...");
+    Subsystem previousSubsystem = crashLogSetSubsystem(Subsystem::WiFiReconnect);
+    if (display)
+    {
+        display->clearDisplay();
+        display->setTextSize(1);
+        display->setTextColor(SSD1306_WHITE);
+        display->setCursor(0, 28);
+        display->print("Reconnecting WiFi...");
+        display->display();
+    }
+
+    // 静的IPアドレスを再設定
+    if (!WiFi.config(local_IP, gateway, subnet, primaryDNS, secondaryDNS))
+    {
+        LOG_W(LogTag::WiFi, "STA Failed to configure");
+    }
+
+    // 接続情報はRTCメモリにキャッシュしているため、SDKによるフラッシュへの設定保存を無効にする。
+    // 有効のままだと再接続のたびにフラッシュのセクタが書き換えられる。
+    WiFi.persistent(false);
+
+    loadCache();
+    char pskHex[PSK_LENGTH * 2 + 1];
+    const char *key = connectKey(pskHex);
+    unsigned long startTime = millis();
+    bool fast = cache.channel != 0;
+    bool connected = false;
+
+    // キャッシュしたBSSID/チャンネルがあれば、スキャンせずに直接接続する
+    if (fast)
+    {
+        WiFi.begin(ssid, key, cache.channel, cache.bssid);
+        connected = waitForConnection(display, startTime, FAST_CONNECT_TIMEOUT_MS);
+        if (!connected)
+        {
+            // アクセスポイントのチャンネル変更や交換の可能性があるため、キャッシュを無効にしてスキャンする
+            LOG_W(LogTag::WiFi, "Cached BSSID/channel %u failed, scanning", cache.channel);
+            stats.fastFailures++;
+            fast = false;
+            cache.channel = 0;
+            saveCache();
+            WiFi.disconnect();
+        }
+    }
+
+    // 最大15秒間 (直接接続を試みた時間を含む)、再接続を試みる
+    if (!connected)
+    {
+        WiFi.begin(ssid, key);
+        connected = waitForConnection(display, startTime, WIFI_CONNECT_TIMEOUT_MS);
+    }
+
+    if (connected)
+    {
+        stats.lastConnectMs = millis() - startTime;
+        stats.lastFast = fast;
+        if (fast)
+            stats.fastConnects++;
+        else
+            stats.scanConnects++;
+        LOG_I(LogTag::WiFi, "WiFi connected in %lu ms (%s)", (unsigned long)stats.lastConnectMs,
+              fast ? "cached BSSID/channel" : "scan");
+        updateCache();
+    }
+
+    // 再接続中の表示はdisplay()で直接描画したため、次のフレームは全面転送する
+    if (display)
+    {
+        displayFlushInvalidate();
+    }
+
+    crashLogSetSubsystem(previousSubsystem);
+
+    if (connected)
+    {
+        return true;
+    }
+
+    LOG_E(LogTag::WiFi, "Failed to reconnect WiFi.");
+    return false;
+}
+
+const WiFiConnectStats &wifiConnectStats()
+{
+    return stats;
+}
+
+void wifiConnectDump(Print &out)
+{
+    out.printf("--- WiFi connect (last %u ms, %s) ---\n", (unsigned)stats.lastConnectMs,
+               stats.lastFast ? "cached" : "scan");
+    out.printf("  cached: %u, scan: %u, cached failed: %u\n", stats.fastConnects, stats.scanConnects,
+               stats.fastFailures);
+    out.printf("  cache: bssid %02X:%02X:%02X:%02X:%02X:%02X ch %u, psk %s\n", cache.bssid[0], cache.bssid[1],
+               cache.bssid[2], cache.bssid[3], cache.bssid[4], cache.bssid[5], cache.channel,
+               cache.pskValid ? "derived" : "-");
+    out.println(F("------------------------------"));
+}
+
+/**
+ * @brief WiFiを強制的に切断し、再接続を試みる。DNS障害などからの回復に使用する。
+ *
+ * @param display OLEDディスプレイのポインタ
+ * @return bool 再接続に成功した場合はtrue
+ */
+bool forceWiFiReconnect(Adafruit_SSD1306 *display)
+{
+    LOG_W(LogTag::WiFi, "--- Forcing WiFi Reconnection ---");
+    WiFi.disconnect(); // ネットワークスタックをリセットするために、まず切断する
+    for (int i = 0; i < 10; i++)
+    { // 切断処理を待つ
+        delay(100);
+        yield();
+    }
+    return ensureWiFiConnected(display); // 通常の再接続処理を呼び出す
 }
\ No newline at end of file
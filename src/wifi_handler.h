@@ -2,10 +2,34 @@
 
 #include <Adafruit_SSD1306.h>
 
+// WiFi接続にかかった時間の統計
+struct WiFiConnectStats
+{
+    uint32_t lastConnectMs; // 直近の接続にかかった時間 (WiFi.begin()から接続完了まで)
+    bool lastFast;          // 直近の接続がキャッシュしたBSSID/チャンネルによる高速接続だったか
+    uint16_t fastConnects;  // キャッシュを使って接続できた回数
+    uint16_t scanConnects;  // スキャンして接続した回数
+    uint16_t fastFailures;  // キャッシュでの接続に失敗し、スキャンに切り替えた回数
+};
+
 /**
  * @brief WiFi接続を確実にし、切断されている場合は再接続を試みる
  *
+ * RTCメモリにキャッシュしたアクセスポイントのBSSID・チャンネル (とPSK) があれば、
+ * スキャンを省略して直接接続し、失敗した場合のみスキャンして接続する。
+ *
  * @param display OLEDディスプレイのオブジェクトへのポインタ
  * @return bool 接続が確立されればtrue、失敗すればfalse
  */
-bool ensureWiFiConnected(Adafruit_SSD1306 *display);
\ No newline at end of file
+bool ensureWiFiConnected(Adafruit_SSD1306 *display);
+
+/**
+ * @brief WiFi接続にかかった時間の統計を返す
+ */
+const WiFiConnectStats &wifiConnectStats();
+
+/**
+ * @brief WiFi接続の統計とキャッシュの状態を出力する
+ * @param out 出力先 (Serialなど)
+ */
+void wifiConnectDump(Print &out);
\ No newline at end of file
@@ -1,6 +1,16 @@
 #include "wol.h"
+#include "log.h"
 #include <ESP8266WiFi.h>
 #include <WiFiUdp.h>
+#include "secrets.h" // MAC_ADDRESS, WOL_EXTRA_TARGETS (任意)
+
+#ifdef WOL_EXTRA_TARGETS
+static const char* const extraTargets[] = {WOL_EXTRA_TARGETS};
+static const size_t EXTRA_TARGET_COUNT = sizeof(extraTargets) / sizeof(extraTargets[0]);
+#else
+static const char* const* extraTargets = nullptr;
+static const size_t EXTRA_TARGET_COUNT = 0;
+#endif
 
 /**
  * @brief MACアドレス文字列をバイト配列に変換する
@@ -28,7 +38,7 @@ void sendWolPacket(const char* macAddress) {
     byte targetMac[6];
 
     if (!macStringToBytes(macAddress, targetMac)) {
-        Serial.println(F("Invalid MAC address format."));
+        LOG_E(LogTag::Main, "Invalid MAC address format.");
         return;
     }
 
@@ -54,5 +64,16 @@ void sendWolPacket(const char* macAddress) {
         udp.endPacket();
         delay(100); // パケット間に少し待機
     }
-    Serial.println(F("WoL packet sent 3 times."));
+    LOG_I(LogTag::Main, "WoL packet sent 3 times.");
+}
+
+size_t wolTargetCount() {
+    return 1 + EXTRA_TARGET_COUNT;
+}
+
+const char* wolTarget(size_t index) {
+    if (index == 0 || index > EXTRA_TARGET_COUNT) {
+        return MAC_ADDRESS;
+    }
+    return extraTargets[index - 1];
 }
\ No newline at end of file
@@ -4,4 +4,10 @@
 
 // Wake-on-LANのマジックパケットを送信する
 // macAddress: ターゲットPCのMACアドレス文字列 (例: "AA:BB:CC:DD:EE:FF")
-void sendWolPacket(const char* macAddress);
\ No newline at end of file
+void sendWolPacket(const char* macAddress);
+
+// WoLの送信先の数 (secrets.hのMAC_ADDRESSとWOL_EXTRA_TARGETS)
+size_t wolTargetCount();
+
+// index番目の送信先のMACアドレス文字列 (0はMAC_ADDRESS)
+const char* wolTarget(size_t index);
\ No newline at end of file
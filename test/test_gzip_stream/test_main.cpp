@@ -0,0 +1,101 @@
+#include <Arduino.h>
+#include <unity.h>
+#include <ArduinoJson.h>
+#include "gzip_stream.h" // テスト対象のクラスをインクルード
+
+// テスト対象のクラスは `src/gzip_stream.cpp` にありますが、テスト実行時にはデフォルトでコンパイルされません。
+// .cppファイルを直接インクルードすることで、そのコードをテストビルドで利用可能にします。
+#include "../../src/gzip_stream.cpp"
+
+// 3件目の予報で雨が降るJSONをgzip圧縮したデータ (python: gzip.compress(json, 9, mtime=0))
+static const char EXPECTED_JSON[] = "{\"Feature\":[{\"Property\":{\"WeatherList\":{\"Weather\":[{\"Date\":\"202310271000\",\"Rainfall\":0},{\"Date\":\"202310271005\",\"Rainfall\":0},{\"Date\":\"202310271010\",\"Rainfall\":5}]}}}]}";
+static const uint8_t GZIP_JSON[] = {
+    0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0xab, 0x56, 0x72, 0x4b, 0x4d, 0x2c,
+    0x29, 0x2d, 0x4a, 0x55, 0xb2, 0x8a, 0xae, 0x56, 0x0a, 0x28, 0xca, 0x2f, 0x48, 0x2d, 0x2a, 0xa9,
+    0x54, 0xb2, 0xaa, 0x56, 0x0a, 0x07, 0x8a, 0x67, 0xa4, 0x16, 0xf9, 0x64, 0x16, 0x97, 0x20, 0x71,
+    0xc1, 0xca, 0x5c, 0x12, 0x4b, 0x80, 0xea, 0x95, 0x8c, 0x0c, 0x8c, 0x8c, 0x0d, 0x0d, 0x8c, 0xcc,
+    0x0d, 0x0d, 0x0c, 0x0c, 0x94, 0x74, 0x94, 0x82, 0x12, 0x33, 0xf3, 0xd2, 0x12, 0x73, 0x72, 0x94,
+    0xac, 0x0c, 0x6a, 0x75, 0xb0, 0x29, 0x32, 0x25, 0x42, 0x91, 0x21, 0xaa, 0x49, 0xa6, 0xb5, 0xb1,
+    0xb5, 0xb5, 0x40, 0x0c, 0x00, 0x7b, 0xd7, 0x94, 0xc7, 0xa7, 0x00, 0x00, 0x00};
+
+// メモリ上のバイト列を読み出すだけのStream
+class MemoryStream : public Stream
+{
+public:
+    MemoryStream(const uint8_t *data, size_t size) : _data(data), _size(size) {}
+    int available() override { return _size - _pos; }
+    int read() override { return _pos < _size ? _data[_pos++] : -1; }
+    int peek() override { return _pos < _size ? _data[_pos] : -1; }
+    size_t write(uint8_t) override { return 0; }
+
+private:
+    const uint8_t *_data;
+    size_t _size;
+    size_t _pos = 0;
+};
+
+static uint8_t window[256];
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_inflate_matches_original(void)
+{
+    MemoryStream source(GZIP_JSON, sizeof(GZIP_JSON));
+    source.setTimeout(0);
+    GzipInflateStream inflater(source, window, sizeof(window));
+
+    String out;
+    int c;
+    while ((c = inflater.read()) >= 0)
+        out += (char)c;
+
+    TEST_ASSERT_TRUE(inflater.finished());
+    TEST_ASSERT_EQUAL_STRING(EXPECTED_JSON, out.c_str());
+    TEST_ASSERT_EQUAL(sizeof(GZIP_JSON), inflater.stats().compressedBytes);
+    TEST_ASSERT_EQUAL(strlen(EXPECTED_JSON), inflater.stats().decompressedBytes);
+}
+
+void test_inflate_feeds_json_parser(void)
+{
+    MemoryStream source(GZIP_JSON, sizeof(GZIP_JSON));
+    source.setTimeout(0);
+    GzipInflateStream inflater(source, window, sizeof(window));
+
+    JsonDocument doc;
+    DeserializationError error = deserializeJson(doc, inflater);
+    TEST_ASSERT_FALSE(error);
+    TEST_ASSERT_EQUAL(5, doc["Feature"][0]["Property"]["WeatherList"]["Weather"][2]["Rainfall"].as<int>());
+}
+
+void test_inflate_detects_truncated_stream(void)
+{
+    // トレーラー (CRC32とサイズ) が欠けたデータ
+    MemoryStream source(GZIP_JSON, sizeof(GZIP_JSON) - 4);
+    source.setTimeout(0);
+    GzipInflateStream inflater(source, window, sizeof(window));
+
+    while (inflater.read() >= 0)
+        ;
+
+    TEST_ASSERT_FALSE(inflater.finished());
+    TEST_ASSERT_NOT_NULL(inflater.error());
+}
+
+void setup()
+{
+    // NOTE!!! Wait for >2 secs
+    // if board doesn't support software reset via Serial.DTR/RTS
+    delay(2000);
+
+    UNITY_BEGIN();
+    RUN_TEST(test_inflate_matches_original);
+    RUN_TEST(test_inflate_feeds_json_parser);
+    RUN_TEST(test_inflate_detects_truncated_stream);
+    UNITY_END();
+}
+
+void loop()
+{
+    // Do nothing
+}
@@ -0,0 +1,130 @@
+#include <Arduino.h>
+#include <unity.h>
+#include "history.h"
+
+// テスト対象の関数は `src/history.cpp` にありますが、テスト実行時にはデフォルトでコンパイルされません。
+// .cppファイルを直接インクルードすることで、そのコードをテストビルドで利用可能にします。
+#include "../../src/history.cpp"
+
+// 2026-06-01 00:00:00 UTC (1時間の区切り)
+#define BASE_EPOCH 1780272000UL
+
+// 出力をStringに集めるPrint
+class StringPrint : public Print
+{
+public:
+    size_t write(uint8_t c) override
+    {
+        text += (char)c;
+        return 1;
+    }
+    String text;
+};
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_history_ignores_unsynced_time(void)
+{
+    // NTPの同期前 (起動からの秒数) は記録しない
+    historyAdd(120, 20.0f, 50.0f);
+    historyAdd(300, 20.0f, 50.0f);
+
+    HistoryRow row;
+    TEST_ASSERT_FALSE(historyGet(HistoryTier::Minute, 0, row));
+}
+
+void test_history_rolls_up_minutes_into_ten_minutes(void)
+{
+    // 0-9分目: 温度は 20.00, 20.10, ..., 20.90 (1分の中では2回測定し、その平均)
+    for (uint32_t minute = 0; minute < 10; minute++)
+    {
+        float temp = 20.0f + minute * 0.1f;
+        historyAdd(BASE_EPOCH + minute * 60, temp - 0.05f, 40.0f);
+        historyAdd(BASE_EPOCH + minute * 60 + 30, temp + 0.05f, 60.0f);
+    }
+    // 10分目の最初の測定で、9分目が確定し、10分ごとの区間も確定する
+    historyAdd(BASE_EPOCH + 600, 25.0f, 50.0f);
+
+    HistoryRow row;
+    TEST_ASSERT_TRUE(historyGet(HistoryTier::Minute, 0, row));
+    TEST_ASSERT_EQUAL_UINT32(BASE_EPOCH + 540, row.time);
+    TEST_ASSERT_EQUAL_INT16(2090, row.stat[0].avg);
+    TEST_ASSERT_EQUAL_INT16(5000, row.stat[1].avg);
+
+    TEST_ASSERT_TRUE(historyGet(HistoryTier::TenMinutes, 0, row));
+    TEST_ASSERT_EQUAL_UINT32(BASE_EPOCH, row.time);
+    TEST_ASSERT_EQUAL_INT16(1995, row.stat[0].min); // 1分の中の最小値
+    TEST_ASSERT_EQUAL_INT16(2045, row.stat[0].avg); // 1分ごとの平均値の平均
+    TEST_ASSERT_EQUAL_INT16(2095, row.stat[0].max);
+    TEST_ASSERT_EQUAL_INT16(4000, row.stat[1].min);
+    TEST_ASSERT_EQUAL_INT16(6000, row.stat[1].max);
+
+    // 1時間の区間はまだ終わっていない
+    TEST_ASSERT_FALSE(historyGet(HistoryTier::Hour, 0, row));
+}
+
+void test_history_marks_gaps_as_no_data(void)
+{
+    // 10分目の次は13分目 (11, 12分目は測定なし)
+    historyAdd(BASE_EPOCH + 13 * 60, 21.0f, 50.0f);
+    historyAdd(BASE_EPOCH + 14 * 60, 21.0f, 50.0f);
+
+    HistoryRow row;
+    TEST_ASSERT_TRUE(historyGet(HistoryTier::Minute, 0, row));
+    TEST_ASSERT_EQUAL_UINT32(BASE_EPOCH + 13 * 60, row.time);
+    TEST_ASSERT_FALSE(historyGet(HistoryTier::Minute, 1, row));
+    TEST_ASSERT_EQUAL_UINT32(BASE_EPOCH + 12 * 60, row.time);
+    TEST_ASSERT_FALSE(historyGet(HistoryTier::Minute, 2, row));
+    TEST_ASSERT_TRUE(historyGet(HistoryTier::Minute, 3, row));
+    TEST_ASSERT_EQUAL_INT16(2500, row.stat[0].avg);
+}
+
+void test_history_rolls_up_hours(void)
+{
+    // 1時間の最後の10分間の区間が確定した時点で、1時間の区間も確定する
+    for (uint32_t minute = 15; minute <= 60; minute++)
+        historyAdd(BASE_EPOCH + minute * 60, 22.0f, 50.0f);
+
+    HistoryRow row;
+    TEST_ASSERT_TRUE(historyGet(HistoryTier::Hour, 0, row));
+    TEST_ASSERT_EQUAL_UINT32(BASE_EPOCH, row.time);
+    TEST_ASSERT_EQUAL_INT16(1995, row.stat[0].min);
+    TEST_ASSERT_EQUAL_INT16(2500, row.stat[0].max);
+}
+
+void test_history_writes_range_as_json(void)
+{
+    StringPrint out;
+    size_t rows = historyWriteJson(out, HistoryTier::TenMinutes, BASE_EPOCH + 600, BASE_EPOCH + 1200);
+    TEST_ASSERT_EQUAL(2, rows);
+    TEST_ASSERT_EQUAL_STRING("{\"tier\":\"10m\",\"interval\":600,\"scale\":100,\"rows\":["
+                             "[1780272600,2100,2213,2500,5000,5000,5000],"
+                             "[1780273200,2200,2200,2200,5000,5000,5000]]}",
+                             out.text.c_str());
+
+    HistoryTier tier;
+    TEST_ASSERT_TRUE(historyParseTier("1h", tier));
+    TEST_ASSERT_TRUE(tier == HistoryTier::Hour);
+    TEST_ASSERT_FALSE(historyParseTier("5m", tier));
+}
+
+void setup()
+{
+    // NOTE!!! Wait for >2 secs
+    // if board doesn't support software reset via Serial.DTR/RTS
+    delay(2000);
+
+    UNITY_BEGIN();
+    RUN_TEST(test_history_ignores_unsynced_time);
+    RUN_TEST(test_history_rolls_up_minutes_into_ten_minutes);
+    RUN_TEST(test_history_marks_gaps_as_no_data);
+    RUN_TEST(test_history_rolls_up_hours);
+    RUN_TEST(test_history_writes_range_as_json);
+    UNITY_END();
+}
+
+void loop()
+{
+    // Do nothing
+}
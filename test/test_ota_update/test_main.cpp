@@ -0,0 +1,90 @@
+#include <Arduino.h>
+#include <unity.h>
+#include "ota_update.h"
+
+// テスト対象の関数は `src/ota_update.cpp` にありますが、テスト実行時にはデフォルトでコンパイルされません。
+// .cppファイルを直接インクルードすることで、そのコードをテストビルドで利用可能にします。
+#include "../../src/ota_update.cpp"
+#include "../../src/crash_log.cpp"
+#include "../../src/log.cpp"
+
+// OTA_HOLD_BACK (16) バイトを保持すると、先頭の84バイトまで書き込める
+#define IMAGE_SIZE 100
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_writes_chunks_before_tail(void)
+{
+    uint32_t tailOffset;
+    TEST_ASSERT_EQUAL_UINT32(50, otaWritableBytes(0, 50, IMAGE_SIZE, tailOffset));
+    TEST_ASSERT_EQUAL_UINT32(0, tailOffset);
+    // 書き込める範囲の最後のバイトで終わるチャンク
+    TEST_ASSERT_EQUAL_UINT32(34, otaWritableBytes(50, 34, IMAGE_SIZE, tailOffset));
+    TEST_ASSERT_EQUAL_UINT32(0, tailOffset);
+}
+
+void test_splits_chunk_across_tail(void)
+{
+    uint32_t tailOffset;
+    TEST_ASSERT_EQUAL_UINT32(4, otaWritableBytes(80, 10, IMAGE_SIZE, tailOffset));
+    TEST_ASSERT_EQUAL_UINT32(0, tailOffset);
+
+    // イメージ全体が1つのチャンクで届いた場合
+    TEST_ASSERT_EQUAL_UINT32(IMAGE_SIZE - OTA_HOLD_BACK, otaWritableBytes(0, IMAGE_SIZE, IMAGE_SIZE, tailOffset));
+    TEST_ASSERT_EQUAL_UINT32(0, tailOffset);
+}
+
+void test_holds_back_chunks_inside_tail(void)
+{
+    uint32_t tailOffset;
+    TEST_ASSERT_EQUAL_UINT32(0, otaWritableBytes(84, 10, IMAGE_SIZE, tailOffset));
+    TEST_ASSERT_EQUAL_UINT32(0, tailOffset);
+    TEST_ASSERT_EQUAL_UINT32(0, otaWritableBytes(94, 6, IMAGE_SIZE, tailOffset));
+    TEST_ASSERT_EQUAL_UINT32(10, tailOffset);
+}
+
+void test_reassembles_image_from_any_chunk_size(void)
+{
+    uint8_t image[IMAGE_SIZE];
+    for (size_t i = 0; i < sizeof(image); i++)
+        image[i] = (uint8_t)(i * 7 + 3);
+
+    for (size_t chunkSize = 1; chunkSize <= 33; chunkSize++)
+    {
+        uint8_t written[IMAGE_SIZE];
+        uint8_t held[OTA_HOLD_BACK];
+        size_t writtenLength = 0;
+        uint32_t received = 0;
+        while (received < IMAGE_SIZE)
+        {
+            size_t n = min((uint32_t)chunkSize, IMAGE_SIZE - received);
+            uint32_t tailOffset;
+            size_t writable = otaWritableBytes(received, n, IMAGE_SIZE, tailOffset);
+            memcpy(written + writtenLength, image + received, writable);
+            writtenLength += writable;
+            if (writable < n)
+                memcpy(held + tailOffset, image + received + writable, n - writable);
+            received += n;
+        }
+        TEST_ASSERT_EQUAL_UINT32(IMAGE_SIZE - OTA_HOLD_BACK, writtenLength);
+        memcpy(written + writtenLength, held, OTA_HOLD_BACK);
+        TEST_ASSERT_EQUAL_MEMORY(image, written, IMAGE_SIZE);
+    }
+}
+
+void setup()
+{
+    delay(2000);
+    UNITY_BEGIN();
+    RUN_TEST(test_writes_chunks_before_tail);
+    RUN_TEST(test_splits_chunk_across_tail);
+    RUN_TEST(test_holds_back_chunks_inside_tail);
+    RUN_TEST(test_reassembles_image_from_any_chunk_size);
+    UNITY_END();
+}
+
+void loop()
+{
+    // Do nothing
+}
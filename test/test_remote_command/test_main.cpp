@@ -0,0 +1,140 @@
+#include <Arduino.h>
+#include <unity.h>
+#include "remote_command.h"
+
+// テスト対象の関数は `src/remote_command.cpp` にありますが、テスト実行時にはデフォルトでコンパイルされません。
+// .cppファイルを直接インクルードすることで、そのコードをテストビルドで利用可能にします。
+#include "../../src/remote_command.cpp"
+#include "../../src/wol.cpp"
+#include "../../src/log.cpp"
+
+#define TEST_KEY "test-command-key"
+// 2026-06-01 00:00:00 UTC
+#define NOW 1780272000UL
+// WoLの送信先の数
+#define TARGET_COUNT 3
+
+/**
+ * @brief "<seq> <時刻> <コマンド>" にHMAC-SHA256の署名を付けたパケットを作る
+ */
+String sign(const char *head, const char *key = TEST_KEY)
+{
+    uint8_t mac[br_sha256_SIZE];
+    br_hmac_key_context keyContext;
+    br_hmac_context hmac;
+    br_hmac_key_init(&keyContext, &br_sha256_vtable, key, strlen(key));
+    br_hmac_init(&hmac, &keyContext, 0);
+    br_hmac_update(&hmac, head, strlen(head));
+    br_hmac_out(&hmac, mac);
+
+    String packet = String(head) + " ";
+    for (size_t i = 0; i < sizeof(mac); i++)
+    {
+        char hex[3];
+        snprintf(hex, sizeof(hex), "%02x", mac[i]);
+        packet += hex;
+    }
+    return packet;
+}
+
+const char *parse(const String &packet, uint32_t now, uint32_t lastSeq, RemoteCommand &command)
+{
+    return parseRemoteCommand(packet.c_str(), packet.length(), (const uint8_t *)TEST_KEY, strlen(TEST_KEY), now,
+                              lastSeq, TARGET_COUNT, command);
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_accepts_signed_commands(void)
+{
+    RemoteCommand command;
+    TEST_ASSERT_NULL(parse(sign("5 1780272000 wake 2"), NOW, 4, command));
+    TEST_ASSERT_EQUAL(RemoteCommandType::Wake, command.type);
+    TEST_ASSERT_EQUAL_UINT8(2, command.target);
+    TEST_ASSERT_EQUAL_UINT32(5, command.seq);
+
+    // 末尾の改行は無視する
+    TEST_ASSERT_NULL(parse(sign("6 1780272010 display off") + "\n", NOW, 5, command));
+    TEST_ASSERT_EQUAL(RemoteCommandType::DisplayOff, command.type);
+
+    TEST_ASSERT_NULL(parse(sign("7 1780271990 post"), NOW, 6, command));
+    TEST_ASSERT_EQUAL(RemoteCommandType::Post, command.type);
+}
+
+void test_rejects_bad_signature(void)
+{
+    RemoteCommand command;
+    TEST_ASSERT_EQUAL_STRING("bad signature", parse(sign("5 1780272000 wake", "other-key"), NOW, 0, command));
+
+    // 署名の対象を書き換えた場合
+    String signature = sign("5 1780272000 display on");
+    String packet = String("5 1780272000 display off") + signature.substring(signature.lastIndexOf(' '));
+    TEST_ASSERT_EQUAL_STRING("bad signature", parse(packet, NOW, 0, command));
+
+    TEST_ASSERT_EQUAL_STRING("malformed", parse(String("5 1780272000 wake"), NOW, 0, command));
+}
+
+void test_rejects_replayed_sequence(void)
+{
+    RemoteCommand command;
+    String packet = sign("5 1780272000 wake");
+    TEST_ASSERT_NULL(parse(packet, NOW, 4, command));
+    TEST_ASSERT_EQUAL_STRING("replayed", parse(packet, NOW, 5, command));
+    TEST_ASSERT_EQUAL_STRING("replayed", parse(sign("3 1780272000 wake"), NOW, 5, command));
+}
+
+void test_rejects_out_of_range_sequence(void)
+{
+    RemoteCommand command;
+    // ミリ秒単位の時刻など、32ビットに収まらない通し番号
+    TEST_ASSERT_EQUAL_STRING("malformed", parse(sign("1780272000123 1780272000 wake"), NOW, 0, command));
+    TEST_ASSERT_EQUAL_STRING("malformed", parse(sign("4294967296 1780272000 wake"), NOW, 0, command));
+    TEST_ASSERT_EQUAL_STRING("malformed", parse(sign("-1 1780272000 wake"), NOW, 0, command));
+    TEST_ASSERT_NULL(parse(sign("4294967295 1780272000 wake"), NOW, 0, command));
+    TEST_ASSERT_EQUAL_UINT32(4294967295UL, command.seq);
+}
+
+void test_rejects_stale_timestamp(void)
+{
+    RemoteCommand command;
+    TEST_ASSERT_EQUAL_STRING("stale timestamp", parse(sign("5 1780271960 wake"), NOW, 0, command));
+    TEST_ASSERT_EQUAL_STRING("stale timestamp", parse(sign("5 1780272040 wake"), NOW, 0, command));
+    // NTPの同期前 (起動からの秒数) は時刻を比べられないため受け付けない
+    TEST_ASSERT_EQUAL_STRING("time not synced", parse(sign("5 30 wake"), 30, 0, command));
+}
+
+void test_rejects_unknown_command(void)
+{
+    RemoteCommand command;
+    TEST_ASSERT_EQUAL_STRING("unknown command", parse(sign("5 1780272000 reboot"), NOW, 0, command));
+    TEST_ASSERT_EQUAL_STRING("unknown command", parse(sign("5 1780272000 display dim"), NOW, 0, command));
+    TEST_ASSERT_EQUAL_STRING("bad target", parse(sign("5 1780272000 wake 256"), NOW, 0, command));
+}
+
+void test_rejects_unknown_target(void)
+{
+    RemoteCommand command;
+    TEST_ASSERT_NULL(parse(sign("5 1780272000 wake 2"), NOW, 0, command));
+    TEST_ASSERT_EQUAL_STRING("bad target", parse(sign("5 1780272000 wake 3"), NOW, 0, command));
+    TEST_ASSERT_EQUAL_STRING("bad target", parse(sign("5 1780272000 wake x"), NOW, 0, command));
+}
+
+void setup()
+{
+    delay(2000);
+    UNITY_BEGIN();
+    RUN_TEST(test_accepts_signed_commands);
+    RUN_TEST(test_rejects_bad_signature);
+    RUN_TEST(test_rejects_replayed_sequence);
+    RUN_TEST(test_rejects_out_of_range_sequence);
+    RUN_TEST(test_rejects_stale_timestamp);
+    RUN_TEST(test_rejects_unknown_command);
+    RUN_TEST(test_rejects_unknown_target);
+    UNITY_END();
+}
+
+void loop()
+{
+    // Do nothing
+}
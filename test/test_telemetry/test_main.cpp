@@ -0,0 +1,95 @@
+#include <Arduino.h>
+#include <unity.h>
+#include <ArduinoJson.h>
+#include "telemetry.h"
+
+// テスト対象の関数は `src/telemetry.cpp` にありますが、テスト実行時にはデフォルトでコンパイルされません。
+// .cppファイルを直接インクルードすることで、そのコードをテストビルドで利用可能にします。
+#include "../../src/telemetry.cpp"
+#include "../../src/log.cpp"
+
+// telemetry.cppが参照する送信先 (通常はmain.cppで定義)
+IPAddress telemetryHost(127, 0, 0, 1);
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_line_protocol_format(void)
+{
+    SensorReading reading = {13, 23.4f, 45.0f};
+    char line[64];
+    size_t len = formatReadingLineProtocol(reading, line, sizeof(line));
+    TEST_ASSERT_EQUAL_STRING("deskesp,room=13 temp=23.40,hum=45.00", line);
+    TEST_ASSERT_EQUAL(strlen(line), len);
+}
+
+void test_line_protocol_rounds_to_two_decimals(void)
+{
+    SensorReading reading = {7, 23.456f, 45.678f};
+    char line[64];
+    formatReadingLineProtocol(reading, line, sizeof(line));
+    TEST_ASSERT_EQUAL_STRING("deskesp,room=7 temp=23.46,hum=45.68", line);
+
+    // 氷点下の温度
+    reading = {7, -5.25f, 80.0f};
+    formatReadingLineProtocol(reading, line, sizeof(line));
+    TEST_ASSERT_EQUAL_STRING("deskesp,room=7 temp=-5.25,hum=80.00", line);
+}
+
+void test_line_protocol_needs_no_escaping(void)
+{
+    // タグとフィールドはすべて数値のため、ライン形式のエスケープ (空白・カンマ・等号) は不要。
+    // 区切りの空白はタグとフィールドの間の1つだけになる
+    SensorReading reading = {-1, -40.0f, 100.0f};
+    char line[64];
+    formatReadingLineProtocol(reading, line, sizeof(line));
+    TEST_ASSERT_EQUAL_STRING("deskesp,room=-1 temp=-40.00,hum=100.00", line);
+    TEST_ASSERT_EQUAL_PTR(strchr(line, ' '), strrchr(line, ' '));
+}
+
+void test_line_protocol_truncates_to_buffer(void)
+{
+    SensorReading reading = {13, 23.4f, 45.0f};
+    char line[16];
+    size_t len = formatReadingLineProtocol(reading, line, sizeof(line));
+    TEST_ASSERT_EQUAL(sizeof(line) - 1, len);
+    TEST_ASSERT_EQUAL_STRING("deskesp,room=13", line);
+}
+
+void test_json_format(void)
+{
+    // 2進数で正確に表せる値では、出力の文字列がそのまま決まる
+    SensorReading reading = {13, 23.5f, 45.25f};
+    TEST_ASSERT_EQUAL_STRING("{\"room\":13,\"temp\":23.5,\"hum\":45.25,\"atm\":null}", formatReadingJson(reading).c_str());
+}
+
+void test_json_float_precision(void)
+{
+    SensorReading reading = {13, 23.4f, 45.67f};
+    String json = formatReadingJson(reading);
+
+    JsonDocument doc;
+    TEST_ASSERT_FALSE(deserializeJson(doc, json));
+    TEST_ASSERT_EQUAL(13, doc["room"].as<int>());
+    TEST_ASSERT_FLOAT_WITHIN(0.001, 23.4, doc["temp"].as<float>());
+    TEST_ASSERT_FLOAT_WITHIN(0.001, 45.67, doc["hum"].as<float>());
+    TEST_ASSERT_TRUE(doc["atm"].isNull());
+}
+
+void setup()
+{
+    delay(2000);
+    UNITY_BEGIN();
+    RUN_TEST(test_line_protocol_format);
+    RUN_TEST(test_line_protocol_rounds_to_two_decimals);
+    RUN_TEST(test_line_protocol_needs_no_escaping);
+    RUN_TEST(test_line_protocol_truncates_to_buffer);
+    RUN_TEST(test_json_format);
+    RUN_TEST(test_json_float_precision);
+    UNITY_END();
+}
+
+void loop()
+{
+    // Do nothing
+}
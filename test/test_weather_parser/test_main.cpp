@@ -1,10 +1,15 @@
 #include <Arduino.h>
 #include <unity.h>
+#include <StreamString.h>
 #include "weather.h" // テスト対象の関数と構造体をインクルード
 
 // テスト対象の関数は `src/weather.cpp` にありますが、テスト実行時にはデフォルトでコンパイルされません。
 // .cppファイルを直接インクルードすることで、そのコードをテストビルドで利用可能にします。
 #include "../../src/weather.cpp"
+#include "../../src/http_transport.cpp"
+#include "../../src/gzip_stream.cpp"
+#include "../../src/crash_log.cpp"
+#include "../../src/log.cpp"
 
 // setUpとtearDownは、各テストの前後で実行されますが、今回は不要です
 void setUp(void) {}
@@ -43,6 +48,29 @@ void test_parse_rain_in_5_minutes(void)
     TEST_ASSERT_EQUAL(5, result.minutesUntilRain);
 }
 
+void test_parse_multiple_locations_stream(void)
+{
+    // 地点ごとのFeatureを1つずつ解析し、リクエストした順に降水予報へ変換する
+    StreamString stream;
+    stream.print("{\"ResultInfo\":{\"Count\":2},\"Feature\":["
+                 "{\"Name\":\"A\",\"Property\":{\"WeatherList\":{\"Weather\":[{\"Type\":\"observation\",\"Date\":\"202310272355\",\"Rainfall\":0},{\"Date\":\"202310280000\",\"Rainfall\":0},{\"Date\":\"202310280005\",\"Rainfall\":1.25}]}}},"
+                 "{\"Name\":\"B\",\"Property\":{\"WeatherList\":{\"Weather\":[{\"Date\":\"202310272355\",\"Rainfall\":0},{\"Date\":\"202310280000\",\"Rainfall\":0}]}}}"
+                 "]}");
+
+    RainTimeline timelines[3];
+    TEST_ASSERT_EQUAL(2, parseYahooWeatherStream(stream, timelines, 3));
+
+    // 日付をまたいでも経過時間で並べる
+    TEST_ASSERT_EQUAL(3, timelines[0].steps);
+    TEST_ASSERT_EQUAL(125, timelines[0].rainfall[2]);
+    RainInfo first = summarizeRainTimeline(timelines[0]);
+    TEST_ASSERT_TRUE(first.willRain);
+    TEST_ASSERT_EQUAL(10, first.minutesUntilRain);
+
+    TEST_ASSERT_EQUAL(2, timelines[1].steps);
+    TEST_ASSERT_FALSE(summarizeRainTimeline(timelines[1]).willRain);
+}
+
 void setup()
 {
     // NOTE!!! Wait for >2 secs
@@ -54,6 +82,7 @@ void setup()
     RUN_TEST(test_parse_rain_in_10_minutes);
     RUN_TEST(test_parse_raining_now_but_stops);
     RUN_TEST(test_parse_rain_in_5_minutes);
+    RUN_TEST(test_parse_multiple_locations_stream);
     UNITY_END();
 }
 